@@ -0,0 +1,605 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef BARNES_HUT_HPP
+#define	BARNES_HUT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "execution_policies.hpp"
+#include "forces.hpp"
+
+/*
+ * N-body gravity, where each particle attracts every other one. The naive sum is O(N^2), so
+ * the particles are grouped in a Barnes-Hut quadtree: Groups of particles far enough from the
+ * particle being updated are taken as a single body at their center of mass, which makes the
+ * update O(N log N).
+ *
+ * The tree is a snapshot of the positions of the scene, rebuilt once per frame before the update
+ * (As sdst::uniform_grid), and then read by the sdst::barnes_hut_gravity evolution policy:
+ *
+ *     using position = SDST_FIELD( particle_data , position );
+ *     using velocity = SDST_FIELD( particle_data , velocity );
+ *
+ *     sdst::barnes_hut_tree<position> tree;
+ *
+ *     auto evolution = sdst::make_kernel_chain( sdst::barnes_hut_gravity<position,velocity>{ tree , G , dt , 0.5f , 2.0f } ,
+ *                                               sdst::euler_integration<position,velocity>{ dt } );
+ *
+ *     engine.before_update( [&]( const scene_t& scene ){ tree.rebuild( scene , pool ); } );
+ *
+ * The rebuild is split in chunks through an execution policy: The particles are sorted by the Morton
+ * code of their position (A parallel radix sort), so the particles of each node of the tree are a
+ * contiguous range, and then the subtrees below the second level are built in parallel.
+ */
+
+namespace sdst
+{
+    template<typename POSITION>
+    struct barnes_hut_tree
+    {
+    public:
+        using data_t = typename POSITION::data_t;
+
+        /*
+         * A node of the tree: A square cell of the space with the total mass of the particles inside and
+         * their center of mass. The four children of a node are stored contiguously, and leaves keep the
+         * range of their particles in the sorted position arrays.
+         */
+        struct node
+        {
+            float         mass;
+            float         cx , cy;     //Center of mass
+            float         size;        //Side of the cell
+            std::uint32_t first_child; //Zero for leaves
+            std::uint32_t begin , end;
+        };
+
+        /*
+         * Maximum number of particles of a leaf. Leaves are summed particle by particle.
+         */
+        static constexpr std::size_t leaf_capacity = 8;
+
+        /*
+         * Initializes an empty tree. All the particles are given the same mass.
+         */
+        explicit barnes_hut_tree( float particle_mass = 1.0f ) :
+            _particle_mass{ particle_mass },
+            _size{ 0 }
+        {}
+
+        /*
+         * Rebuilds the tree from the current positions of the scene. Only allocates when the scene is
+         * larger than in previous rebuilds.
+         */
+        template<typename SCENE , typename EXECUTION_POLICY = sdst::sequential_execution>
+        void rebuild( const SCENE& scene , const EXECUTION_POLICY& execution_policy = EXECUTION_POLICY{} )
+        {
+            _size = scene.size();
+            _nodes.clear();
+
+            if( _size == 0 )
+                return;
+
+            if( _codes.size() < _size )
+            {
+                _codes.resize( _size );
+                _order.resize( _size );
+                _sorted_codes.resize( _size );
+                _sorted_order.resize( _size );
+                _positions.resize( 2 * _size );
+                _xs.resize( _size );
+                _ys.resize( _size );
+            }
+
+            const std::size_t blocks = std::min( ( _size + block_size - 1 ) / block_size , max_blocks );
+
+            _block_bounds.resize( 4 * blocks );
+            _histograms.resize( radix * blocks );
+
+            //Read the positions and the bounds of each block:
+            execution_policy.for_each_range( 0 , blocks , 1 , [&]( std::size_t first_block , std::size_t last_block )
+            {
+                for( std::size_t b = first_block ; b < last_block ; ++b )
+                {
+                    float min_x = std::numeric_limits<float>::max() , min_y = min_x;
+                    float max_x = std::numeric_limits<float>::lowest() , max_y = max_x;
+
+                    for( std::size_t i = block_begin( b , blocks ) ; i < block_begin( b + 1 , blocks ) ; ++i )
+                    {
+                        const data_t& data = scene[i];
+                        const float   x    = POSITION::get( data ).x;
+                        const float   y    = POSITION::get( data ).y;
+
+                        _positions[2 * i]     = x;
+                        _positions[2 * i + 1] = y;
+
+                        min_x = std::min( min_x , x );
+                        min_y = std::min( min_y , y );
+                        max_x = std::max( max_x , x );
+                        max_y = std::max( max_y , y );
+                    }
+
+                    _block_bounds[4 * b]     = min_x;
+                    _block_bounds[4 * b + 1] = min_y;
+                    _block_bounds[4 * b + 2] = max_x;
+                    _block_bounds[4 * b + 3] = max_y;
+                }
+            });
+
+            float min_x = std::numeric_limits<float>::max() , min_y = min_x;
+            float max_x = std::numeric_limits<float>::lowest() , max_y = max_x;
+
+            for( std::size_t b = 0 ; b < blocks ; ++b )
+            {
+                min_x = std::min( min_x , _block_bounds[4 * b] );
+                min_y = std::min( min_y , _block_bounds[4 * b + 1] );
+                max_x = std::max( max_x , _block_bounds[4 * b + 2] );
+                max_y = std::max( max_y , _block_bounds[4 * b + 3] );
+            }
+
+            //The root cell is a square, slightly larger than the bounds so no particle falls on its far sides.
+            //If all the particles are at the same point any extent works, a unit one keeps the scale finite:
+            const float extent = std::max( max_x - min_x , max_y - min_y );
+
+            _min_x  = min_x;
+            _min_y  = min_y;
+            _extent = ( extent > 0.0f ? extent : 1.0f ) * 1.0001f;
+
+            const float scale = 65536.0f / _extent;
+
+            execution_policy.for_each_range( 0 , _size , [&]( std::size_t begin , std::size_t end )
+            {
+                for( std::size_t i = begin ; i < end ; ++i )
+                {
+                    _codes[i] = morton_code( quantize( ( _positions[2 * i] - _min_x ) * scale ) ,
+                                             quantize( ( _positions[2 * i + 1] - _min_y ) * scale ) );
+                    _order[i] = static_cast<std::uint32_t>( i );
+                }
+            });
+
+            sort( blocks , execution_policy );
+
+            execution_policy.for_each_range( 0 , _size , [&]( std::size_t begin , std::size_t end )
+            {
+                for( std::size_t i = begin ; i < end ; ++i )
+                {
+                    _xs[i] = _positions[2 * _order[i]];
+                    _ys[i] = _positions[2 * _order[i] + 1];
+                }
+            });
+
+            build( execution_policy );
+        }
+
+        /*
+         * Computes the gravitational acceleration (Without the gravitational constant) at the point
+         * (x,y). Cells seen under an angle smaller than 'theta' (size/distance) are taken as a single
+         * body, so theta = 0 gives the exact sum. 'softening2' is the square of the softening length,
+         * which bounds the acceleration near each body. Bodies exactly at (x,y), like the particle itself,
+         * don't contribute.
+         */
+        void acceleration( float x , float y , float theta , float softening2 , float& ax , float& ay ) const
+        {
+            ax = 0.0f;
+            ay = 0.0f;
+
+            if( _nodes.empty() )
+                return;
+
+            const float   theta2 = theta * theta;
+            std::uint32_t stack[max_depth];
+            std::size_t   top = 0;
+
+            stack[top++] = 0;
+
+            while( top > 0 )
+            {
+                const node& n = _nodes[stack[--top]];
+
+                if( n.mass == 0.0f )
+                    continue;
+
+                const float dx = n.cx - x;
+                const float dy = n.cy - y;
+                const float d2 = dx * dx + dy * dy;
+
+                if( n.first_child == 0 )
+                {
+                    for( std::uint32_t i = n.begin ; i < n.end ; ++i )
+                        attract( _xs[i] - x , _ys[i] - y , _particle_mass , softening2 , ax , ay );
+                }
+                else if( n.size * n.size < theta2 * d2 )
+                {
+                    attract( dx , dy , n.mass , softening2 , ax , ay );
+                }
+                else
+                {
+                    for( std::uint32_t c = 0 ; c < 4 ; ++c )
+                        stack[top++] = n.first_child + c;
+                }
+            }
+        }
+
+        /*
+         * Returns the number of particles of the last rebuild.
+         */
+        std::size_t size() const
+        {
+            return _size;
+        }
+
+        /*
+         * Gives access to the nodes of the tree. The first one is the root.
+         */
+        const std::vector<node>& nodes() const
+        {
+            return _nodes;
+        }
+
+        float particle_mass() const
+        {
+            return _particle_mass;
+        }
+
+    private:
+        static constexpr std::size_t radix      = 256;
+        static constexpr std::size_t block_size = 16384;
+        static constexpr std::size_t max_blocks = 64;
+        static constexpr std::size_t max_level  = 16; //Bits per axis of the Morton codes
+        static constexpr std::size_t max_depth  = 3 * max_level + 4;
+        static constexpr std::size_t top_nodes  = 1 + 4 + 16;
+
+        std::size_t block_begin( std::size_t block , std::size_t blocks ) const
+        {
+            return block * _size / blocks;
+        }
+
+        static std::uint32_t quantize( float coordinate )
+        {
+            //Written so NaNs map to 0, casting them is undefined:
+            return coordinate > 0.0f ? static_cast<std::uint32_t>( std::min( coordinate , 65535.0f ) ) : 0;
+        }
+
+        /*
+         * Interleaves the bits of the coordinates, y bits first, so each pair of bits selects one
+         * of the four children of a cell (Bit 0 the x half, bit 1 the y half).
+         */
+        static std::uint32_t morton_code( std::uint32_t x , std::uint32_t y )
+        {
+            return spread( x ) | ( spread( y ) << 1 );
+        }
+
+        static std::uint32_t spread( std::uint32_t v )
+        {
+            v = ( v | ( v << 8 ) ) & 0x00FF00FFu;
+            v = ( v | ( v << 4 ) ) & 0x0F0F0F0Fu;
+            v = ( v | ( v << 2 ) ) & 0x33333333u;
+            v = ( v | ( v << 1 ) ) & 0x55555555u;
+
+            return v;
+        }
+
+        static void attract( float dx , float dy , float mass , float softening2 , float& ax , float& ay )
+        {
+            if( dx == 0.0f && dy == 0.0f )
+                return;
+
+            const float d2      = dx * dx + dy * dy + softening2;
+            const float inverse = 1.0f / std::sqrt( d2 );
+            const float factor  = mass * inverse * inverse * inverse;
+
+            ax += dx * factor;
+            ay += dy * factor;
+        }
+
+        /*
+         * Stable LSD radix sort of the (code,index) pairs, a byte per pass. Each block is histogrammed
+         * and scattered by one task, in order, so the sort is stable.
+         */
+        template<typename EXECUTION_POLICY>
+        void sort( std::size_t blocks , const EXECUTION_POLICY& execution_policy )
+        {
+            for( std::size_t shift = 0 ; shift < 32 ; shift += 8 )
+            {
+                execution_policy.for_each_range( 0 , blocks , 1 , [&]( std::size_t first_block , std::size_t last_block )
+                {
+                    for( std::size_t b = first_block ; b < last_block ; ++b )
+                    {
+                        std::uint32_t* histogram = _histograms.data() + radix * b;
+
+                        std::fill( histogram , histogram + radix , 0 );
+
+                        for( std::size_t i = block_begin( b , blocks ) ; i < block_begin( b + 1 , blocks ) ; ++i )
+                            ++histogram[( _codes[i] >> shift ) & ( radix - 1 )];
+                    }
+                });
+
+                //Exclusive scan, digit-major, turning the histograms into the cursors of each block:
+                std::uint32_t start = 0;
+
+                for( std::size_t digit = 0 ; digit < radix ; ++digit )
+                {
+                    for( std::size_t b = 0 ; b < blocks ; ++b )
+                    {
+                        const std::uint32_t count = _histograms[radix * b + digit];
+
+                        _histograms[radix * b + digit] = start;
+                        start += count;
+                    }
+                }
+
+                execution_policy.for_each_range( 0 , blocks , 1 , [&]( std::size_t first_block , std::size_t last_block )
+                {
+                    for( std::size_t b = first_block ; b < last_block ; ++b )
+                    {
+                        std::uint32_t* cursors = _histograms.data() + radix * b;
+
+                        for( std::size_t i = block_begin( b , blocks ) ; i < block_begin( b + 1 , blocks ) ; ++i )
+                        {
+                            const std::uint32_t slot = cursors[( _codes[i] >> shift ) & ( radix - 1 )]++;
+
+                            _sorted_codes[slot] = _codes[i];
+                            _sorted_order[slot] = _order[i];
+                        }
+                    }
+                });
+
+                _codes.swap( _sorted_codes );
+                _order.swap( _sorted_order );
+            }
+        }
+
+        /*
+         * Builds the tree. The first two levels are always split (The root, its 4 children and 16
+         * grandchildren are the first 21 nodes), and the subtree of each grandchild is built by a
+         * separate task into its own array. Then the subtrees are appended to the top nodes.
+         */
+        template<typename EXECUTION_POLICY>
+        void build( const EXECUTION_POLICY& execution_policy )
+        {
+            _subtrees.resize( 16 );
+
+            execution_policy.for_each_range( 0 , 16 , 1 , [&]( std::size_t first , std::size_t last )
+            {
+                for( std::size_t g = first ; g < last ; ++g )
+                {
+                    std::vector<node>& subtree = _subtrees[g];
+                    const float        size    = _extent / 4.0f;
+
+                    subtree.resize( 1 );
+                    subtree[0].begin = lower_bound( static_cast<std::uint64_t>( g ) << 28 );
+                    subtree[0].end   = lower_bound( static_cast<std::uint64_t>( g + 1 ) << 28 );
+
+                    build( subtree , 0 , 2 , size );
+                }
+            });
+
+            std::uint32_t bases[16];
+            std::size_t   total = top_nodes;
+
+            for( std::size_t g = 0 ; g < 16 ; ++g )
+            {
+                bases[g] = static_cast<std::uint32_t>( total );
+                total   += _subtrees[g].size() - 1;
+            }
+
+            _nodes.resize( total );
+
+            execution_policy.for_each_range( 0 , 16 , 1 , [&]( std::size_t first , std::size_t last )
+            {
+                for( std::size_t g = first ; g < last ; ++g )
+                {
+                    const std::vector<node>& subtree = _subtrees[g];
+
+                    //Local node 0 is the grandchild itself, the rest follow the top nodes:
+                    for( std::size_t i = 0 ; i < subtree.size() ; ++i )
+                    {
+                        node n = subtree[i];
+
+                        if( n.first_child != 0 )
+                            n.first_child += bases[g] - 1;
+
+                        _nodes[i == 0 ? 5 + g : bases[g] + i - 1] = n;
+                    }
+                }
+            });
+
+            for( std::size_t c = 4 ; c > 0 ; --c )
+            {
+                _nodes[c].first_child = static_cast<std::uint32_t>( 1 + 4 * c );
+                _nodes[c].size        = _extent / 2.0f;
+                aggregate( _nodes , c );
+            }
+
+            _nodes[0].first_child = 1;
+            _nodes[0].size        = _extent;
+            aggregate( _nodes , 0 );
+        }
+
+        /*
+         * Builds the subtree of a node whose range of particles is already set. 'level' is the depth
+         * of the node and 'size' the side of its cell.
+         */
+        void build( std::vector<node>& nodes , std::size_t index , std::size_t level , float size )
+        {
+            nodes[index].size        = size;
+            nodes[index].first_child = 0;
+
+            const std::uint32_t begin = nodes[index].begin;
+            const std::uint32_t end   = nodes[index].end;
+
+            if( end - begin <= leaf_capacity || level == max_level )
+            {
+                double sx = 0.0 , sy = 0.0;
+
+                for( std::uint32_t i = begin ; i < end ; ++i )
+                {
+                    sx += _xs[i];
+                    sy += _ys[i];
+                }
+
+                const std::uint32_t count = end - begin;
+
+                nodes[index].mass = _particle_mass * count;
+                nodes[index].cx   = count > 0 ? static_cast<float>( sx / count ) : 0.0f;
+                nodes[index].cy   = count > 0 ? static_cast<float>( sy / count ) : 0.0f;
+
+                return;
+            }
+
+            const std::size_t   first_child = nodes.size();
+            const std::size_t   shift       = 30 - 2 * level;
+            const std::uint64_t prefix      = _codes[begin] >> ( shift + 2 ) << ( shift + 2 );
+            const float         half        = size / 2.0f;
+
+            nodes.resize( first_child + 4 );
+            nodes[index].first_child = static_cast<std::uint32_t>( first_child );
+
+            for( std::size_t c = 0 ; c < 4 ; ++c )
+            {
+                nodes[first_child + c].begin = c == 0 ? begin : nodes[first_child + c - 1].end;
+                nodes[first_child + c].end   = c == 3 ? end   : lower_bound( prefix + ( static_cast<std::uint64_t>( c + 1 ) << shift ) , nodes[first_child + c].begin , end );
+
+                build( nodes , first_child + c , level + 1 , half );
+            }
+
+            aggregate( nodes , index );
+        }
+
+        /*
+         * Sets the mass and the center of mass of an internal node from its children.
+         */
+        static void aggregate( std::vector<node>& nodes , std::size_t index )
+        {
+            const std::size_t first_child = nodes[index].first_child;
+            float mass = 0.0f , mx = 0.0f , my = 0.0f;
+
+            for( std::size_t c = first_child ; c < first_child + 4 ; ++c )
+            {
+                mass += nodes[c].mass;
+                mx   += nodes[c].mass * nodes[c].cx;
+                my   += nodes[c].mass * nodes[c].cy;
+            }
+
+            nodes[index].mass  = mass;
+            nodes[index].cx    = mass > 0.0f ? mx / mass : 0.0f;
+            nodes[index].cy    = mass > 0.0f ? my / mass : 0.0f;
+            nodes[index].begin = nodes[first_child].begin;
+            nodes[index].end   = nodes[first_child + 3].end;
+        }
+
+        /*
+         * Returns the first sorted particle in [begin,end) whose code is not less than 'code'.
+         */
+        std::uint32_t lower_bound( std::uint64_t code , std::uint32_t begin , std::uint32_t end ) const
+        {
+            return static_cast<std::uint32_t>( std::lower_bound( _codes.begin() + begin , _codes.begin() + end , code ,
+                                                                 []( std::uint32_t lhs , std::uint64_t rhs ){ return lhs < rhs; } ) - _codes.begin() );
+        }
+
+        std::uint32_t lower_bound( std::uint64_t code ) const
+        {
+            return lower_bound( code , 0 , static_cast<std::uint32_t>( _size ) );
+        }
+
+        float       _particle_mass;
+        std::size_t _size;
+        float       _min_x , _min_y , _extent;
+
+        std::vector<node>              _nodes;
+        std::vector<std::vector<node>> _subtrees;     //Subtree of each grandchild of the root, reused between rebuilds
+        std::vector<std::uint32_t>     _codes;        //Morton codes, sorted after the rebuild
+        std::vector<std::uint32_t>     _order;        //Index in the scene of each sorted particle
+        std::vector<std::uint32_t>     _sorted_codes; //Radix sort buffers
+        std::vector<std::uint32_t>     _sorted_order;
+        std::vector<std::uint32_t>     _histograms;   //Per block
+        std::vector<float>             _block_bounds; //Per block
+        std::vector<float>             _positions;    //Interleaved, in scene order
+        std::vector<float>             _xs , _ys;     //Sorted
+    };
+
+    template<typename POSITION>
+    constexpr std::size_t barnes_hut_tree<POSITION>::leaf_capacity;
+
+    template<typename POSITION>
+    constexpr std::size_t barnes_hut_tree<POSITION>::radix;
+
+    template<typename POSITION>
+    constexpr std::size_t barnes_hut_tree<POSITION>::block_size;
+
+    template<typename POSITION>
+    constexpr std::size_t barnes_hut_tree<POSITION>::max_blocks;
+
+    /*
+     * Mutual gravitational attraction of the particles of a scene, through a Barnes-Hut tree rebuilt
+     * before each update. 'theta' is the opening angle: Larger values are faster and less accurate
+     * (0.5 is the usual tradeoff, 0 computes the exact sum). The softening length keeps close encounters
+     * from producing huge accelerations.
+     */
+    template<typename POSITION , typename VELOCITY>
+    struct barnes_hut_gravity
+    {
+    public:
+        using data_t = typename POSITION::data_t;
+
+        barnes_hut_gravity( const sdst::barnes_hut_tree<POSITION>& tree , float G , float dt , float theta = 0.5f , float softening = 1.0f ) :
+            _tree{ &tree },
+            _factor{ G * dt },
+            _theta{ theta },
+            _softening2{ softening * softening }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            accelerate( sdst::impl::floats<POSITION>( data ) , sdst::impl::floats<VELOCITY>( data ) , 1 );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            accelerate( sdst::impl::floats<POSITION>( first.template column<POSITION>() ) ,
+                        sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) , count );
+        }
+
+    private:
+        void accelerate( const float* positions , float* velocities , std::size_t count ) const
+        {
+            for( std::size_t i = 0 ; i < count ; ++i )
+            {
+                float ax , ay;
+
+                _tree->acceleration( positions[2 * i] , positions[2 * i + 1] , _theta , _softening2 , ax , ay );
+
+                velocities[2 * i]     += ax * _factor;
+                velocities[2 * i + 1] += ay * _factor;
+            }
+        }
+
+        const sdst::barnes_hut_tree<POSITION>* _tree;
+        float _factor , _theta , _softening2;
+    };
+}
+
+#endif	/* BARNES_HUT_HPP */
@@ -20,22 +20,313 @@
 #ifndef ENGINE_HPP
 #define	ENGINE_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <functional>
+#include <iterator>
+#include <type_traits>
 #include <utility>
 
+#include "execution_policies.hpp"
+#include "policy_arena.hpp"
+#include "profiling.hpp"
 #include "stated_policies.hpp"
 
 namespace sdst
 { 
+    /*
+     * How a property of the particles is tested on a scene: Met by all the particles, or by
+     * at least one of them.
+     */
+    enum class quantifier
+    {
+        all,
+        any
+    };
+    
+    namespace impl
+    {
+        /*
+         * Updates a range of the scene through the scene itself, if the scene supports
+         * range updates (See homogeneous_scene.hpp for example). Such scenes can hand
+         * the whole range to a batch evolution policy.
+         */
+        template<typename ITERATOR>
+        auto update_range( ITERATOR begin , ITERATOR end , int ) -> decltype( begin.scene()->update( begin.index() , end.index() - begin.index() ) , void() )
+        {
+            begin.scene()->update( begin.index() , end.index() - begin.index() );
+        }
+
+        /*
+         * Updates a range of the scene particle by particle.
+         */
+        template<typename ITERATOR>
+        void update_range( ITERATOR begin , ITERATOR end , long )
+        {
+            for( ; begin != end ; ++begin )
+                (*begin).update();
+        }
+
+        /*
+         * Chunk function used by engines to update a range of the scene.
+         */
+        struct update_chunk
+        {
+            template<typename ITERATOR>
+            void operator()( ITERATOR begin , ITERATOR end ) const
+            {
+                sdst::impl::update_range( begin , end , 0 );
+            }
+        };
+        
+        /*
+         * Evolves a particle without sending its local update requests, if the particle supports it.
+         * Else updates it.
+         */
+        template<typename PARTICLE>
+        auto evolve_particle( PARTICLE&& particle , int ) -> decltype( particle.evolve() , void() )
+        {
+            particle.evolve();
+        }
+
+        template<typename PARTICLE>
+        void evolve_particle( PARTICLE&& particle , long )
+        {
+            particle.update();
+        }
+
+        /*
+         * Evolves a range of the scene without sending the local update requests of the particles,
+         * through the scene itself if the scene supports range evolution (See homogeneous_scene::evolve()).
+         */
+        template<typename ITERATOR>
+        auto evolve_range( ITERATOR begin , ITERATOR end , int ) -> decltype( begin.scene()->evolve( begin.index() , end.index() - begin.index() ) , void() )
+        {
+            begin.scene()->evolve( begin.index() , end.index() - begin.index() );
+        }
+
+        template<typename ITERATOR>
+        void evolve_range( ITERATOR begin , ITERATOR end , long )
+        {
+            for( ; begin != end ; ++begin )
+                sdst::impl::evolve_particle( *begin , 0 );
+        }
+
+        /*
+         * Chunk function used by engines which send the local update requests later (See
+         * request_local_updates()) to evolve a range of the scene.
+         */
+        struct evolve_chunk
+        {
+            template<typename ITERATOR>
+            void operator()( ITERATOR begin , ITERATOR end ) const
+            {
+                sdst::impl::evolve_range( begin , end , 0 );
+            }
+        };
+
+        /*
+         * Sends the local update requests of a particle evolved by evolve_particle(). Particles which
+         * don't support it were updated, so their requests are already sent.
+         */
+        template<typename PARTICLE>
+        auto request_local_update( PARTICLE&& particle , int ) -> decltype( particle.request_local_update() , void() )
+        {
+            particle.request_local_update();
+        }
+
+        template<typename PARTICLE>
+        void request_local_update( PARTICLE&& , long )
+        {}
+
+        struct request_local_updates_chunk
+        {
+            template<typename ITERATOR>
+            void operator()( ITERATOR begin , ITERATOR end ) const
+            {
+                for( ; begin != end ; ++begin )
+                    sdst::impl::request_local_update( *begin , 0 );
+            }
+        };
+
+        /*
+         * Sends the local update requests of the 'count' particles of a scene evolved through evolve_chunk,
+         * at once if the scene supports it (See homogeneous_scene::request_local_updates()), else particle
+         * by particle.
+         */
+        template<typename SCENE , typename EXECUTION_POLICY>
+        auto request_local_updates( SCENE& scene , std::size_t count , const EXECUTION_POLICY& , int ) -> decltype( scene.request_local_updates( count ) , void() )
+        {
+            scene.request_local_updates( count );
+        }
+
+        template<typename SCENE , typename EXECUTION_POLICY>
+        void request_local_updates( SCENE& scene , std::size_t , const EXECUTION_POLICY& execution_policy , long )
+        {
+            execution_policy.for_each_chunk( scene , sdst::impl::request_local_updates_chunk{} );
+        }
+        
+        /*
+         * Lets the scene finish a step, if the scene needs it (See pool_scene::collect()).
+         * Called by the engines after updating the whole scene.
+         */
+        template<typename SCENE>
+        auto end_step( SCENE& scene , int ) -> decltype( scene.collect() , void() )
+        {
+            scene.collect();
+        }
+        
+        template<typename SCENE>
+        void end_step( SCENE& , long )
+        {}
+        
+        /*
+         * Policy handles (sdst::shared_policy, sdst::arena_policy) point to policies shared with other
+         * owners, which are updated through the engine arena if tracked (See policy_arena::track()).
+         */
+        template<typename POLICY>
+        struct is_policy_handle : public std::false_type
+        {};
+        
+        template<typename POLICY>
+        struct is_policy_handle<sdst::shared_policy<POLICY>> : public std::true_type
+        {};
+        
+        template<typename POLICY>
+        struct is_policy_handle<sdst::arena_policy<POLICY>> : public std::true_type
+        {};
+        
+        template<typename POLICY>
+        void owned_global_update( POLICY& policy , std::false_type )
+        {
+            policy( sdst::state_change::global );
+        }
+        
+        template<typename POLICY>
+        void owned_global_update( POLICY& , std::true_type )
+        {}
+        
+        /*
+         * Sends a global update to the policies owned by the scene, if it has them (Shared by all its
+         * particles, see homogeneous_scene::evolution_policy()), except handles. Called by the engines
+         * once per step, when no particle is being updated nor drawn.
+         */
+        template<typename SCENE>
+        auto global_update( SCENE& scene , int ) -> decltype( scene.evolution_policy() , scene.drawing_policy() , void() )
+        {
+            sdst::impl::owned_global_update( scene.evolution_policy() , typename is_policy_handle<typename SCENE::evolution_policy_t>::type{} );
+            sdst::impl::owned_global_update( scene.drawing_policy() , typename is_policy_handle<typename SCENE::drawing_policy_t>::type{} );
+        }
+        
+        template<typename SCENE>
+        void global_update( SCENE& , long )
+        {}
+        
+        /*
+         * Tests a property on a scene, returning whether the quantified property holds.
+         */
+        template<typename SCENE , typename PROPERTY>
+        bool test_scene( const SCENE& scene , sdst::quantifier quantifier , PROPERTY& property )
+        {
+            if( quantifier == sdst::quantifier::all )
+                return std::all_of( std::begin( scene ) , std::end( scene ) , std::ref( property ) );
+            else
+                return std::any_of( std::begin( scene ) , std::end( scene ) , std::ref( property ) );
+        }
+        
+        /*
+         * Whether a particle is still alive after its update. Particles of pool scenes may die during
+         * the step (Lifetime of zero), and are only removed by the collect() at its end.
+         */
+        template<typename SCENE>
+        auto alive( const SCENE& scene , std::size_t index , int ) -> decltype( scene.lifetimes() , bool() )
+        {
+            return scene.lifetimes()[index] > 0.0f;
+        }
+        
+        template<typename SCENE>
+        bool alive( const SCENE& , std::size_t , long )
+        {
+            return true;
+        }
+        
+        /*
+         * Chunk function which updates a range of the scene and tests a property on it, in blocks small
+         * enough to be still cached when the property is tested. So the property costs no extra pass over
+         * the scene memory.
+         * 
+         * The chunks only raise the 'decided' flag, when a particle decides the result of the quantifier
+         * (A particle not meeting the property for quantifier::all, one meeting it for quantifier::any).
+         * Once raised, the remaining chunks skip the tests. Particles died during the update are not tested,
+         * as they are gone when the step ends.
+         */
+        template<typename SCENE , typename PROPERTY>
+        struct update_and_test_chunk
+        {
+            static const std::size_t block_size = 1024;
+            
+            SCENE*             scene;
+            PROPERTY*          property;
+            sdst::quantifier   quantifier;
+            std::atomic<bool>* decided;
+            
+            template<typename ITERATOR>
+            void operator()( ITERATOR begin , ITERATOR end ) const
+            {
+                const SCENE& readonly_scene = *scene;
+                const bool   deciding_value = quantifier == sdst::quantifier::any;
+                
+                std::size_t index  = static_cast<std::size_t>( std::distance( std::begin( *scene ) , begin ) );
+                auto        tested = std::next( std::begin( readonly_scene ) , index );
+                
+                while( begin != end )
+                {
+                    const auto     count = std::min<typename std::iterator_traits<ITERATOR>::difference_type>( std::distance( begin , end ) , block_size );
+                    const ITERATOR last  = std::next( begin , count );
+                    
+                    sdst::impl::update_range( begin , last , 0 );
+                    
+                    if( !decided->load( std::memory_order_relaxed ) )
+                    {
+                        std::size_t i = index;
+                        
+                        for( auto it = tested , tested_end = std::next( tested , count ) ; it != tested_end ; ++it , ++i )
+                        {
+                            if( sdst::impl::alive( readonly_scene , i , 0 ) && static_cast<bool>( (*property)( *it ) ) == deciding_value )
+                            {
+                                decided->store( true , std::memory_order_relaxed );
+                                break;
+                            }
+                        }
+                    }
+                    
+                    begin   = last;
+                    tested  = std::next( tested , count );
+                    index  += count;
+                }
+            }
+        };
+    }
+    
     /*
      * A manual engine doesn't perform a simulation loop, it only provides the basic
      * functionality for the different simulation steps. The loop should be done manually
      * by the user.
      * 
-     * Since its a basic engine, it only manages a scene and the drawing policy for it,
-     * doesn't care about global evolution policies and other things shared between particles.
+     * Since its a basic engine, it only manages a scene, the drawing policy for it, and
+     * the policies shared between particles registered in its policy arena.
+     * 
+     * The execution policy specifies how the scene is traversed on each step (See 
+     * execution_policies.hpp). By default the scene is updated sequentially.
+     * 
+     * The engine owns a policy arena (See policy_arena.hpp) for the policies shared by the
+     * particles of its scene, which lives as long as the engine. Each step sends one global
+     * update to each stated policy registered in the arena, and to the policies owned by the
+     * scene if it has them (sdst::homogeneous_scene, sdst::pool_scene, sdst::soa_scene).
      */
-    template<typename SCENE , typename DRAW_POLICY>
+    template<typename SCENE , typename DRAW_POLICY , typename EXECUTION_POLICY = sdst::sequential_execution>
     struct basic_manual_engine
     {
         /*
@@ -48,13 +339,19 @@ namespace sdst
          */
         using draw_policy_t = DRAW_POLICY;
         
+        /*
+         * The type of the execution policy used.
+         */
+        using execution_policy_t = EXECUTION_POLICY;
+        
         
         /*
          * Initializes the engine passign the values to initialize the scene and the drawing policy
          */
-        basic_manual_engine( const scene_t& scene , const draw_policy_t& draw_policy ) :
+        basic_manual_engine( const scene_t& scene , const draw_policy_t& draw_policy , const execution_policy_t& execution_policy = execution_policy_t{} ) :
             _scene{ scene } ,
-            _drawing_policy{ draw_policy }
+            _drawing_policy{ draw_policy },
+            _execution_policy{ execution_policy }
         {}
             
         /*
@@ -63,18 +360,48 @@ namespace sdst
         void step()
         {
             /*
-             * Yes, just a raw loop, but its extremelly powerfull:
+             * Yes, just a raw loop (See sdst::impl::update_chunk), but its extremelly powerfull:
              * It works for any SCENE type which has defined iterator getters (begin() and end()),
              * and the engine shouldn't have to take care of the type of the particles, can just
              * rely on duck typing.
+             * 
+             * The execution policy only decides how the scene is split in chunks. It returns
+             * when all the chunks have been updated, so the global updates below always happen
+             * exactly once per frame, after the whole scene is updated.
              */
-            for( auto& particle : _scene )
-                particle.update();
+            _execution_policy.for_each_chunk( _scene , sdst::impl::update_chunk{} );
+            sdst::impl::end_step( _scene , 0 );
             
-            //Update the drawing policy:
+            //Update the shared policies (Those owned by the scene and those known by the arena) and the drawing policy:
+            sdst::impl::global_update( _scene , 0 );
+            _policies.global_update( _execution_policy );
             _drawing_policy( sdst::state_change::global );
         }
         
+        /*
+         * Executes one step of the simulation, testing a property on each particle right after
+         * its update (So the test doesn't need another pass over the scene). Returns whether the
+         * property is met by all the particles of the updated scene (quantifier::all), or by at
+         * least one of them (quantifier::any).
+         * 
+         * The property takes particles of the readonly scene, as in std::all_of( scene.begin() , ... ).
+         * With a parallel execution policy its called from the pool threads concurrently.
+         */
+        template<typename PROPERTY>
+        bool step( sdst::quantifier quantifier , PROPERTY property )
+        {
+            std::atomic<bool> decided{ false };
+            
+            _execution_policy.for_each_chunk( _scene , sdst::impl::update_and_test_chunk<scene_t,PROPERTY>{ &_scene , &property , quantifier , &decided } );
+            sdst::impl::end_step( _scene , 0 );
+            
+            sdst::impl::global_update( _scene , 0 );
+            _policies.global_update( _execution_policy );
+            _drawing_policy( sdst::state_change::global );
+            
+            return ( quantifier == sdst::quantifier::all ) != decided.load();
+        }
+        
         /*
          * Draws the current state of the simulation.
          */
@@ -83,6 +410,18 @@ namespace sdst
             _drawing_policy( _scene );
         }
         
+        /*
+         * Draws the current state of the simulation, passing the interpolation factor between
+         * the previous and the current simulation step (See basic_automatic_engine::fixed_timestep()).
+         * 
+         * If the draw policy supports the signature void(SCENE&,float) it receives the factor,
+         * else the scene is drawn as usual.
+         */
+        void draw( float alpha )
+        {
+            interpolated_draw<draw_policy_t>::execute( _drawing_policy , _scene , alpha );
+        }
+        
         
         /*
          * Provides full (Read/Write) access to the underlying scene of an engine.
@@ -99,9 +438,58 @@ namespace sdst
         {
             return _scene;
         }
+        
+        /*
+         * Gives access to the execution policy of the engine.
+         */
+        const execution_policy_t& execution_policy() const
+        {
+            return _execution_policy;
+        }
+        
+        /*
+         * Gives access to the arena of the shared policies of the scene.
+         */
+        sdst::policy_arena& policies()
+        {
+            return _policies;
+        }
+        
+        const sdst::policy_arena& policies() const
+        {
+            return _policies;
+        }
     private:
+        /*
+         * Interpolated draw. This specialization is rejected if the draw
+         * policy doesn't accept the interpolation factor.
+         */
+        template<typename P , typename INTERPOLATES = tml::is_valid_call<P,scene_t&,float>>
+        struct interpolated_draw
+        {
+            static void execute( sdst::erase_state<P>& policy , scene_t& scene , float alpha )
+            {
+                policy( scene , alpha );
+            }
+        };
+        
+        /*
+         * Interpolated draw. This specialization is rejected if the draw
+         * policy accepts the interpolation factor.
+         */
+        template<typename P>
+        struct interpolated_draw<P,tml::false_type>
+        {
+            static void execute( sdst::erase_state<P>& policy , scene_t& scene , float )
+            {
+                policy( scene );
+            }
+        };
+        
+        sdst::policy_arena               _policies; //Declared first, so it outlives the scene
         scene_t                          _scene;
         sdst::erase_state<draw_policy_t> _drawing_policy;
+        execution_policy_t               _execution_policy;
     };
     
     template<typename SCENE , typename DRAW_POLICY>
@@ -110,11 +498,190 @@ namespace sdst
         return { std::forward<SCENE>( scene ) , std::forward<DRAW_POLICY>( draw_policy ) };
     }
     
+    template<typename SCENE , typename DRAW_POLICY , typename EXECUTION_POLICY>
+    sdst::basic_manual_engine<typename std::decay<SCENE>::type,typename std::decay<DRAW_POLICY>::type,typename std::decay<EXECUTION_POLICY>::type> make_basic_manual_engine( SCENE&& scene , DRAW_POLICY&& draw_policy , EXECUTION_POLICY&& execution_policy )
+    {
+        return { std::forward<SCENE>( scene ) , std::forward<DRAW_POLICY>( draw_policy ) , std::forward<EXECUTION_POLICY>( execution_policy ) };
+    }
+    
+    namespace impl
+    {
+        /*
+         * Wraps a manual engine so its steps test a property (See basic_manual_engine::step( quantifier , property )).
+         * Passed to the frame loop instead of the engine, it turns the running condition into reading
+         * the result of the last step.
+         */
+        template<typename ENGINE , typename PROPERTY>
+        struct tested_steps
+        {
+        public:
+            tested_steps( ENGINE& engine , sdst::quantifier quantifier , PROPERTY& property ) :
+                _engine( engine ),
+                _quantifier{ quantifier },
+                _property( property ),
+                _holds{ sdst::impl::test_scene( engine.scene() , quantifier , property ) } //In case there are frames without steps
+            {}
+            
+            void step()
+            {
+                _holds = _engine.step( _quantifier , std::ref( _property ) );
+            }
+            
+            void draw()
+            {
+                _engine.draw();
+            }
+            
+            void draw( float alpha )
+            {
+                _engine.draw( alpha );
+            }
+            
+            bool holds() const
+            {
+                return _holds;
+            }
+            
+        private:
+            ENGINE&          _engine;
+            sdst::quantifier _quantifier;
+            PROPERTY&        _property;
+            bool             _holds;
+        };
+        
+        /*
+         * The simulation loop shared by the automatic engines. Runs the frame stages (Given as callables
+         * with no parameters) on a manual engine until the running condition fails, one step per frame
+         * or with a fixed timestep, and times them. See basic_automatic_engine::fixed_timestep() and
+         * basic_automatic_engine::profile_every().
+         */
+        struct frame_loop
+        {
+        public:
+            frame_loop() :
+                _timestep{ 0.0 },
+                _max_steps{ 1 },
+                _accumulator{ 0.0 },
+                _alpha{ 1.0f },
+                _profiling_period{ 1 }
+            {}
+            
+            void fixed_timestep( double timestep , std::size_t max_steps )
+            {
+                _timestep    = timestep;
+                _max_steps   = std::max<std::size_t>( max_steps , 1 );
+                _accumulator = 0.0;
+                _alpha       = 1.0f;
+            }
+            
+            double timestep() const
+            {
+                return _timestep;
+            }
+            
+            float interpolation() const
+            {
+                return _alpha;
+            }
+            
+            void profile_every( std::size_t period )
+            {
+                _profiling_period = period;
+            }
+            
+            template<typename ENGINE , typename BEFORE_UPDATE , typename BEFORE_DRAW , typename BEFORE_NEXT , typename RUN_CONDITION>
+            sdst::simulation_result run( ENGINE& engine , BEFORE_UPDATE&& before_update , BEFORE_DRAW&& before_draw , BEFORE_NEXT&& before_next , RUN_CONDITION&& run_condition )
+            {
+                using clock_t = std::chrono::steady_clock;
+                
+                sdst::simulation_result result;
+                sdst::stage_profiler    profiler{ result , _profiling_period };
+                
+                const clock_t::time_point begin      = clock_t::now();
+                clock_t::time_point       last_frame = begin;
+                bool                      running;
+                
+                do
+                {
+                    profiler.begin_frame();
+                    
+                    if( _timestep > 0.0 )
+                    {
+                        const clock_t::time_point now = clock_t::now();
+                        
+                        _accumulator += std::chrono::duration<double>( now - last_frame ).count();
+                        last_frame    = now;
+                        
+                        for( std::size_t steps = 0 ; _accumulator >= _timestep ; ++steps )
+                        {
+                            if( steps == _max_steps )
+                            {
+                                _accumulator = std::fmod( _accumulator , _timestep );
+                                break;
+                            }
+                            
+                            clock_t::time_point t = profiler.now();
+                            before_update();
+                            t = profiler.record( sdst::stage::before_update , t );
+                            engine.step();
+                            profiler.record( sdst::stage::step , t );
+                            
+                            _accumulator -= _timestep;
+                            ++result.steps;
+                        }
+                        
+                        _alpha = static_cast<float>( _accumulator / _timestep );
+                        
+                        clock_t::time_point t = profiler.now();
+                        before_draw();
+                        t = profiler.record( sdst::stage::before_draw , t );
+                        engine.draw( _alpha );
+                        profiler.record( sdst::stage::draw , t );
+                    }
+                    else
+                    {
+                        clock_t::time_point t = profiler.now();
+                        before_update();
+                        t = profiler.record( sdst::stage::before_update , t );
+                        engine.step();
+                        t = profiler.record( sdst::stage::step , t );
+                        before_draw();
+                        t = profiler.record( sdst::stage::before_draw , t );
+                        engine.draw();
+                        profiler.record( sdst::stage::draw , t );
+                        
+                        ++result.steps;
+                    }
+                    
+                    ++result.frames;
+                    
+                    clock_t::time_point t = profiler.now();
+                    before_next();
+                    t = profiler.record( sdst::stage::before_next , t );
+                    running = run_condition();
+                    profiler.record( sdst::stage::run_condition , t );
+                }while( running );
+                
+                result.wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>( clock_t::now() - begin );
+                
+                return result;
+            }
+            
+        private:
+            double      _timestep;    //Zero means one step per frame
+            std::size_t _max_steps;
+            double      _accumulator; //Wall time not simulated yet
+            float       _alpha;
+            
+            std::size_t _profiling_period; //Zero means no profiling
+        };
+    }
+    
     /*
      * An automatic engine encapsulates a simulation loop which could be controlled
      * specifying the different stages of a simulation frame, and a running condition.
      */
-    template<typename SCENE , typename DRAW_POLICY>
+    template<typename SCENE , typename DRAW_POLICY , typename EXECUTION_POLICY = sdst::sequential_execution>
     struct basic_automatic_engine
     {
         /*
@@ -127,10 +694,15 @@ namespace sdst
          */
         using draw_policy_t = DRAW_POLICY;
         
+        /*
+         * The type of the execution policy used.
+         */
+        using execution_policy_t = EXECUTION_POLICY;
+        
         /*
          * An automatic engine manages a manual engine. This is the type of such engine.
          */
-        using underlying_engine_t = sdst::basic_manual_engine<scene_t,draw_policy_t>;
+        using underlying_engine_t = sdst::basic_manual_engine<scene_t,draw_policy_t,execution_policy_t>;
         
         /*
          * The type of the engine
@@ -159,23 +731,90 @@ namespace sdst
         
         
         /*
-         * Result of the simulation. Could contain profilling data, etc.
-         * Currently void.
+         * Result of the simulation: Frame count, wall time, and the latency of each
+         * simulation stage (See sdst::simulation_result).
          */
-        using simulation_result_t = void;
+        using simulation_result_t = sdst::simulation_result;
         
         
         /*
          * Initializes the engine passign the values to initialize the scene and the drawing policy
          */
-        basic_automatic_engine( const scene_t& scene , const draw_policy_t& draw_policy ) :
-            _engine{ scene , draw_policy },
+        basic_automatic_engine( const scene_t& scene , const draw_policy_t& draw_policy , const execution_policy_t& execution_policy = execution_policy_t{} ) :
+            _engine{ scene , draw_policy , execution_policy },
             _run_condition{ []( const engine_t& ){ return true; } },
             _before_update{ []( engine_t& ){} },
             _before_draw{ []( engine_t& ){} },
-            _before_next{ []( engine_t& ){} }
+            _before_next{ []( engine_t& ){} },
+            _stopped{ false },
+            _test_during_update{ false }
         {}
             
+        /*
+         * Decouples the simulation rate from the frame rate: Each frame the engine runs as many
+         * simulation steps of 'timestep' seconds as the wall time elapsed since the previous frame
+         * requires (0 if the frames are faster than the simulation, more than one if slower), up
+         * to 'max_steps' steps per frame. The time which can't be simulated in 'max_steps' steps is
+         * dropped, so a slow frame can't trigger a spiral of more and more steps per frame.
+         * 
+         * The before_update() action is performed before each step. The fraction of a step not yet
+         * simulated is passed to the draw policy as interpolation factor, if it accepts it (See
+         * basic_manual_engine::draw(float)), so it can blend the previous and the current states.
+         * 
+         * A timestep of zero restores the default mode, exactly one step per frame.
+         */
+        engine_t& fixed_timestep( double timestep , std::size_t max_steps = 5 )
+        {
+            _loop.fixed_timestep( timestep , max_steps );
+            
+            return *this;
+        }
+        
+        /*
+         * Returns the fixed timestep of the simulation, zero if the simulation runs one step per frame.
+         */
+        double timestep() const
+        {
+            return _loop.timestep();
+        }
+        
+        /*
+         * Returns the interpolation factor between the previous and the current simulation steps
+         * of the frame being drawn.
+         */
+        float interpolation() const
+        {
+            return _loop.interpolation();
+        }
+        
+        /*
+         * Sets how often the simulation stages are timed: One of each 'period' frames is sampled
+         * into the simulation result histograms. Zero disables the sampling. By default all the
+         * frames are sampled, which costs a few steady_clock reads per frame.
+         */
+        engine_t& profile_every( std::size_t period )
+        {
+            _loop.profile_every( period );
+            
+            return *this;
+        }
+        
+        /*
+         * Makes run_while_all(), run_while_any(), run_until_all() and run_until_any() test the property
+         * during the update of the scene, on each particle right after its update, instead of traversing
+         * the whole scene again after each frame (See basic_manual_engine::step( quantifier , property )).
+         * The running condition is then just the result of the last step.
+         * 
+         * Note the property sees the particles as updated: Changes done by the before_draw() and before_next()
+         * actions are not tested until the next step. With a parallel execution policy the property is
+         * called concurrently.
+         */
+        engine_t& test_during_update( bool enabled = true )
+        {
+            _test_during_update = enabled;
+            
+            return *this;
+        }
         
         /*
          * Specifies the action to be performed before the engine updates the state of
@@ -222,22 +861,17 @@ namespace sdst
          */
         simulation_result_t start()
         {
-            do
-            {
-                _before_update( *this );
-                _engine.step();
-                _before_draw( *this );
-                _engine.draw();
-                _before_next( *this );  
-            }while( _run_condition( *this ) );
+            return start( _engine , _run_condition );
         }
         
         /*
-         * Stops the simulation setting the running condition to false.
+         * Stops the simulation setting the running condition to false. Also stops runs with
+         * their own condition (See test_during_update()).
          */
         void stop()
         {
             _run_condition = []( const engine_t& ){ return false; };
+            _stopped       = true;
         }
         
         /*
@@ -263,7 +897,10 @@ namespace sdst
         template<typename PROPERTY>
         simulation_result_t run_while_all( PROPERTY property )
         {
-            run_while( [&]( const engine_t& e )
+            if( _test_during_update )
+                return run_tested( sdst::quantifier::all , true , property );
+            
+            return run_while( [&]( const engine_t& e )
             {
                 return std::all_of( std::begin( e.scene() ) , std::end( e.scene() ) , property );
             });
@@ -276,7 +913,10 @@ namespace sdst
         template<typename PROPERTY>
         simulation_result_t run_while_any( PROPERTY property )
         {
-            run_while( [&]( const engine_t& e )
+            if( _test_during_update )
+                return run_tested( sdst::quantifier::any , true , property );
+            
+            return run_while( [&]( const engine_t& e )
             {
                 return std::any_of( std::begin( e.scene() ) , std::end( e.scene() ) , property );
             });
@@ -289,7 +929,10 @@ namespace sdst
         template<typename PROPERTY>
         simulation_result_t run_until_all( PROPERTY property )
         {
-            run_until( [&]( const engine_t& e )
+            if( _test_during_update )
+                return run_tested( sdst::quantifier::all , false , property );
+            
+            return run_until( [&]( const engine_t& e )
             {
                 return std::all_of( std::begin( e.scene() ) , std::end( e.scene() ) , property );
             });
@@ -302,7 +945,10 @@ namespace sdst
         template<typename PROPERTY>
         simulation_result_t run_until_any( PROPERTY property )
         {
-            run_until( [&]( const engine_t& e )
+            if( _test_during_update )
+                return run_tested( sdst::quantifier::any , false , property );
+            
+            return run_until( [&]( const engine_t& e )
             {
                 return std::any_of( std::begin( e.scene() ) , std::end( e.scene() ) , property );
             });
@@ -324,6 +970,19 @@ namespace sdst
         {
             return _engine.scene();
         }
+        
+        /*
+         * Gives access to the arena of the shared policies of the scene.
+         */
+        sdst::policy_arena& policies()
+        {
+            return _engine.policies();
+        }
+        
+        const sdst::policy_arena& policies() const
+        {
+            return _engine.policies();
+        }
     private:
         underlying_engine_t _engine;
         
@@ -331,6 +990,39 @@ namespace sdst
         mutable_action_t    _before_update;
         mutable_action_t    _before_draw; //Note that after update is before draw too.
         mutable_action_t    _before_next; //After draw is before next iteration.
+        
+        sdst::impl::frame_loop _loop;
+        bool                   _stopped;
+        bool                   _test_during_update;
+        
+        /*
+         * Runs the simulation loop on the manual engine, or on a wrapper of it, while the condition holds.
+         */
+        template<typename ENGINE , typename CONDITION>
+        simulation_result_t start( ENGINE& engine , CONDITION& condition )
+        {
+            _stopped = false;
+            
+            return _loop.run( engine ,
+                              [this](){ _before_update( *this ); } ,
+                              [this](){ _before_draw( *this ); } ,
+                              [this](){ _before_next( *this ); } ,
+                              [this,&condition](){ return !_stopped && condition( *this ); } );
+        }
+        
+        /*
+         * Runs the simulation while the quantified property tested during the updates equals 'expected'.
+         * The condition is local to this run, the running condition of the engine is left as is.
+         */
+        template<typename PROPERTY>
+        simulation_result_t run_tested( sdst::quantifier quantifier , bool expected , PROPERTY& property )
+        {
+            sdst::impl::tested_steps<underlying_engine_t,PROPERTY> steps{ _engine , quantifier , property };
+            
+            auto condition = [&steps,expected]( const engine_t& ){ return steps.holds() == expected; };
+            
+            return start( steps , condition );
+        }
     };
     
     template<typename SCENE , typename DRAW_POLICY>
@@ -338,6 +1030,12 @@ namespace sdst
     {
         return { std::forward<SCENE>( scene ) , std::forward<DRAW_POLICY>( draw_policy ) };
     }
+    
+    template<typename SCENE , typename DRAW_POLICY , typename EXECUTION_POLICY>
+    sdst::basic_automatic_engine<typename std::decay<SCENE>::type,typename std::decay<DRAW_POLICY>::type,typename std::decay<EXECUTION_POLICY>::type> make_basic_automatic_engine( SCENE&& scene , DRAW_POLICY&& draw_policy , EXECUTION_POLICY&& execution_policy )
+    {
+        return { std::forward<SCENE>( scene ) , std::forward<DRAW_POLICY>( draw_policy ) , std::forward<EXECUTION_POLICY>( execution_policy ) };
+    }
 }
 
 #endif	/* ENGINE_HPP */
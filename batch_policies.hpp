@@ -0,0 +1,53 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef BATCH_POLICIES_HPP
+#define	BATCH_POLICIES_HPP
+
+#include <cstddef>
+
+#include "Turbo/type_traits.hpp"
+
+/*
+ * An evolution policy usually evolves one particle per call. When the particles of a scene share
+ * their policy and are stored contiguously (See homogeneous_scene.hpp and soa_scene.hpp), the scene
+ * can hand whole blocks of particles to the policy instead, so the policy can be written as a
+ * vectorized (or BLAS-like) kernel. The signature of such batch call is:
+ *
+ *     void(FIRST first , std::size_t count)
+ *
+ * where 'first' refers to the first particle of the block. FIRST depends on the scene layout:
+ * A 'DATA*' for homogeneous scenes, a 'const sdst::soa_particle<SCENE>&' (whose columns are
+ * contiguous from that particle) for SoA scenes.
+ *
+ * As with stated policies, the signature is detected at compile-time. Policies which only support the
+ * per-particle signature keep working, the scene just calls them once per particle.
+ */
+
+namespace sdst
+{
+    /*
+     * Checks whether POLICY supports the batch evolution signature for blocks starting at FIRST.
+     * Evaluates to tml::true_type or tml::false_type.
+     */
+    template<typename POLICY , typename FIRST>
+    using is_batch_policy = tml::is_valid_call<POLICY,FIRST,std::size_t>;
+}
+
+#endif	/* BATCH_POLICIES_HPP */
@@ -0,0 +1,127 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+/*
+ * Microbenchmark of the simulation loop overhead: sdst::basic_automatic_engine (Stages stored
+ * as std::functions) vs sdst::static_automatic_engine (Stages stored as their own types).
+ *
+ * The scene has a single particle and the stages do almost nothing, so the frame time is the
+ * cost of the loop itself. Build from the repository root with:
+ *
+ *     clang++ -std=c++11 -O2 -I. -pthread benchmarks/hook_pipeline.cpp -o hook_pipeline
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "basic_engines.hpp"
+#include "homogeneous_scene.hpp"
+#include "static_engine.hpp"
+
+struct data
+{
+    float x;
+};
+
+struct evolution
+{
+    void operator()( data& d ) const
+    {
+        d.x += 1.0f;
+    }
+};
+
+struct drawing
+{
+    void operator()( const data& ) const
+    {}
+};
+
+struct scene_drawing
+{
+    template<typename SCENE>
+    void operator()( const SCENE& ) const
+    {}
+};
+
+using scene_t = sdst::homogeneous_scene<data,evolution,drawing>;
+
+static const std::size_t frames      = 2000000;
+static const std::size_t repetitions = 5;
+
+/*
+ * Runs the simulation 'repetitions' times and returns the best time per frame, in nanoseconds.
+ */
+template<typename RUN>
+double best_frame_time( RUN run )
+{
+    double best = 0.0;
+
+    for( std::size_t i = 0 ; i < repetitions ; ++i )
+    {
+        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        run();
+        const double elapsed = std::chrono::duration<double,std::nano>( std::chrono::steady_clock::now() - begin ).count() / frames;
+
+        best = i == 0 ? elapsed : std::min( best , elapsed );
+    }
+
+    return best;
+}
+
+int main()
+{
+    const scene_t scene{ std::vector<data>( 1 , data{ 0.0f } ) , evolution{} , drawing{} };
+
+    std::size_t updates = 0 , draws = 0 , nexts = 0 , frame = 0;
+
+    auto dynamic_engine = sdst::make_basic_automatic_engine( scene , scene_drawing{} );
+
+    dynamic_engine.profile_every( 0 )
+                  .before_update( [&]( decltype( dynamic_engine )& ){ ++updates; } )
+                  .before_draw( [&]( decltype( dynamic_engine )& ){ ++draws; } )
+                  .before_next( [&]( decltype( dynamic_engine )& ){ ++nexts; } );
+
+    auto static_engine = sdst::make_static_automatic_engine( scene , scene_drawing{} )
+                         .before_update( [&]( scene_t& ){ ++updates; } )
+                         .before_draw( [&]( scene_t& ){ ++draws; } )
+                         .before_next( [&]( scene_t& ){ ++nexts; } );
+
+    static_engine.profile_every( 0 );
+
+    const double dynamic_time = best_frame_time( [&]()
+    {
+        frame = 0;
+        dynamic_engine.run_while( [&]( const decltype( dynamic_engine )& ){ return ++frame < frames; } );
+    });
+
+    const double static_time = best_frame_time( [&]()
+    {
+        frame = 0;
+        static_engine.run_while( [&]( const scene_t& ){ return ++frame < frames; } );
+    });
+
+    std::cout << "engine,ns_per_frame\n"
+              << "basic_automatic_engine," << dynamic_time << "\n"
+              << "static_automatic_engine," << static_time << "\n"
+              << "(" << updates + draws + nexts << " stage calls)\n";
+}
@@ -0,0 +1,571 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+/*
+ * Scaling benchmark of the simulation step: Sweeps scene sizes, data layouts, engine variants and
+ * thread counts, running the same kinematics (Gravity, Euler integration and box bounces, see
+ * forces.hpp) on each configuration. For each one it reports:
+ *
+ *  - ns_per_particle_step: Best time of a step over the repetitions, divided by the scene size.
+ *  - bandwidth_gb_s:       Effective memory bandwidth, taking each step as a read and a write of the
+ *                          particle storage of the layout (An estimate, caches make it go over the
+ *                          hardware bandwidth on small scenes).
+ *  - scaling_efficiency:   Speedup over the smallest thread count of the sweep, divided by the
+ *                          increase in threads (1 is perfect scaling).
+ *
+ * The layouts are "aos" (A std::vector of sdst::particle, each one with its own policies), "homogeneous"
+ * (sdst::homogeneous_scene), "soa" (sdst::soa_scene storing only the position and velocity columns) and
+ * "pool" (sdst::pool_scene). The engine variants are "manual" (basic_manual_engine::step()), "fused"
+ * (basic_manual_engine::step( quantifier , property ), the update with a property test) and "static"
+ * (The simulation loop of sdst::static_automatic_engine, with an empty draw).
+ *
+ * The results are written to the standard output as CSV (Default) or JSON, the progress to the standard
+ * error. Build and run through the Makefile (make benchmark), or from the repository root with:
+ *
+ *     clang++ -std=c++11 -O2 -march=native -I. -pthread benchmarks/scaling.cpp -o scaling
+ *     ./scaling --sizes 1000,1000000 --threads 1,4 --layouts homogeneous,soa --format json > scaling.json
+ *
+ * Options (Comma separated lists):
+ *
+ *     --sizes N,...         Scene sizes (Default: 1e3 to 1e7, a decade each)
+ *     --threads N,...       Thread counts (Default: powers of two up to the hardware concurrency)
+ *     --layouts NAME,...    Layouts (Default: all)
+ *     --engines NAME,...    Engine variants (Default: all)
+ *     --budget N            Particle updates per repetition, which sets the steps (Default: 5e7)
+ *     --repetitions N       Repetitions of each configuration (Default: 3)
+ *     --format csv|json
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "basic_engines.hpp"
+#include "execution_policies.hpp"
+#include "field.hpp"
+#include "forces.hpp"
+#include "homogeneous_scene.hpp"
+#include "particle.hpp"
+#include "pool_scene.hpp"
+#include "soa_scene.hpp"
+#include "static_engine.hpp"
+#include "thread_pool.hpp"
+
+struct vec2
+{
+    float x , y;
+};
+
+struct particle_data
+{
+    vec2          position;
+    vec2          velocity;
+    std::uint32_t color;
+};
+
+using position = SDST_FIELD( particle_data , position );
+using velocity = SDST_FIELD( particle_data , velocity );
+
+using kinematics = sdst::kernel_chain<sdst::uniform_gravity<velocity>,sdst::euler_integration<position,velocity>,sdst::box_bounce<position,velocity>>;
+
+static const float dt = 1.0f / 60.0f;
+
+kinematics make_kinematics()
+{
+    return sdst::make_kernel_chain( sdst::uniform_gravity<velocity>{ 0.0f , 98.0f , dt } ,
+                                    sdst::euler_integration<position,velocity>{ dt } ,
+                                    sdst::box_bounce<position,velocity>{ 0.0f , 0.0f , 1000.0f , 1000.0f , 0.9f } );
+}
+
+struct drawing
+{
+    void operator()( const particle_data& ) const
+    {}
+};
+
+struct scene_drawing
+{
+    template<typename SCENE>
+    void operator()( const SCENE& ) const
+    {}
+};
+
+/*
+ * Property tested by the fused variant. Always holds, so every particle is tested.
+ */
+struct inside_box
+{
+    template<typename PARTICLE>
+    bool operator()( const PARTICLE& particle ) const
+    {
+        return particle.data().position.y <= 1000.0f;
+    }
+};
+
+/*
+ * The layouts: How to build the scene from the initial data, and how many bytes of storage a step
+ * traverses per particle.
+ */
+struct aos_layout
+{
+    using particle_t = sdst::particle<particle_data,kinematics,drawing>;
+    using scene_t    = std::vector<particle_t>;
+
+    static const char* name()
+    {
+        return "aos";
+    }
+
+    static scene_t make( const std::vector<particle_data>& data )
+    {
+        scene_t scene;
+        scene.reserve( data.size() );
+
+        for( const particle_data& d : data )
+            scene.emplace_back( d , make_kinematics() , drawing{} );
+
+        return scene;
+    }
+
+    static std::size_t bytes_per_particle()
+    {
+        return sizeof( particle_t );
+    }
+};
+
+struct homogeneous_layout
+{
+    using scene_t = sdst::homogeneous_scene<particle_data,kinematics,drawing>;
+
+    static const char* name()
+    {
+        return "homogeneous";
+    }
+
+    static scene_t make( const std::vector<particle_data>& data )
+    {
+        return { data , make_kinematics() , drawing{} };
+    }
+
+    static std::size_t bytes_per_particle()
+    {
+        return sizeof( particle_data );
+    }
+};
+
+struct soa_layout
+{
+    using scene_t = sdst::soa_scene<particle_data,kinematics,drawing,position,velocity>;
+
+    static const char* name()
+    {
+        return "soa";
+    }
+
+    static scene_t make( const std::vector<particle_data>& data )
+    {
+        scene_t scene{ make_kinematics() , drawing{} };
+        scene.reserve( data.size() );
+
+        for( const particle_data& d : data )
+            scene.push_back( d );
+
+        return scene;
+    }
+
+    static std::size_t bytes_per_particle()
+    {
+        return sizeof( position::value_t ) + sizeof( velocity::value_t );
+    }
+};
+
+struct pool_layout
+{
+    using scene_t = sdst::pool_scene<particle_data,kinematics,drawing>;
+
+    static const char* name()
+    {
+        return "pool";
+    }
+
+    static scene_t make( const std::vector<particle_data>& data )
+    {
+        scene_t scene{ data.size() , make_kinematics() , drawing{} };
+
+        for( const particle_data& d : data )
+            scene.spawn( d );
+
+        return scene;
+    }
+
+    static std::size_t bytes_per_particle()
+    {
+        return sizeof( particle_data ) + sizeof( float ); //Data and lifetime
+    }
+};
+
+struct options
+{
+    std::vector<std::size_t> sizes;
+    std::vector<std::size_t> threads;
+    std::vector<std::string> layouts;
+    std::vector<std::string> engines;
+    std::size_t              budget;
+    std::size_t              repetitions;
+    std::string              format;
+};
+
+struct sample
+{
+    std::string layout;
+    std::string engine;
+    std::size_t size;
+    std::size_t threads;
+    std::size_t steps;
+    double      ns_per_particle_step;
+    double      bandwidth_gb_s;
+    double      scaling_efficiency;
+};
+
+std::vector<particle_data> initial_data( std::size_t size )
+{
+    std::mt19937                          random{ 42 };
+    std::uniform_real_distribution<float> coordinate{ 0.0f , 1000.0f };
+    std::uniform_real_distribution<float> speed{ -100.0f , 100.0f };
+    std::vector<particle_data>            data( size );
+
+    for( particle_data& d : data )
+        d = particle_data{ { coordinate( random ) , coordinate( random ) } , { speed( random ) , speed( random ) } , static_cast<std::uint32_t>( random() ) };
+
+    return data;
+}
+
+using clock_type = std::chrono::steady_clock;
+
+double elapsed_ns( clock_type::time_point begin )
+{
+    return std::chrono::duration<double,std::nano>( clock_type::now() - begin ).count();
+}
+
+/*
+ * Runs 'steps' steps of an engine variant 'repetitions' times, returning the best time per step in nanoseconds.
+ */
+template<typename LAYOUT , typename EXECUTION_POLICY>
+double best_step_time( const std::string& engine , const std::vector<particle_data>& data , const EXECUTION_POLICY& execution_policy ,
+                       std::size_t steps , std::size_t repetitions )
+{
+    double best = 0.0;
+
+    if( engine == "static" )
+    {
+        auto simulation = sdst::make_static_automatic_engine( LAYOUT::make( data ) , scene_drawing{} , execution_policy );
+
+        for( std::size_t r = 0 ; r <= repetitions ; ++r )
+        {
+            std::size_t frame = 0;
+
+            const clock_type::time_point begin  = clock_type::now();
+            const sdst::simulation_result result = simulation.run_while( [&]( const typename LAYOUT::scene_t& ){ return frame++ < steps; } );
+            const double                  time   = elapsed_ns( begin ) / std::max<std::size_t>( result.steps , 1 );
+
+            if( r > 0 && ( best == 0.0 || time < best ) ) //The first run warms up
+                best = time;
+        }
+    }
+    else
+    {
+        auto simulation = sdst::make_basic_manual_engine( LAYOUT::make( data ) , scene_drawing{} , execution_policy );
+        bool holds      = true;
+
+        for( std::size_t r = 0 ; r <= repetitions ; ++r )
+        {
+            const clock_type::time_point begin = clock_type::now();
+
+            for( std::size_t s = 0 ; s < steps ; ++s )
+            {
+                if( engine == "fused" )
+                    holds &= simulation.step( sdst::quantifier::all , inside_box{} );
+                else
+                    simulation.step();
+            }
+
+            const double time = elapsed_ns( begin ) / steps;
+
+            if( r > 0 && ( best == 0.0 || time < best ) )
+                best = time;
+        }
+
+        if( !holds )
+            std::cerr << "warning: the fused property didn't hold\n";
+    }
+
+    return best;
+}
+
+template<typename LAYOUT , typename EXECUTION_POLICY>
+void run_layout( const options& opts , std::size_t threads , const EXECUTION_POLICY& execution_policy , std::vector<sample>& samples )
+{
+    if( std::find( opts.layouts.begin() , opts.layouts.end() , LAYOUT::name() ) == opts.layouts.end() )
+        return;
+
+    for( std::size_t size : opts.sizes )
+    {
+        const std::vector<particle_data> data  = initial_data( size );
+        const std::size_t                steps = std::max<std::size_t>( opts.budget / std::max<std::size_t>( size , 1 ) , 3 );
+
+        for( const std::string& engine : opts.engines )
+        {
+            std::cerr << LAYOUT::name() << " " << engine << " size=" << size << " threads=" << threads << "..." << std::flush;
+
+            const double step_ns = best_step_time<LAYOUT>( engine , data , execution_policy , steps , opts.repetitions );
+
+            sample s;
+            s.layout               = LAYOUT::name();
+            s.engine               = engine;
+            s.size                 = size;
+            s.threads              = threads;
+            s.steps                = steps;
+            s.ns_per_particle_step = step_ns / size;
+            s.bandwidth_gb_s       = 2.0 * LAYOUT::bytes_per_particle() * size / step_ns; //Bytes per ns = GB/s
+            s.scaling_efficiency   = 1.0;
+
+            samples.push_back( s );
+
+            std::cerr << " " << s.ns_per_particle_step << " ns/particle/step\n";
+        }
+    }
+}
+
+template<typename EXECUTION_POLICY>
+void run_threads( const options& opts , std::size_t threads , const EXECUTION_POLICY& execution_policy , std::vector<sample>& samples )
+{
+    run_layout<aos_layout>( opts , threads , execution_policy , samples );
+    run_layout<homogeneous_layout>( opts , threads , execution_policy , samples );
+    run_layout<soa_layout>( opts , threads , execution_policy , samples );
+    run_layout<pool_layout>( opts , threads , execution_policy , samples );
+}
+
+/*
+ * Sets the scaling efficiency of each sample, relative to the sample of the same configuration with the
+ * smallest thread count.
+ */
+void compute_efficiency( std::vector<sample>& samples )
+{
+    std::map<std::tuple<std::string,std::string,std::size_t>,const sample*> baselines;
+
+    for( const sample& s : samples )
+    {
+        const sample*& baseline = baselines[std::make_tuple( s.layout , s.engine , s.size )];
+
+        if( baseline == nullptr || s.threads < baseline->threads )
+            baseline = &s;
+    }
+
+    for( sample& s : samples )
+    {
+        const sample& baseline = *baselines[std::make_tuple( s.layout , s.engine , s.size )];
+        const double  speedup  = baseline.ns_per_particle_step / s.ns_per_particle_step;
+
+        s.scaling_efficiency = speedup * baseline.threads / s.threads;
+    }
+}
+
+void write_csv( const std::vector<sample>& samples , std::ostream& os )
+{
+    os << "layout,engine,size,threads,steps,ns_per_particle_step,bandwidth_gb_s,scaling_efficiency\n";
+
+    for( const sample& s : samples )
+    {
+        os << s.layout << "," << s.engine << "," << s.size << "," << s.threads << "," << s.steps << ","
+           << s.ns_per_particle_step << "," << s.bandwidth_gb_s << "," << s.scaling_efficiency << "\n";
+    }
+}
+
+void write_json( const std::vector<sample>& samples , std::ostream& os )
+{
+    os << "[\n";
+
+    for( std::size_t i = 0 ; i < samples.size() ; ++i )
+    {
+        const sample& s = samples[i];
+
+        os << "  { \"layout\": \"" << s.layout << "\", \"engine\": \"" << s.engine << "\", \"size\": " << s.size
+           << ", \"threads\": " << s.threads << ", \"steps\": " << s.steps
+           << ", \"ns_per_particle_step\": " << s.ns_per_particle_step << ", \"bandwidth_gb_s\": " << s.bandwidth_gb_s
+           << ", \"scaling_efficiency\": " << s.scaling_efficiency << " }" << ( i + 1 < samples.size() ? ",\n" : "\n" );
+    }
+
+    os << "]\n";
+}
+
+std::vector<std::string> split( const std::string& list )
+{
+    std::vector<std::string> items;
+    std::istringstream       is{ list };
+    std::string              item;
+
+    while( std::getline( is , item , ',' ) )
+    {
+        if( !item.empty() )
+            items.push_back( item );
+    }
+
+    return items;
+}
+
+/*
+ * Parses a list of positive integers (Scientific notation like 1e6 is accepted). Returns false if
+ * the list is empty or any item is not a positive integer.
+ */
+bool split_numbers( const std::string& list , std::vector<std::size_t>& numbers )
+{
+    numbers.clear();
+
+    for( const std::string& item : split( list ) )
+    {
+        char*        end    = nullptr;
+        const double number = std::strtod( item.c_str() , &end );
+
+        if( *end != '\0' || !( number >= 1.0 && number <= 1e18 ) || number != std::floor( number ) )
+            return false;
+
+        numbers.push_back( static_cast<std::size_t>( number ) );
+    }
+
+    return !numbers.empty();
+}
+
+/*
+ * Parses a list of names, each one of 'known'. Returns false if the list is empty or any name is unknown.
+ */
+bool split_names( const std::string& list , const std::vector<std::string>& known , std::vector<std::string>& names )
+{
+    names = split( list );
+
+    for( const std::string& name : names )
+    {
+        if( std::find( known.begin() , known.end() , name ) == known.end() )
+            return false;
+    }
+
+    return !names.empty();
+}
+
+int usage( const std::string& error )
+{
+    std::cerr << error << "\n"
+              << "Usage: scaling [--sizes N,...] [--threads N,...] [--layouts NAME,...] [--engines NAME,...]"
+              << " [--budget N] [--repetitions N] [--format csv|json]\n";
+
+    return EXIT_FAILURE;
+}
+
+int main( int argc , char* argv[] )
+{
+    const std::vector<std::string> layouts = { "aos" , "homogeneous" , "soa" , "pool" };
+    const std::vector<std::string> engines = { "manual" , "fused" , "static" };
+
+    options opts;
+    opts.sizes       = { 1000 , 10000 , 100000 , 1000000 , 10000000 };
+    opts.layouts     = layouts;
+    opts.engines     = engines;
+    opts.budget      = 50000000;
+    opts.repetitions = 3;
+    opts.format      = "csv";
+
+    const std::size_t hardware_threads = std::max<unsigned>( std::thread::hardware_concurrency() , 1 );
+
+    for( std::size_t threads = 1 ; threads < hardware_threads ; threads *= 2 )
+        opts.threads.push_back( threads );
+
+    opts.threads.push_back( hardware_threads );
+
+    for( int i = 1 ; i < argc ; ++i )
+    {
+        const std::string option = argv[i];
+
+        if( i + 1 >= argc )
+            return usage( "Missing value of " + option );
+
+        const std::string value = argv[++i];
+        bool              valid = true;
+
+        if( option == "--sizes" )
+            valid = split_numbers( value , opts.sizes );
+        else if( option == "--threads" )
+            valid = split_numbers( value , opts.threads );
+        else if( option == "--layouts" )
+            valid = split_names( value , layouts , opts.layouts );
+        else if( option == "--engines" )
+            valid = split_names( value , engines , opts.engines );
+        else if( option == "--budget" || option == "--repetitions" )
+        {
+            std::vector<std::size_t> numbers;
+
+            valid = split_numbers( value , numbers ) && numbers.size() == 1;
+
+            if( valid )
+                ( option == "--budget" ? opts.budget : opts.repetitions ) = numbers[0];
+        }
+        else if( option == "--format" )
+        {
+            valid       = value == "csv" || value == "json";
+            opts.format = value;
+        }
+        else
+            return usage( "Unknown option " + option );
+
+        if( !valid )
+            return usage( "Invalid value of " + option + ": " + value );
+    }
+
+    std::vector<sample> samples;
+
+    for( std::size_t threads : opts.threads )
+    {
+        if( threads <= 1 )
+        {
+            run_threads( opts , 1 , sdst::sequential_execution{} , samples );
+        }
+        else
+        {
+            sdst::thread_pool pool{ threads };
+
+            run_threads( opts , threads , sdst::parallel_execution{ pool } , samples );
+        }
+    }
+
+    compute_efficiency( samples );
+
+    if( opts.format == "json" )
+        write_json( samples , std::cout );
+    else
+        write_csv( samples , std::cout );
+}
@@ -0,0 +1,445 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef CHECKPOINT_HPP
+#define	CHECKPOINT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "compression.hpp"
+#include "policy_arena.hpp"
+#include "shared_policy.hpp"
+#include "staging_queue.hpp"
+
+/*
+ * Checkpoints of long simulations, saved without stalling the frame loop: Saving a checkpoint copies the
+ * particle data (And the registered policy state) into a staging buffer, a memcpy, and the compression and
+ * the file writing run in a background thread. Loading a checkpoint restores the scene from the file, which
+ * is just decompressing and copying the data back:
+ *
+ *     sdst::checkpointer checkpoints;
+ *
+ *     checkpoints.track( random ); //Policy state saved with each checkpoint (Trivially copyable)
+ *
+ *     engine.before_next( [&]( engine_t& engine )
+ *     {
+ *         if( ++frame % 3600 == 0 )
+ *             checkpoints.save( engine.scene() , "simulation.checkpoint" , frame );
+ *     });
+ *
+ *     std::uint64_t frame;
+ *     checkpoints.load( engine.scene() , "simulation.checkpoint" , &frame );
+ *
+ * The scene should store its trivially copyable particle data contiguously (A std::vector, sdst::homogeneous_scene,
+ * sdst::pool_scene, whose lifetimes are saved too). The policies of the particles are not saved, they are part
+ * of the scene type; only the state explicitly tracked is.
+ *
+ * If the previous checkpoints are still being written when a new one is requested (All the staging buffers
+ * are in flight), the new one is skipped instead of waiting. Files are written to a temporary file first
+ * and then renamed, so a crash while writing never leaves a truncated checkpoint.
+ *
+ * The file format is a header and a list of sections, written in the byte order of the machine:
+ *
+ *     header:  "SDSTCKPT" , uint32 version , uint32 section count , uint64 frame
+ *     section: uint32 kind , uint32 element size , uint64 size , uint64 stored size , stored bytes
+ *
+ * Sections are shuffled by element and compressed (See compression.hpp), or stored shuffled but uncompressed
+ * if compression doesn't make them smaller (stored size == size).
+ */
+
+namespace sdst
+{
+    /*
+     * The kinds of sections of a checkpoint file.
+     */
+    enum class checkpoint_section : std::uint32_t
+    {
+        data      = 1, //The particle data
+        lifetimes = 2, //The lifetimes of the particles of pool scenes
+        state     = 3  //A tracked state, in tracking order
+    };
+
+    namespace impl
+    {
+        /*
+         * Gives the lifetimes of pool scenes, or nullptr for other scenes.
+         */
+        template<typename SCENE>
+        auto scene_lifetimes( SCENE& scene , int ) -> decltype( scene.lifetimes() )
+        {
+            return scene.lifetimes();
+        }
+
+        template<typename SCENE>
+        std::nullptr_t scene_lifetimes( SCENE& , long )
+        {
+            return nullptr;
+        }
+
+        /*
+         * Sets the number of particles of a scene. Pool scenes fail if it exceeds their capacity.
+         */
+        template<typename SCENE>
+        auto resize_scene( SCENE& scene , std::size_t size , int ) -> decltype( scene.allocate( size ) , scene.capacity() , bool() )
+        {
+            if( size > scene.capacity() )
+                return false;
+
+            scene.clear();
+            scene.allocate( size );
+
+            return true;
+        }
+
+        template<typename SCENE>
+        bool resize_scene( SCENE& scene , std::size_t size , long )
+        {
+            scene.resize( size );
+
+            return true;
+        }
+    }
+
+    struct checkpointer
+    {
+    public:
+        enum : std::uint32_t { version = 1 };
+
+        /*
+         * Initializes the checkpointer, with 'staging_buffers' checkpoints in flight at most.
+         */
+        explicit checkpointer( std::size_t staging_buffers = 2 ) :
+            _saved{ 0 },
+            _skipped{ 0 },
+            _failed{ 0 },
+            _queue{ staging_buffers , [this]( staging& checkpoint ){ write( checkpoint ); } }
+        {}
+
+        /*
+         * Tracks a state to be saved with each checkpoint and restored by load(). The state should be trivially
+         * copyable, and outlive the checkpointer. States are matched by tracking order, so loading requires the
+         * same states tracked in the same order as when saving.
+         */
+        template<typename STATE>
+        void track( STATE& state )
+        {
+            static_assert( std::is_trivially_copyable<STATE>::value , "Checkpoints can only track trivially copyable states" );
+
+            _tracked.push_back( tracked_state{ &state , sizeof( STATE ) } );
+        }
+
+        /*
+         * Tracks the state of a policy shared through a handle (Not the handle itself).
+         */
+        template<typename POLICY>
+        void track( const sdst::arena_policy<POLICY>& policy )
+        {
+            track( policy.get() );
+        }
+
+        template<typename POLICY>
+        void track( const sdst::shared_policy<POLICY>& policy )
+        {
+            track( policy.get() );
+        }
+
+        /*
+         * Saves a checkpoint of the scene (And the tracked states) to the file 'path'. Only copies the
+         * state, the file is written in the background. Returns false, without saving, if all the staging
+         * buffers are still in flight.
+         */
+        template<typename SCENE>
+        bool save( const SCENE& scene , const std::string& path , std::uint64_t frame = 0 )
+        {
+            using data_t = typename std::decay<decltype( *scene.data() )>::type;
+
+            static_assert( std::is_trivially_copyable<data_t>::value , "Checkpoints require trivially copyable particle data" );
+
+            staging* checkpoint = _queue.try_acquire();
+
+            if( checkpoint == nullptr )
+            {
+                ++_skipped;
+                return false;
+            }
+
+            checkpoint->path  = path;
+            checkpoint->frame = frame;
+            checkpoint->sections.clear();
+            checkpoint->used  = 0;
+
+            stage( *checkpoint , sdst::checkpoint_section::data , sizeof( data_t ) , scene.data() , scene.size() * sizeof( data_t ) );
+            stage_lifetimes( *checkpoint , sdst::impl::scene_lifetimes( scene , 0 ) , scene.size() );
+
+            for( const tracked_state& state : _tracked )
+                stage( *checkpoint , sdst::checkpoint_section::state , state.size , state.state , state.size );
+
+            _queue.submit( checkpoint );
+
+            return true;
+        }
+
+        /*
+         * Restores the scene (And the tracked states) from the checkpoint file 'path', and its frame if 'frame'
+         * is not null. Returns false if the file can't be read, is corrupt, or doesn't match the scene (Different
+         * particle data size, too many particles for a pool scene, different tracked states). The scene may be
+         * partially restored on failure.
+         */
+        template<typename SCENE>
+        bool load( SCENE& scene , const std::string& path , std::uint64_t* frame = nullptr )
+        {
+            using data_t = typename std::decay<decltype( *scene.data() )>::type;
+
+            std::ifstream file{ path , std::ios::binary };
+            char          magic[8];
+            std::uint32_t file_version , sections;
+            std::uint64_t file_frame;
+
+            if( !read( file , magic ) || std::memcmp( magic , "SDSTCKPT" , 8 ) != 0 ||
+                !read( file , file_version ) || file_version != version || !read( file , sections ) || !read( file , file_frame ) )
+                return false;
+
+            std::vector<unsigned char> stored , raw;
+            std::size_t                states = 0;
+
+            for( std::uint32_t s = 0 ; s < sections ; ++s )
+            {
+                std::uint32_t kind , element_size;
+                std::uint64_t size , stored_size;
+
+                if( !read( file , kind ) || !read( file , element_size ) || !read( file , size ) || !read( file , stored_size ) )
+                    return false;
+
+                stored.resize( stored_size );
+                raw.resize( size );
+
+                if( !file.read( reinterpret_cast<char*>( stored.data() ) , stored_size ) )
+                    return false;
+
+                if( stored_size == size )
+                    raw.swap( stored );
+                else if( !sdst::compression::decompress( stored.data() , stored_size , raw.data() , size ) )
+                    return false;
+
+                switch( static_cast<sdst::checkpoint_section>( kind ) )
+                {
+                case sdst::checkpoint_section::data:
+                    if( element_size != sizeof( data_t ) || size % sizeof( data_t ) != 0 ||
+                        !sdst::impl::resize_scene( scene , size / sizeof( data_t ) , 0 ) )
+                        return false;
+
+                    sdst::compression::unshuffle( raw.data() , size , element_size , scene.data() );
+                    break;
+                case sdst::checkpoint_section::lifetimes:
+                    if( !restore_lifetimes( sdst::impl::scene_lifetimes( scene , 0 ) , raw , scene.size() ) )
+                        return false;
+                    break;
+                case sdst::checkpoint_section::state:
+                    if( states == _tracked.size() || _tracked[states].size != size )
+                        return false;
+
+                    sdst::compression::unshuffle( raw.data() , size , element_size , _tracked[states++].state );
+                    break;
+                default: //Unknown sections are skipped
+                    break;
+                }
+            }
+
+            if( states != _tracked.size() )
+                return false;
+
+            if( frame != nullptr )
+                *frame = file_frame;
+
+            return true;
+        }
+
+        /*
+         * Waits until the checkpoints in flight are written.
+         */
+        void wait()
+        {
+            _queue.wait();
+        }
+
+        /*
+         * Returns the number of checkpoints written, skipped (Staging buffers in flight), and failed to write.
+         */
+        std::size_t saved() const
+        {
+            return _saved;
+        }
+
+        std::size_t skipped() const
+        {
+            return _skipped;
+        }
+
+        std::size_t failed() const
+        {
+            return _failed;
+        }
+
+    private:
+        struct tracked_state
+        {
+            void*       state;
+            std::size_t size;
+        };
+
+        struct section
+        {
+            sdst::checkpoint_section kind;
+            std::uint32_t            element_size;
+            std::size_t              offset , size; //In the staging bytes
+        };
+
+        /*
+         * A checkpoint staged to be written. The byte buffers are reused between checkpoints.
+         */
+        struct staging
+        {
+            std::string                path;
+            std::uint64_t              frame;
+            std::vector<section>       sections;
+            std::vector<unsigned char> bytes;
+            std::size_t                used;       //Bytes of 'bytes' used
+            std::vector<unsigned char> shuffled;   //Scratch of the writer
+            std::vector<unsigned char> compressed;
+        };
+
+        void stage( staging& checkpoint , sdst::checkpoint_section kind , std::size_t element_size , const void* data , std::size_t size )
+        {
+            if( checkpoint.bytes.size() < checkpoint.used + size )
+                checkpoint.bytes.resize( checkpoint.used + size ); //Only grows, so it isn't cleared each time
+
+            std::memcpy( checkpoint.bytes.data() + checkpoint.used , data , size );
+
+            checkpoint.sections.push_back( section{ kind , static_cast<std::uint32_t>( element_size ) , checkpoint.used , size } );
+            checkpoint.used += size;
+        }
+
+        void stage_lifetimes( staging& checkpoint , const float* lifetimes , std::size_t size )
+        {
+            stage( checkpoint , sdst::checkpoint_section::lifetimes , sizeof( float ) , lifetimes , size * sizeof( float ) );
+        }
+
+        void stage_lifetimes( staging& , std::nullptr_t , std::size_t )
+        {}
+
+        static bool restore_lifetimes( float* lifetimes , const std::vector<unsigned char>& raw , std::size_t size )
+        {
+            if( raw.size() != size * sizeof( float ) )
+                return false;
+
+            sdst::compression::unshuffle( raw.data() , raw.size() , sizeof( float ) , lifetimes );
+
+            return true;
+        }
+
+        static bool restore_lifetimes( std::nullptr_t , const std::vector<unsigned char>& , std::size_t ) //Not a pool scene
+        {
+            return true;
+        }
+
+        template<typename T>
+        static bool read( std::ifstream& file , T& value )
+        {
+            return static_cast<bool>( file.read( reinterpret_cast<char*>( &value ) , sizeof( T ) ) );
+        }
+
+        template<typename T>
+        static void write( std::ofstream& file , const T& value )
+        {
+            file.write( reinterpret_cast<const char*>( &value ) , sizeof( T ) );
+        }
+
+        /*
+         * Compresses and writes a staged checkpoint. Runs in the background thread.
+         */
+        void write( staging& checkpoint )
+        {
+            const std::string temporary = checkpoint.path + ".tmp";
+
+            {
+                std::ofstream file{ temporary , std::ios::binary | std::ios::trunc };
+
+                file.write( "SDSTCKPT" , 8 );
+                write( file , static_cast<std::uint32_t>( version ) );
+                write( file , static_cast<std::uint32_t>( checkpoint.sections.size() ) );
+                write( file , checkpoint.frame );
+
+                for( const section& s : checkpoint.sections )
+                {
+                    const unsigned char* data = checkpoint.bytes.data() + s.offset;
+
+                    checkpoint.shuffled.resize( s.size );
+                    checkpoint.compressed.clear();
+
+                    sdst::compression::shuffle( data , s.size , s.element_size , checkpoint.shuffled.data() );
+                    sdst::compression::compress( checkpoint.shuffled.data() , s.size , checkpoint.compressed );
+
+                    //Uncompressed sections are stored shuffled too, load() always unshuffles them:
+                    const bool           compressed = checkpoint.compressed.size() < s.size;
+                    const unsigned char* stored     = compressed ? checkpoint.compressed.data() : checkpoint.shuffled.data();
+                    const std::uint64_t  size       = s.size;
+                    const std::uint64_t  stored_size = compressed ? checkpoint.compressed.size() : s.size;
+
+                    write( file , static_cast<std::uint32_t>( s.kind ) );
+                    write( file , s.element_size );
+                    write( file , size );
+                    write( file , stored_size );
+                    file.write( reinterpret_cast<const char*>( stored ) , stored_size );
+                }
+
+                file.close();
+
+                if( !file )
+                {
+                    std::remove( temporary.c_str() );
+                    ++_failed;
+                    return;
+                }
+            }
+
+            if( std::rename( temporary.c_str() , checkpoint.path.c_str() ) != 0 )
+            {
+                std::remove( temporary.c_str() );
+                ++_failed;
+                return;
+            }
+
+            ++_saved;
+        }
+
+        std::vector<tracked_state>  _tracked;
+        std::atomic<std::size_t>    _saved , _skipped , _failed;
+        sdst::staging_queue<staging> _queue; //Last: Its thread is the first thing stopped on destruction
+    };
+}
+
+#endif	/* CHECKPOINT_HPP */
@@ -0,0 +1,254 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef COMPRESSION_HPP
+#define	COMPRESSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+ * Lossless compression for the binary files written by the library (Checkpoints, recordings), with
+ * no dependencies.
+ *
+ * Particle data is mostly floats, whose bytes look random one by one but not byte plane by byte plane:
+ * The sign and exponent bytes of a column of positions are almost constant. So buffers of elements are
+ * shuffled first (The first bytes of all the elements, then the second bytes, etc), and then compressed
+ * with a LZ77 coder (In the spirit of LZ4: Byte-aligned sequences of literals and matches, fast to decode):
+ *
+ *     std::vector<unsigned char> shuffled( bytes ) , compressed;
+ *
+ *     sdst::compression::shuffle( data , bytes , sizeof( particle_data ) , shuffled.data() );
+ *     sdst::compression::compress( shuffled.data() , bytes , compressed );
+ *
+ *     sdst::compression::decompress( compressed.data() , compressed.size() , shuffled.data() , bytes );
+ *     sdst::compression::unshuffle( shuffled.data() , bytes , sizeof( particle_data ) , data );
+ */
+
+namespace sdst
+{
+    namespace compression
+    {
+        /*
+         * Transposes 'size' bytes of elements of 'element_size' bytes into byte planes. The bytes
+         * past the last whole element are copied as they are.
+         */
+        inline void shuffle( const void* source , std::size_t size , std::size_t element_size , void* destination )
+        {
+            const unsigned char* src   = static_cast<const unsigned char*>( source );
+            unsigned char*       dst   = static_cast<unsigned char*>( destination );
+            const std::size_t    count = element_size > 0 ? size / element_size : 0;
+
+            for( std::size_t b = 0 ; b < element_size && count > 0 ; ++b )
+                for( std::size_t i = 0 ; i < count ; ++i )
+                    dst[b * count + i] = src[i * element_size + b];
+
+            std::memcpy( dst + count * element_size , src + count * element_size , size - count * element_size );
+        }
+
+        /*
+         * Inverse of shuffle().
+         */
+        inline void unshuffle( const void* source , std::size_t size , std::size_t element_size , void* destination )
+        {
+            const unsigned char* src   = static_cast<const unsigned char*>( source );
+            unsigned char*       dst   = static_cast<unsigned char*>( destination );
+            const std::size_t    count = element_size > 0 ? size / element_size : 0;
+
+            for( std::size_t b = 0 ; b < element_size && count > 0 ; ++b )
+                for( std::size_t i = 0 ; i < count ; ++i )
+                    dst[i * element_size + b] = src[b * count + i];
+
+            std::memcpy( dst + count * element_size , src + count * element_size , size - count * element_size );
+        }
+
+        namespace impl
+        {
+            constexpr std::size_t min_match  = 4;
+            constexpr std::size_t max_offset = 65535;
+            constexpr int         hash_bits  = 14;
+
+            inline std::uint32_t read32( const unsigned char* p )
+            {
+                std::uint32_t x;
+
+                std::memcpy( &x , p , sizeof( x ) );
+
+                return x;
+            }
+
+            inline std::uint32_t hash( std::uint32_t x )
+            {
+                return ( x * 2654435761u ) >> ( 32 - hash_bits );
+            }
+
+            /*
+             * Lengths of 15 or more continue in the following bytes, 255 meaning "more bytes follow".
+             */
+            inline void write_length( std::vector<unsigned char>& out , std::size_t length )
+            {
+                for( ; length >= 255 ; length -= 255 )
+                    out.push_back( 255 );
+
+                out.push_back( static_cast<unsigned char>( length ) );
+            }
+
+            inline bool read_length( const unsigned char*& in , const unsigned char* end , std::size_t& length )
+            {
+                unsigned char byte;
+
+                do
+                {
+                    if( in == end )
+                        return false;
+
+                    byte    = *in++;
+                    length += byte;
+                }while( byte == 255 );
+
+                return true;
+            }
+
+            /*
+             * A sequence: A token (Literal length and match length, four bits each), the literals, and the
+             * match offset (The last sequence has no match).
+             */
+            inline void write_sequence( std::vector<unsigned char>& out , const unsigned char* literals , std::size_t literal_count , std::size_t offset , std::size_t match_length )
+            {
+                const std::size_t match_code = match_length > 0 ? match_length - min_match : 0;
+
+                out.push_back( static_cast<unsigned char>( ( literal_count < 15 ? literal_count : 15 ) << 4 | ( match_code < 15 ? match_code : 15 ) ) );
+
+                if( literal_count >= 15 )
+                    write_length( out , literal_count - 15 );
+
+                out.insert( out.end() , literals , literals + literal_count );
+
+                if( match_length > 0 )
+                {
+                    out.push_back( static_cast<unsigned char>( offset ) );
+                    out.push_back( static_cast<unsigned char>( offset >> 8 ) );
+
+                    if( match_code >= 15 )
+                        write_length( out , match_code - 15 );
+                }
+            }
+        }
+
+        /*
+         * Compresses 'size' bytes, appending the result to 'out'. Returns the number of bytes appended.
+         */
+        inline std::size_t compress( const void* source , std::size_t size , std::vector<unsigned char>& out )
+        {
+            const unsigned char* src    = static_cast<const unsigned char*>( source );
+            const std::size_t    before = out.size();
+
+            std::vector<std::uint32_t> table( std::size_t( 1 ) << sdst::compression::impl::hash_bits , 0 );
+
+            std::size_t anchor = 0 , i = 0;
+
+            while( i + sdst::compression::impl::min_match <= size )
+            {
+                const std::uint32_t word      = sdst::compression::impl::read32( src + i );
+                std::uint32_t&      slot      = table[sdst::compression::impl::hash( word )];
+                const std::size_t   candidate = slot;
+
+                slot = static_cast<std::uint32_t>( i );
+
+                if( candidate < i && i - candidate <= sdst::compression::impl::max_offset && sdst::compression::impl::read32( src + candidate ) == word )
+                {
+                    std::size_t length = sdst::compression::impl::min_match;
+
+                    while( i + length < size && src[candidate + length] == src[i + length] )
+                        ++length;
+
+                    sdst::compression::impl::write_sequence( out , src + anchor , i - anchor , i - candidate , length );
+
+                    i     += length;
+                    anchor = i;
+                }
+                else
+                    ++i;
+            }
+
+            sdst::compression::impl::write_sequence( out , src + anchor , size - anchor , 0 , 0 );
+
+            return out.size() - before;
+        }
+
+        /*
+         * Decompresses 'size' bytes into exactly 'decompressed_size' bytes. Returns false if the input
+         * is corrupt or doesn't decompress to that size.
+         */
+        inline bool decompress( const void* source , std::size_t size , void* destination , std::size_t decompressed_size )
+        {
+            const unsigned char* in      = static_cast<const unsigned char*>( source );
+            const unsigned char* in_end  = in + size;
+            unsigned char*       out     = static_cast<unsigned char*>( destination );
+            unsigned char* const first   = out;
+            unsigned char* const out_end = out + decompressed_size;
+
+            while( in < in_end )
+            {
+                const unsigned char token    = *in++;
+                std::size_t         literals = token >> 4;
+
+                if( literals == 15 && !sdst::compression::impl::read_length( in , in_end , literals ) )
+                    return false;
+
+                if( literals > static_cast<std::size_t>( in_end - in ) || literals > static_cast<std::size_t>( out_end - out ) )
+                    return false;
+
+                std::memcpy( out , in , literals );
+
+                in  += literals;
+                out += literals;
+
+                if( in == in_end ) //The last sequence has no match
+                    break;
+
+                if( in_end - in < 2 )
+                    return false;
+
+                const std::size_t offset = static_cast<std::size_t>( in[0] ) | static_cast<std::size_t>( in[1] ) << 8;
+                std::size_t       length = token & 15;
+
+                in += 2;
+
+                if( length == 15 && !sdst::compression::impl::read_length( in , in_end , length ) )
+                    return false;
+
+                length += sdst::compression::impl::min_match;
+
+                if( offset == 0 || offset > static_cast<std::size_t>( out - first ) || length > static_cast<std::size_t>( out_end - out ) )
+                    return false;
+
+                //Byte by byte: The match may overlap the bytes it produces (Runs).
+                for( const unsigned char* match = out - offset ; length > 0 ; --length )
+                    *out++ = *match++;
+            }
+
+            return out == out_end;
+        }
+    }
+}
+
+#endif	/* COMPRESSION_HPP */
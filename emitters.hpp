@@ -0,0 +1,397 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef EMITTERS_HPP
+#define	EMITTERS_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <utility>
+
+#include "Turbo/type_traits.hpp"
+
+#include "execution_policies.hpp"
+
+/*
+ * An emitter spawns particles into a scene: Each time its run it computes how many particles are due
+ * (At a continuous rate, in bursts, or both), allocates them at the end of the scene (See allocate() of
+ * sdst::pool_scene and sdst::homogeneous_scene) and initializes them in place, in chunks run through an
+ * execution policy. The scene is never grown particle by particle, and the policies of the scene are
+ * not copied, the emitter only writes particle data.
+ *
+ * Each new particle is given a position sampled from the emitter shape, and its data is set by the
+ * initializer of the emitter, a function with one of the signatures:
+ *
+ *     void( DATA& data , float x , float y );
+ *     void( DATA& data , float x , float y , sdst::emitter_random_engine& random );
+ *
+ * The data is value-initialized before the call. The random engine passed is seeded from the emitter
+ * seed and the number of particles emitted before, so the spawned particles don't depend on how the
+ * work is split. The initializer is called concurrently by parallel execution policies.
+ *
+ * Emitters are run from the engine actions, before the update:
+ *
+ *     auto fountain = sdst::make_emitter( sdst::disc_shape{ 400.0f , 300.0f , 10.0f } , init{} ).rate( 100000 ).lifetime( 1.0f , 2.0f );
+ *
+ *     engine.before_update( [&]( scene_t& scene ){ fountain.emit( scene , dt ); } );
+ */
+
+namespace sdst
+{
+    /*
+     * The random engine used by emitters.
+     */
+    using emitter_random_engine = std::minstd_rand;
+
+    namespace impl
+    {
+        /*
+         * Returns a uniformly distributed value in [min,max).
+         */
+        template<typename RNG>
+        float uniform( RNG& random , float min , float max )
+        {
+            return std::uniform_real_distribution<float>{ min , max }( random );
+        }
+
+        /*
+         * SplitMix64 finalizer: Turns consecutive integers into well distributed seeds.
+         */
+        inline std::uint64_t mix_seed( std::uint64_t x )
+        {
+            x += 0x9E3779B97F4A7C15ull;
+            x  = ( x ^ ( x >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+            x  = ( x ^ ( x >> 27 ) ) * 0x94D049BB133111EBull;
+
+            return x ^ ( x >> 31 );
+        }
+
+        /*
+         * Sets the lifetime of a particle, if the scene has lifetimes (See sdst::pool_scene).
+         */
+        template<typename SCENE>
+        auto set_lifetime( SCENE& scene , std::size_t index , float lifetime , int ) -> decltype( scene.lifetimes()[index] = lifetime , void() )
+        {
+            scene.lifetimes()[index] = lifetime;
+        }
+
+        template<typename SCENE>
+        void set_lifetime( SCENE& , std::size_t , float , long )
+        {}
+
+        /*
+         * Calls the initializer of an emitter, with the random engine if it accepts it.
+         */
+        template<typename F , typename DATA , typename ACCEPTS_RANDOM = tml::is_valid_call<F,DATA&,float,float,sdst::emitter_random_engine&>>
+        struct initialize
+        {
+            static void execute( const F& initializer , DATA& data , float x , float y , sdst::emitter_random_engine& random )
+            {
+                initializer( data , x , y , random );
+            }
+        };
+
+        template<typename F , typename DATA>
+        struct initialize<F,DATA,tml::false_type>
+        {
+            static void execute( const F& initializer , DATA& data , float x , float y , sdst::emitter_random_engine& )
+            {
+                initializer( data , x , y );
+            }
+        };
+    }
+
+    /*
+     * Emits all the particles from the same point.
+     */
+    struct point_shape
+    {
+        float x , y;
+
+        template<typename RNG>
+        void sample( RNG& , float& px , float& py ) const
+        {
+            px = x;
+            py = y;
+        }
+    };
+
+    /*
+     * Emits the particles uniformly along the segment from (x0,y0) to (x1,y1).
+     */
+    struct line_shape
+    {
+        float x0 , y0 , x1 , y1;
+
+        template<typename RNG>
+        void sample( RNG& random , float& px , float& py ) const
+        {
+            const float t = sdst::impl::uniform( random , 0.0f , 1.0f );
+
+            px = x0 + ( x1 - x0 ) * t;
+            py = y0 + ( y1 - y0 ) * t;
+        }
+    };
+
+    /*
+     * Emits the particles uniformly over the area of a disc.
+     */
+    struct disc_shape
+    {
+        float x , y , radius;
+
+        template<typename RNG>
+        void sample( RNG& random , float& px , float& py ) const
+        {
+            const float r     = radius * std::sqrt( sdst::impl::uniform( random , 0.0f , 1.0f ) );
+            const float angle = sdst::impl::uniform( random , 0.0f , 6.28318530718f );
+
+            px = x + r * std::cos( angle );
+            py = y + r * std::sin( angle );
+        }
+    };
+
+    /*
+     * Emits the particles uniformly over the area of an axis-aligned box.
+     */
+    struct box_shape
+    {
+        float min_x , min_y , max_x , max_y;
+
+        template<typename RNG>
+        void sample( RNG& random , float& px , float& py ) const
+        {
+            px = sdst::impl::uniform( random , min_x , max_x );
+            py = sdst::impl::uniform( random , min_y , max_y );
+        }
+    };
+
+    template<typename SHAPE , typename INITIALIZER , typename EXECUTION_POLICY = sdst::sequential_execution>
+    struct emitter
+    {
+    public:
+        /*
+         * The shape the particles are emitted from.
+         */
+        using shape_t = SHAPE;
+
+        /*
+         * The function which initializes the data of the new particles.
+         */
+        using initializer_t = INITIALIZER;
+
+        /*
+         * The execution policy used to initialize the new particles.
+         */
+        using execution_policy_t = EXECUTION_POLICY;
+
+
+        emitter( const shape_t& shape , const initializer_t& initializer , const execution_policy_t& execution_policy = execution_policy_t{} ) :
+            _shape( shape ),
+            _initializer( initializer ),
+            _execution_policy{ execution_policy },
+            _rate{ 0.0 },
+            _pending_rate{ 0.0 },
+            _burst{ 0 },
+            _burst_interval{ 0.0 },
+            _burst_clock{ 0.0 },
+            _burst_pending{ false },
+            _min_lifetime{ std::numeric_limits<float>::infinity() },
+            _max_lifetime{ std::numeric_limits<float>::infinity() },
+            _seed{ 0 },
+            _emitted{ 0 }
+        {}
+
+        /*
+         * Emits particles continuously, at 'particles_per_second'. Zero disables the continuous emission.
+         */
+        emitter& rate( double particles_per_second )
+        {
+            _rate = particles_per_second;
+
+            return *this;
+        }
+
+        /*
+         * Emits 'count' particles at once on the next run. If 'interval' is not zero, the burst
+         * is repeated each 'interval' seconds.
+         */
+        emitter& burst( std::size_t count , double interval = 0.0 )
+        {
+            _burst          = count;
+            _burst_interval = interval;
+            _burst_clock    = 0.0;
+            _burst_pending  = true;
+
+            return *this;
+        }
+
+        /*
+         * Sets the lifetime of the new particles, chosen uniformly in [min,max]. Only used by scenes
+         * with lifetimes. By default particles live forever.
+         *
+         * Lifetimes are written directly to the scene, so non-positive ones (Which the scene would never
+         * count as dead, see pool_scene::spawn()) are raised to the smallest positive lifetime: Those
+         * particles die on their first update.
+         */
+        emitter& lifetime( float min , float max )
+        {
+            _min_lifetime = min > 0.0f ? min : std::numeric_limits<float>::min();
+            _max_lifetime = max > 0.0f ? max : std::numeric_limits<float>::min();
+
+            return *this;
+        }
+
+        emitter& lifetime( float lifetime )
+        {
+            return this->lifetime( lifetime , lifetime );
+        }
+
+        /*
+         * Sets the seed of the random sequence of the emitter.
+         */
+        emitter& seed( std::uint64_t seed )
+        {
+            _seed = seed;
+
+            return *this;
+        }
+
+        /*
+         * Gives access to the shape of the emitter, to move it for example.
+         */
+        shape_t& shape()
+        {
+            return _shape;
+        }
+
+        const shape_t& shape() const
+        {
+            return _shape;
+        }
+
+        /*
+         * Returns the number of particles emitted so far.
+         */
+        std::uint64_t emitted() const
+        {
+            return _emitted;
+        }
+
+        /*
+         * Advances the emitter 'elapsed' seconds, spawning into the scene the particles due in that time.
+         * Returns the number of particles spawned, which can be less than the due ones if the scene is full.
+         */
+        template<typename SCENE>
+        std::size_t emit( SCENE& scene , double elapsed )
+        {
+            _pending_rate += _rate * elapsed;
+
+            std::size_t due = static_cast<std::size_t>( _pending_rate );
+            _pending_rate  -= static_cast<double>( due );
+
+            if( _burst_pending )
+            {
+                if( _burst_interval > 0.0 )
+                {
+                    for( _burst_clock -= elapsed ; _burst_clock <= 0.0 ; _burst_clock += _burst_interval )
+                        due += _burst;
+                }
+                else
+                {
+                    due           += _burst;
+                    _burst_pending = false;
+                }
+            }
+
+            return spawn( scene , due );
+        }
+
+        /*
+         * Spawns 'count' particles into the scene right now. Returns the number of particles spawned.
+         */
+        template<typename SCENE>
+        std::size_t spawn( SCENE& scene , std::size_t count )
+        {
+            using data_t = typename SCENE::data_t;
+
+            if( count == 0 )
+                return 0;
+
+            const std::size_t   first  = scene.allocate( count );
+            const std::size_t   last   = scene.size();
+            const std::uint64_t serial = _emitted;
+
+            _execution_policy.for_each_range( first , last , [&]( std::size_t begin , std::size_t end )
+            {
+                for( std::size_t i = begin ; i < end ; ++i )
+                {
+                    sdst::emitter_random_engine random{ static_cast<sdst::emitter_random_engine::result_type>( sdst::impl::mix_seed( _seed ^ ( serial + i - first ) ) ) };
+
+                    float x , y;
+                    _shape.sample( random , x , y );
+
+                    data_t& data = scene.data()[i];
+                    data = data_t{};
+
+                    sdst::impl::initialize<initializer_t,data_t>::execute( _initializer , data , x , y , random );
+                    sdst::impl::set_lifetime( scene , i , _min_lifetime < _max_lifetime ? sdst::impl::uniform( random , _min_lifetime , _max_lifetime ) : _min_lifetime , 0 );
+                }
+            });
+
+            _emitted += last - first;
+
+            return last - first;
+        }
+
+    private:
+        shape_t            _shape;
+        initializer_t      _initializer;
+        execution_policy_t _execution_policy;
+
+        double        _rate;
+        double        _pending_rate;   //Fraction of a particle due but not emitted yet
+        std::size_t   _burst;
+        double        _burst_interval;
+        double        _burst_clock;    //Time until the next burst
+        bool          _burst_pending;
+        float         _min_lifetime;
+        float         _max_lifetime;
+        std::uint64_t _seed;
+        std::uint64_t _emitted;
+    };
+
+    template<typename SHAPE , typename INITIALIZER>
+    sdst::emitter<typename std::decay<SHAPE>::type,typename std::decay<INITIALIZER>::type> make_emitter( SHAPE&& shape , INITIALIZER&& initializer )
+    {
+        return { std::forward<SHAPE>( shape ) , std::forward<INITIALIZER>( initializer ) };
+    }
+
+    template<typename SHAPE , typename INITIALIZER , typename EXECUTION_POLICY>
+    sdst::emitter<typename std::decay<SHAPE>::type,typename std::decay<INITIALIZER>::type,typename std::decay<EXECUTION_POLICY>::type> make_emitter( SHAPE&& shape , INITIALIZER&& initializer , EXECUTION_POLICY&& execution_policy )
+    {
+        return { std::forward<SHAPE>( shape ) , std::forward<INITIALIZER>( initializer ) , std::forward<EXECUTION_POLICY>( execution_policy ) };
+    }
+}
+
+#endif	/* EMITTERS_HPP */
@@ -0,0 +1,161 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef EXECUTION_POLICIES_HPP
+#define	EXECUTION_POLICIES_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+
+#include "thread_pool.hpp"
+
+/*
+ * An execution policy specifies how an engine traverses the scene during a simulation step.
+ *
+ * The engine doesn't iterate the scene directly, it passes a chunk function to the execution
+ * policy, which splits the scene in ranges of particles and calls the chunk function once
+ * per range:
+ *
+ *     policy.for_each_chunk( scene , f ); //Calls f( first , last ) for each chunk.
+ *
+ * Work which isn't a traversal of the scene (Initializing newly spawned particles, for example) is
+ * split the same way over a range of indices:
+ *
+ *     policy.for_each_range( first , last , f );         //Calls f( begin , end ) for each chunk of indices.
+ *     policy.for_each_range( first , last , grain , f ); //Same, with chunks of 'grain' indices (Ignored by sequential policies).
+ *
+ * for_each_chunk() returns when all the chunks have been processed, so everything the engine
+ * does after it sees the whole scene updated.
+ */
+
+namespace sdst
+{
+    /*
+     * Runs the whole scene as a single chunk in the calling thread. Works for any
+     * SCENE which has defined iterator getters (begin() and end()).
+     */
+    struct sequential_execution
+    {
+        template<typename SCENE , typename F>
+        void for_each_chunk( SCENE& scene , F f ) const
+        {
+            f( std::begin( scene ) , std::end( scene ) );
+        }
+
+        /*
+         * Calls f( first , last ) with the range of indices [first,last).
+         */
+        template<typename F>
+        void for_each_range( std::size_t first , std::size_t last , F f ) const
+        {
+            if( first < last )
+                f( first , last );
+        }
+
+        template<typename F>
+        void for_each_range( std::size_t first , std::size_t last , std::size_t , F f ) const
+        {
+            for_each_range( first , last , f );
+        }
+    };
+
+    /*
+     * Splits the scene in chunks processed in parallel by a sdst::thread_pool.
+     * The SCENE should provide random access iterators.
+     *
+     * The policy only references the pool, so the pool should outlive the engine.
+     */
+    struct parallel_execution
+    {
+    public:
+        /*
+         * Initializes the policy given the pool to run on and the number of particles
+         * per chunk. A grain of zero lets the policy choose a chunk size depending on the
+         * size of the scene and the number of threads.
+         */
+        explicit parallel_execution( sdst::thread_pool& pool = sdst::default_thread_pool() , std::size_t grain = 0 ) :
+            _pool{ pool },
+            _grain{ grain }
+        {}
+
+        template<typename SCENE , typename F>
+        void for_each_chunk( SCENE& scene , F f ) const
+        {
+            using iterator_t = decltype( std::begin( scene ) );
+
+            static_assert( std::is_base_of<std::random_access_iterator_tag,typename std::iterator_traits<iterator_t>::iterator_category>::value ,
+                           "sdst::parallel_execution requires a scene with random access iterators" );
+
+            const iterator_t  first = std::begin( scene );
+            const std::size_t size  = static_cast<std::size_t>( std::distance( first , std::end( scene ) ) );
+
+            for_each_range( 0 , size , [&]( std::size_t begin , std::size_t end )
+            {
+                f( first + begin , first + end );
+            });
+        }
+
+        /*
+         * Splits the range of indices [first,last) in chunks, calling f( begin , end ) for each one.
+         */
+        template<typename F>
+        void for_each_range( std::size_t first , std::size_t last , F f ) const
+        {
+            for_each_range( first , last , grain( last - first ) , f );
+        }
+
+        /*
+         * Same as above, with an explicit number of indices per chunk. Useful to split a few
+         * coarse work items (Each one a block of particles, for example), one per chunk.
+         */
+        template<typename F>
+        void for_each_range( std::size_t first , std::size_t last , std::size_t grain , F f ) const
+        {
+            if( first < last )
+                _pool.get().parallel_for( first , last , grain , f );
+        }
+
+        /*
+         * Gives access to the pool used by the policy.
+         */
+        sdst::thread_pool& pool() const
+        {
+            return _pool.get();
+        }
+
+        /*
+         * Returns the chunk size used for a scene of the given size.
+         */
+        std::size_t grain( std::size_t size ) const
+        {
+            //A few chunks per thread give the pool room to balance the load
+            //by stealing, without making the chunks too small to amortize the call:
+            return _grain != 0 ? _grain : std::max<std::size_t>( size / ( 8 * _pool.get().size() ) , 256 );
+        }
+
+    private:
+        std::reference_wrapper<sdst::thread_pool> _pool;
+        std::size_t                               _grain;
+    };
+}
+
+#endif	/* EXECUTION_POLICIES_HPP */
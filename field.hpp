@@ -0,0 +1,110 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef FIELD_HPP
+#define	FIELD_HPP
+
+#include <cstddef>
+#include <type_traits>
+
+namespace sdst
+{
+    /*
+     * A field describes a data member of the particle data at compile-time, so
+     * the library can access that member alone (Storing it in its own column, feeding
+     * it to a kernel, etc) without knowing anything else about DATA.
+     *
+     * Fields are usually declared through the SDST_FIELD() macro:
+     *
+     *     using position = SDST_FIELD( sf::Vertex , position );
+     */
+    template<typename DATA , typename T , T DATA::* MEMBER>
+    struct field
+    {
+        /*
+         * The type of the particle data the field belongs to.
+         */
+        using data_t = DATA;
+
+        /*
+         * The type of the field.
+         */
+        using value_t = T;
+
+        /*
+         * Gives access to the field of a particle data.
+         */
+        static value_t& get( data_t& data )
+        {
+            return data.*MEMBER;
+        }
+
+        /*
+         * Gives readonly access to the field of a particle data.
+         */
+        static const value_t& get( const data_t& data )
+        {
+            return data.*MEMBER;
+        }
+    };
+
+    namespace impl
+    {
+        /*
+         * Computes the index of the type T in the pack TS...
+         */
+        template<typename T , typename... TS>
+        struct index_of;
+
+        template<typename T , typename... TS>
+        struct index_of<T,T,TS...> : public std::integral_constant<std::size_t,0>
+        {};
+
+        template<typename T , typename HEAD , typename... TAIL>
+        struct index_of<T,HEAD,TAIL...> : public std::integral_constant<std::size_t,1 + index_of<T,TAIL...>::value>
+        {};
+
+        /*
+         * C++11 version of C++14 std::index_sequence, to expand tuples.
+         */
+        template<std::size_t... IS>
+        struct index_sequence
+        {};
+
+        template<std::size_t N , std::size_t... IS>
+        struct make_index_sequence_impl : public make_index_sequence_impl<N - 1,N - 1,IS...>
+        {};
+
+        template<std::size_t... IS>
+        struct make_index_sequence_impl<0,IS...>
+        {
+            using type = index_sequence<IS...>;
+        };
+
+        template<std::size_t N>
+        using make_index_sequence = typename make_index_sequence_impl<N>::type;
+    }
+}
+
+/*
+ * Declares the field describing the data member MEMBER of the particle data type DATA.
+ */
+#define SDST_FIELD( DATA , MEMBER ) sdst::field<DATA,decltype(DATA::MEMBER),&DATA::MEMBER>
+
+#endif	/* FIELD_HPP */
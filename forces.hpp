@@ -0,0 +1,728 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef FORCES_HPP
+#define	FORCES_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "batch_policies.hpp"
+#include "field.hpp"
+#include "simd_kernels.hpp"
+#include "soa_scene.hpp"
+
+/*
+ * Ready-made evolution policies for the common kinematics of particle effects: Forces (gravity,
+ * attractors, vortices, drag), integration and boundaries.
+ *
+ * The policies are parametrized with the fields of the particle data which hold the position and the
+ * velocity of the particle (See field.hpp). Both should be 2D vectors of floats (sf::Vector2f, for example):
+ *
+ *     using position = SDST_FIELD( particle_data , position );
+ *     using velocity = SDST_FIELD( particle_data , velocity );
+ *
+ *     auto evolution = sdst::make_kernel_chain( sdst::uniform_gravity<velocity>{ 0.0f , 9.8f , dt } ,
+ *                                               sdst::point_attractor<position,velocity>{ 400.0f , 300.0f , 1e5f , 10.0f , dt } ,
+ *                                               sdst::euler_integration<position,velocity>{ dt } ,
+ *                                               sdst::box_bounce<position,velocity>{ 0.0f , 0.0f , 800.0f , 600.0f , 0.8f } );
+ *
+ * Each policy supports both the per-particle signature, and the batch signatures of SoA scenes and of contiguous particle
+ * data (See batch_policies.hpp). The batch ones run the SIMD kernels of simd_kernels.hpp over the position and velocity
+ * columns, using the widest instruction set supported by the CPU. Contiguous particle data (Homogeneous and pool scenes)
+ * has no columns, so the fields are gathered into columns in small tiles first, and scattered back after the kernel.
+ *
+ * The policies are stateless, so they can be shared by all the particles of a scene and called from multiple threads.
+ */
+
+namespace sdst
+{
+    namespace impl
+    {
+        /*
+         * Gives access to a field of 2D vectors as interleaved floats.
+         */
+        template<typename FIELD>
+        float* floats( typename FIELD::value_t* vectors )
+        {
+            static_assert( sizeof( typename FIELD::value_t ) == 2 * sizeof( float ) && std::is_standard_layout<typename FIELD::value_t>::value ,
+                           "Kinematic policies require fields which are 2D vectors of floats" );
+
+            return reinterpret_cast<float*>( vectors );
+        }
+
+        template<typename FIELD>
+        float* floats( typename FIELD::data_t& data )
+        {
+            return sdst::impl::floats<FIELD>( &FIELD::get( data ) );
+        }
+
+        /*
+         * The SIMD kernels run over contiguous columns of 2D vectors, while the fields of contiguous particle
+         * data (Homogeneous and pool scenes) are strided. Batches of particle data are processed in tiles:
+         * The fields used by the policy are gathered into columns on the stack, the kernels run over the
+         * columns, and the results are scattered back.
+         */
+        enum : std::size_t { tile_size = 256 };
+
+        template<typename... FIELDS>
+        struct field_list
+        {};
+
+        template<typename T , typename... TS>
+        struct contains : public std::false_type
+        {};
+
+        template<typename T , typename... TS>
+        struct contains<T,T,TS...> : public std::true_type
+        {};
+
+        template<typename T , typename HEAD , typename... TAIL>
+        struct contains<T,HEAD,TAIL...> : public contains<T,TAIL...>
+        {};
+
+        /*
+         * Appends the FIELDS... not in the list yet to the list LIST.
+         */
+        template<typename LIST , typename... FIELDS>
+        struct merge_fields
+        {
+            using type = LIST;
+        };
+
+        template<typename... RESULT , typename HEAD , typename... TAIL>
+        struct merge_fields<field_list<RESULT...>,HEAD,TAIL...> :
+            public merge_fields<typename std::conditional<contains<HEAD,RESULT...>::value,field_list<RESULT...>,field_list<RESULT...,HEAD>>::type,TAIL...>
+        {};
+
+        /*
+         * The union of the field lists LISTS..., appended to RESULT.
+         */
+        template<typename RESULT , typename... LISTS>
+        struct merge_lists
+        {
+            using type = RESULT;
+        };
+
+        template<typename RESULT , typename... FIELDS , typename... LISTS>
+        struct merge_lists<RESULT,field_list<FIELDS...>,LISTS...> : public merge_lists<typename merge_fields<RESULT,FIELDS...>::type,LISTS...>
+        {};
+
+        template<typename FIELD>
+        void gather( typename FIELD::data_t* data , std::size_t count , float* column )
+        {
+            for( std::size_t i = 0 ; i < count ; ++i )
+                std::memcpy( column + 2 * i , sdst::impl::floats<FIELD>( data[i] ) , 2 * sizeof( float ) );
+        }
+
+        template<typename FIELD>
+        void scatter( const float* column , std::size_t count , typename FIELD::data_t* data )
+        {
+            for( std::size_t i = 0 ; i < count ; ++i )
+                std::memcpy( sdst::impl::floats<FIELD>( data[i] ) , column + 2 * i , 2 * sizeof( float ) );
+        }
+
+        /*
+         * The columns of a tile of particles, one per field of the list.
+         */
+        template<typename LIST>
+        struct tile;
+
+        template<typename FIELD , typename... FIELDS>
+        struct tile<field_list<FIELD,FIELDS...>>
+        {
+            using data_t = typename FIELD::data_t;
+
+            template<typename F>
+            float* column()
+            {
+                return _columns[sdst::impl::index_of<F,FIELD,FIELDS...>::value];
+            }
+
+            void gather( data_t* data , std::size_t count )
+            {
+                using swallow = int[];
+                (void)swallow{ ( sdst::impl::gather<FIELD>( data , count , column<FIELD>() ) , 0 ) , ( sdst::impl::gather<FIELDS>( data , count , column<FIELDS>() ) , 0 )... };
+            }
+
+            void scatter( data_t* data , std::size_t count )
+            {
+                using swallow = int[];
+                (void)swallow{ ( sdst::impl::scatter<FIELD>( column<FIELD>() , count , data ) , 0 ) , ( sdst::impl::scatter<FIELDS>( column<FIELDS>() , count , data ) , 0 )... };
+            }
+
+        private:
+            float _columns[1 + sizeof...(FIELDS)][2 * tile_size];
+        };
+
+        /*
+         * Runs a tiled policy (A policy with the list of the fields it uses, fields_t, and a function
+         * apply_tile( tile , count ) running its kernels over a tile) over a batch of particle data.
+         */
+        template<typename POLICY>
+        void for_each_tile( const POLICY& policy , typename POLICY::data_t* data , std::size_t count )
+        {
+            sdst::impl::tile<typename POLICY::fields_t> tile;
+
+            for( std::size_t first = 0 ; first < count ; first += tile_size )
+            {
+                const std::size_t size = std::min<std::size_t>( tile_size , count - first );
+
+                tile.gather( data + first , size );
+                policy.apply_tile( tile , size );
+                tile.scatter( data + first , size );
+            }
+        }
+
+        template<typename T>
+        struct always_void
+        {
+            using type = void;
+        };
+
+        /*
+         * Checks whether a policy is tiled.
+         */
+        template<typename POLICY , typename = void>
+        struct is_tiled : public std::false_type
+        {};
+
+        template<typename POLICY>
+        struct is_tiled<POLICY,typename always_void<typename POLICY::fields_t>::type> : public std::true_type
+        {};
+
+        /*
+         * Checks whether all the BS are true.
+         */
+        template<bool... BS>
+        struct bools
+        {};
+
+        template<bool... BS>
+        using all_true = std::is_same<bools<true,BS...>,bools<BS...,true>>;
+    }
+
+    /*
+     * Constant acceleration (ax,ay).
+     */
+    template<typename VELOCITY>
+    struct uniform_gravity
+    {
+    public:
+        using data_t   = typename VELOCITY::data_t;
+        using fields_t = sdst::impl::field_list<VELOCITY>;
+
+        uniform_gravity( float ax , float ay , float dt ) :
+            _ax{ ax },
+            _ay{ ay },
+            _dt{ dt }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::accelerate( sdst::impl::floats<VELOCITY>( data ) , 1 , _ax , _ay , _dt );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::accelerate( sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) , count , _ax , _ay , _dt );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::accelerate( tile.template column<VELOCITY>() , count , _ax , _ay , _dt );
+        }
+
+    private:
+        float _ax , _ay , _dt;
+    };
+
+    /*
+     * Drag proportional to the velocity: dv/dt = -k*v
+     */
+    template<typename VELOCITY>
+    struct linear_drag
+    {
+    public:
+        using data_t   = typename VELOCITY::data_t;
+        using fields_t = sdst::impl::field_list<VELOCITY>;
+
+        linear_drag( float k , float dt ) :
+            _factor{ std::max( 0.0f , 1.0f - k * dt ) }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::scale( sdst::impl::floats<VELOCITY>( data ) , 1 , _factor );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::scale( sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) , count , _factor );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::scale( tile.template column<VELOCITY>() , count , _factor );
+        }
+
+    private:
+        float _factor;
+    };
+
+    /*
+     * Drag proportional to the square of the speed: dv/dt = -k*|v|*v
+     */
+    template<typename VELOCITY>
+    struct quadratic_drag
+    {
+    public:
+        using data_t   = typename VELOCITY::data_t;
+        using fields_t = sdst::impl::field_list<VELOCITY>;
+
+        quadratic_drag( float k , float dt ) :
+            _k{ k },
+            _dt{ dt }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::quadratic_drag( sdst::impl::floats<VELOCITY>( data ) , 1 , _k , _dt );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::quadratic_drag( sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) , count , _k , _dt );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::quadratic_drag( tile.template column<VELOCITY>() , count , _k , _dt );
+        }
+
+    private:
+        float _k , _dt;
+    };
+
+    /*
+     * Scales the velocity by a constant factor each step.
+     */
+    template<typename VELOCITY>
+    struct damping
+    {
+    public:
+        using data_t   = typename VELOCITY::data_t;
+        using fields_t = sdst::impl::field_list<VELOCITY>;
+
+        explicit damping( float factor ) :
+            _factor{ factor }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::scale( sdst::impl::floats<VELOCITY>( data ) , 1 , _factor );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::scale( sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) , count , _factor );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::scale( tile.template column<VELOCITY>() , count , _factor );
+        }
+
+    private:
+        float _factor;
+    };
+
+    /*
+     * Inverse-square attraction towards a point (A black hole, for example). The softening
+     * length avoids infinite accelerations near the center. Negative strengths repel.
+     */
+    template<typename POSITION , typename VELOCITY>
+    struct point_attractor
+    {
+    public:
+        using data_t   = typename POSITION::data_t;
+        using fields_t = sdst::impl::field_list<POSITION,VELOCITY>;
+
+        point_attractor( float x , float y , float strength , float softening , float dt ) :
+            _x{ x },
+            _y{ y },
+            _strength{ strength },
+            _softening{ softening },
+            _dt{ dt }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::attract( sdst::impl::floats<POSITION>( data ) , sdst::impl::floats<VELOCITY>( data ) , 1 , _x , _y , _strength , _softening , _dt );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::attract( sdst::impl::floats<POSITION>( first.template column<POSITION>() ) ,
+                                    sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) ,
+                                    count , _x , _y , _strength , _softening , _dt );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::attract( tile.template column<POSITION>() , tile.template column<VELOCITY>() , count , _x , _y , _strength , _softening , _dt );
+        }
+
+    private:
+        float _x , _y , _strength , _softening , _dt;
+    };
+
+    /*
+     * Swirls the particles around a point, counter-clockwise for positive strengths.
+     */
+    template<typename POSITION , typename VELOCITY>
+    struct vortex
+    {
+    public:
+        using data_t   = typename POSITION::data_t;
+        using fields_t = sdst::impl::field_list<POSITION,VELOCITY>;
+
+        vortex( float x , float y , float strength , float softening , float dt ) :
+            _x{ x },
+            _y{ y },
+            _strength{ strength },
+            _softening{ softening },
+            _dt{ dt }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::vortex( sdst::impl::floats<POSITION>( data ) , sdst::impl::floats<VELOCITY>( data ) , 1 , _x , _y , _strength , _softening , _dt );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::vortex( sdst::impl::floats<POSITION>( first.template column<POSITION>() ) ,
+                                   sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) ,
+                                   count , _x , _y , _strength , _softening , _dt );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::vortex( tile.template column<POSITION>() , tile.template column<VELOCITY>() , count , _x , _y , _strength , _softening , _dt );
+        }
+
+    private:
+        float _x , _y , _strength , _softening , _dt;
+    };
+
+    /*
+     * Moves the particles with their velocity (Explicit Euler). Usually the last kinematic step
+     * before the boundaries.
+     */
+    template<typename POSITION , typename VELOCITY>
+    struct euler_integration
+    {
+    public:
+        using data_t   = typename POSITION::data_t;
+        using fields_t = sdst::impl::field_list<POSITION,VELOCITY>;
+
+        explicit euler_integration( float dt ) :
+            _dt{ dt }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::integrate( sdst::impl::floats<POSITION>( data ) , sdst::impl::floats<VELOCITY>( data ) , 1 , _dt );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::integrate( sdst::impl::floats<POSITION>( first.template column<POSITION>() ) ,
+                                      sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) ,
+                                      count , _dt );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::integrate( tile.template column<POSITION>() , tile.template column<VELOCITY>() , count , _dt );
+        }
+
+    private:
+        float _dt;
+    };
+
+    /*
+     * Keeps the particles inside a box, reflecting them on the walls. The restitution
+     * scales the reflected velocity (1 for perfectly elastic bounces).
+     */
+    template<typename POSITION , typename VELOCITY>
+    struct box_bounce
+    {
+    public:
+        using data_t   = typename POSITION::data_t;
+        using fields_t = sdst::impl::field_list<POSITION,VELOCITY>;
+
+        box_bounce( float min_x , float min_y , float max_x , float max_y , float restitution = 1.0f ) :
+            _min_x{ min_x },
+            _min_y{ min_y },
+            _max_x{ max_x },
+            _max_y{ max_y },
+            _restitution{ restitution }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::bounce( sdst::impl::floats<POSITION>( data ) , sdst::impl::floats<VELOCITY>( data ) , 1 ,
+                                           _min_x , _min_y , _max_x , _max_y , _restitution );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::bounce( sdst::impl::floats<POSITION>( first.template column<POSITION>() ) ,
+                                   sdst::impl::floats<VELOCITY>( first.template column<VELOCITY>() ) ,
+                                   count , _min_x , _min_y , _max_x , _max_y , _restitution );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::bounce( tile.template column<POSITION>() , tile.template column<VELOCITY>() , count , _min_x , _min_y , _max_x , _max_y , _restitution );
+        }
+
+    private:
+        float _min_x , _min_y , _max_x , _max_y , _restitution;
+    };
+
+    /*
+     * Periodic boundaries: Particles leaving the box enter it again from the opposite side.
+     */
+    template<typename POSITION>
+    struct box_wrap
+    {
+    public:
+        using data_t   = typename POSITION::data_t;
+        using fields_t = sdst::impl::field_list<POSITION>;
+
+        box_wrap( float min_x , float min_y , float max_x , float max_y ) :
+            _min_x{ min_x },
+            _min_y{ min_y },
+            _max_x{ max_x },
+            _max_y{ max_y }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            sdst::kernels::scalar::wrap( sdst::impl::floats<POSITION>( data ) , 1 , _min_x , _min_y , _max_x , _max_y );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            sdst::kernels::wrap( sdst::impl::floats<POSITION>( first.template column<POSITION>() ) , count , _min_x , _min_y , _max_x , _max_y );
+        }
+
+        void operator()( data_t* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            sdst::kernels::wrap( tile.template column<POSITION>() , count , _min_x , _min_y , _max_x , _max_y );
+        }
+
+    private:
+        float _min_x , _min_y , _max_x , _max_y;
+    };
+
+    namespace impl
+    {
+        /*
+         * The fields used by a chain of tiled policies, the union of the fields of all the policies.
+         * Chains of policies which aren't all tiled aren't tiled either.
+         */
+        template<bool TILED , typename... KERNELS>
+        struct chain_fields
+        {};
+
+        template<typename... KERNELS>
+        struct chain_fields<true,KERNELS...>
+        {
+            using fields_t = typename sdst::impl::merge_lists<sdst::impl::field_list<>,typename KERNELS::fields_t...>::type;
+        };
+    }
+
+    /*
+     * Combines kinematic policies into one evolution policy which applies them in order.
+     *
+     * With the batch signatures the passes of the policies are interleaved in small blocks, so each block
+     * stays in cache between passes regardless of how the execution policy splits the scene:
+     *
+     *  - SoA scenes: Each policy runs over a block of block_size particles before the next one starts.
+     *  - Contiguous particle data: The fields used by the chain are gathered into a tile once, all the
+     *    policies run over the tile, and then the fields are scattered back. This requires all the policies
+     *    to be tiled (As the kinematic policies of this file); else each policy runs over a block of
+     *    block_size particles as with SoA scenes (If all of them support the batch signature).
+     */
+    template<typename KERNEL , typename... KERNELS>
+    struct kernel_chain : public sdst::impl::chain_fields<sdst::impl::all_true<sdst::impl::is_tiled<KERNEL>::value ,
+                                                                               sdst::impl::is_tiled<KERNELS>::value...>::value,KERNEL,KERNELS...>
+    {
+    public:
+        using data_t = typename KERNEL::data_t;
+
+        enum : std::size_t { block_size = 1024 };
+
+        kernel_chain( const KERNEL& kernel , const KERNELS&... kernels ) :
+            _kernels{ kernel , kernels... }
+        {}
+
+        void operator()( data_t& data ) const
+        {
+            apply( data , sdst::impl::make_index_sequence<1 + sizeof...(KERNELS)>{} );
+        }
+
+        template<typename SCENE>
+        void operator()( const sdst::soa_particle<SCENE>& first , std::size_t count ) const
+        {
+            for( std::size_t block = 0 ; block < count ; block += block_size )
+            {
+                apply( sdst::soa_particle<SCENE>{ first.scene() , first.index() + block } , std::min<std::size_t>( block_size , count - block ) ,
+                       sdst::impl::make_index_sequence<1 + sizeof...(KERNELS)>{} );
+            }
+        }
+
+        template<typename DATA , typename std::enable_if<std::is_same<DATA,data_t>::value && sdst::impl::is_tiled<kernel_chain>::value , int>::type = 0>
+        void operator()( DATA* first , std::size_t count ) const
+        {
+            sdst::impl::for_each_tile( *this , first , count );
+        }
+
+        template<typename DATA , typename std::enable_if<std::is_same<DATA,data_t>::value && !sdst::impl::is_tiled<kernel_chain>::value &&
+                                                         sdst::impl::all_true<sdst::is_batch_policy<KERNEL,DATA*>::value ,
+                                                                              sdst::is_batch_policy<KERNELS,DATA*>::value...>::value , int>::type = 0>
+        void operator()( DATA* first , std::size_t count ) const
+        {
+            for( std::size_t block = 0 ; block < count ; block += block_size )
+                apply( first + block , std::min<std::size_t>( block_size , count - block ) , sdst::impl::make_index_sequence<1 + sizeof...(KERNELS)>{} );
+        }
+
+        template<typename TILE>
+        void apply_tile( TILE& tile , std::size_t count ) const
+        {
+            apply_tile( tile , count , sdst::impl::make_index_sequence<1 + sizeof...(KERNELS)>{} );
+        }
+
+    private:
+        template<std::size_t... IS>
+        void apply( data_t& data , sdst::impl::index_sequence<IS...> ) const
+        {
+            using swallow = int[];
+            (void)swallow{ 0 , ( std::get<IS>( _kernels )( data ) , 0 )... };
+        }
+
+        template<typename FIRST , std::size_t... IS>
+        void apply( const FIRST& first , std::size_t count , sdst::impl::index_sequence<IS...> ) const
+        {
+            using swallow = int[];
+            (void)swallow{ 0 , ( std::get<IS>( _kernels )( first , count ) , 0 )... };
+        }
+
+        template<typename TILE , std::size_t... IS>
+        void apply_tile( TILE& tile , std::size_t count , sdst::impl::index_sequence<IS...> ) const
+        {
+            using swallow = int[];
+            (void)swallow{ 0 , ( std::get<IS>( _kernels ).apply_tile( tile , count ) , 0 )... };
+        }
+
+        std::tuple<KERNEL,KERNELS...> _kernels;
+    };
+
+    /*
+     * Type-deduction-based builder for kernel chains.
+     */
+    template<typename... KERNELS>
+    sdst::kernel_chain<typename std::decay<KERNELS>::type...> make_kernel_chain( KERNELS&&... kernels )
+    {
+        return { std::forward<KERNELS>( kernels )... };
+    }
+}
+
+#endif	/* FORCES_HPP */
@@ -0,0 +1,393 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef HOMOGENEOUS_SCENE_HPP
+#define	HOMOGENEOUS_SCENE_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "batch_policies.hpp"
+#include "proxy_iterator.hpp"
+#include "spatial_grid.hpp"
+#include "stated_policies.hpp"
+
+/*
+ * A sdst::particle carries its own copy of its evolution and drawing policies. Thats the most
+ * flexible approach, but when all the particles of a scene share the same policies (The common case)
+ * each particle drags a copy of the policies state through the cache on each update.
+ *
+ * A homogeneous scene is a flyweight: The particles only hold their data, stored contiguously, and the
+ * policies live once in the scene. The scene is traversed through sdst::homogeneous_particle proxies
+ * which have the same interface as sdst::particle (update(), draw(), data()), so engines and
+ * run_while_all()-like predicates written against begin()/end() keep working.
+ *
+ * Since the policies are shared, a local update request is sent to the same policy instance once per
+ * particle, and if the scene is updated in parallel the policies are called concurrently.
+ *
+ * The data is contiguous, so if the evolution policy supports the batch signature void(DATA*,std::size_t)
+ * (See batch_policies.hpp) the engine hands it whole blocks of particles through update(first,count).
+ */
+
+namespace sdst
+{
+    template<typename SCENE>
+    struct homogeneous_particle;
+
+    template<typename DATA , typename EVOLUTION_POLICY , typename DRAW_POLICY>
+    struct homogeneous_scene
+    {
+    public:
+        /*
+         * The type which holds the data of a particle
+         */
+        using data_t = DATA;
+
+        /*
+         * The type of the particle evolution policy
+         */
+        using evolution_policy_t = typename std::decay<EVOLUTION_POLICY>::type;
+
+        /*
+         * The type of the particle drawing policy
+         */
+        using drawing_policy_t = typename std::decay<DRAW_POLICY>::type;
+
+        /*
+         * The type of the scene
+         */
+        using scene_t = homogeneous_scene;
+
+        /*
+         * The type of the proxies representing the particles of the scene.
+         */
+        using particle_t       = sdst::homogeneous_particle<homogeneous_scene>;
+        using const_particle_t = sdst::homogeneous_particle<const homogeneous_scene>;
+
+        using iterator       = sdst::proxy_iterator<particle_t,homogeneous_scene>;
+        using const_iterator = sdst::proxy_iterator<const_particle_t,const homogeneous_scene>;
+
+
+        /*
+         * Initializes an empty scene given the evolution and drawing policies of its particles.
+         */
+        homogeneous_scene( const evolution_policy_t& evolution_policy = evolution_policy_t{} , const drawing_policy_t& drawing_policy = drawing_policy_t{} ) :
+            _evolution_policy{ evolution_policy },
+            _draw_policy{ drawing_policy },
+            _spatial_index{ nullptr }
+        {}
+
+        /*
+         * Initializes the scene given the data of the particles and their policies.
+         */
+        homogeneous_scene( std::vector<data_t> data , const evolution_policy_t& evolution_policy , const drawing_policy_t& drawing_policy ) :
+            _data( std::move( data ) ),
+            _evolution_policy{ evolution_policy },
+            _draw_policy{ drawing_policy },
+            _spatial_index{ nullptr }
+        {}
+
+        void push_back( const data_t& data )
+        {
+            _data.push_back( data );
+        }
+
+        template<typename... ARGS>
+        void emplace_back( ARGS&&... args )
+        {
+            _data.emplace_back( std::forward<ARGS>( args )... );
+        }
+
+        /*
+         * Adds 'count' default-constructed particles and returns the index of the first one, so
+         * they can be initialized in place (By an emitter, for example). Doesn't allocate as long as
+         * the scene has enough capacity reserved.
+         */
+        std::size_t allocate( std::size_t count )
+        {
+            const std::size_t first = _data.size();
+
+            _data.resize( first + count );
+
+            return first;
+        }
+
+        void reserve( std::size_t capacity )
+        {
+            _data.reserve( capacity );
+        }
+
+        void resize( std::size_t size )
+        {
+            _data.resize( size );
+        }
+
+        void clear()
+        {
+            _data.clear();
+        }
+
+        std::size_t size() const
+        {
+            return _data.size();
+        }
+
+        bool empty() const
+        {
+            return _data.empty();
+        }
+
+
+        iterator begin()
+        {
+            return { this , 0 };
+        }
+
+        iterator end()
+        {
+            return { this , size() };
+        }
+
+        const_iterator begin() const
+        {
+            return { this , 0 };
+        }
+
+        const_iterator end() const
+        {
+            return { this , size() };
+        }
+
+        particle_t operator[]( std::size_t index )
+        {
+            return { this , index };
+        }
+
+        const_particle_t operator[]( std::size_t index ) const
+        {
+            return { this , index };
+        }
+
+
+        /*
+         * Updates the particles in the range [first,first + count). If the evolution policy supports
+         * the batch signature the whole block is evolved in one call, else each particle is evolved
+         * as with evolve() of its proxy. Then the local update requests of the block are sent to the
+         * policies at once (See sdst::local_updates).
+         */
+        void update( std::size_t first , std::size_t count )
+        {
+            evolve( first , count );
+            request_local_updates( count );
+        }
+
+        /*
+         * Evolves the particles in the range [first,first + count), without sending their local
+         * update requests. For engines which send them later (See sdst::pipelined_engine).
+         */
+        void evolve( std::size_t first , std::size_t count )
+        {
+            evolve_block<evolution_policy_t>::execute( *this , first , count );
+        }
+
+        /*
+         * Sends the local update requests of 'count' particles to the policies at once.
+         */
+        void request_local_updates( std::size_t count )
+        {
+            _evolution_policy( sdst::local_updates{ count } );
+            _draw_policy( sdst::local_updates{ count } );
+        }
+
+
+        /*
+         * Gives access to the contiguous array where the data of the particles is stored.
+         */
+        data_t* data()
+        {
+            return _data.data();
+        }
+
+        const data_t* data() const
+        {
+            return _data.data();
+        }
+
+
+        /*
+         * Gives access to the evolution policy shared by all the particles.
+         */
+        sdst::erase_state<evolution_policy_t>& evolution_policy()
+        {
+            return _evolution_policy;
+        }
+
+        const sdst::erase_state<evolution_policy_t>& evolution_policy() const
+        {
+            return _evolution_policy;
+        }
+
+        /*
+         * Gives access to the drawing policy shared by all the particles.
+         */
+        sdst::erase_state<drawing_policy_t>& drawing_policy()
+        {
+            return _draw_policy;
+        }
+
+        const sdst::erase_state<drawing_policy_t>& drawing_policy() const
+        {
+            return _draw_policy;
+        }
+
+        /*
+         * Attaches a spatial index to the scene (nullptr detaches it). Evolution policies with the
+         * extended signature void(DATA&,const sdst::neighbors<DATA>&) are passed the neighbors of each
+         * particle found in the index (See spatial_grid.hpp). The index should outlive the scene.
+         */
+        void spatial_index( const sdst::spatial_index<data_t>* index )
+        {
+            _spatial_index = index;
+        }
+
+        const sdst::spatial_index<data_t>* spatial_index() const
+        {
+            return _spatial_index;
+        }
+
+    private:
+        /*
+         * Block evolution. This specialization is rejected if the evolution
+         * policy doesn't support the batch signature.
+         */
+        template<typename P , typename IS_BATCH = sdst::is_batch_policy<P,data_t*>>
+        struct evolve_block
+        {
+            static void execute( homogeneous_scene& scene , std::size_t first , std::size_t count )
+            {
+                scene._evolution_policy( scene.data() + first , count );
+            }
+        };
+
+        /*
+         * Block evolution. This specialization is rejected if the evolution
+         * policy supports the batch signature.
+         */
+        template<typename P>
+        struct evolve_block<P,tml::false_type>
+        {
+            static void execute( homogeneous_scene& scene , std::size_t first , std::size_t count )
+            {
+                for( std::size_t i = first ; i < first + count ; ++i )
+                    scene[i].evolve();
+            }
+        };
+
+        std::vector<data_t>                   _data;
+        sdst::erase_state<evolution_policy_t> _evolution_policy;
+        sdst::erase_state<drawing_policy_t>   _draw_policy;
+        const sdst::spatial_index<data_t>*    _spatial_index;
+    };
+
+    /*
+     * A reference to a particle of a homogeneous scene. SCENE is const-qualified for readonly proxies.
+     */
+    template<typename SCENE>
+    struct homogeneous_particle
+    {
+    public:
+        using scene_t = typename std::remove_const<SCENE>::type;
+        using data_t  = typename scene_t::data_t;
+
+        homogeneous_particle( SCENE* scene = nullptr , std::size_t index = 0 ) :
+            _scene{ scene },
+            _index{ index }
+        {}
+
+        /*
+         * Updates the particle: Calls the evolution policy (With the neighbors of the particle, if
+         * the policy takes them) and then sends a local update request to the policies.
+         */
+        void update() const
+        {
+            evolve();
+
+            _scene->evolution_policy()( sdst::state_change::local );
+            _scene->drawing_policy()( sdst::state_change::local );
+        }
+
+        /*
+         * Calls the evolution policy only, without the local update requests (The scene
+         * sends them for whole blocks, see homogeneous_scene::update()).
+         */
+        void evolve() const
+        {
+            sdst::impl::evolve_data<typename scene_t::evolution_policy_t,data_t>::execute( _scene->evolution_policy() , data() , _scene->spatial_index() , _index );
+        }
+
+        /*
+         * Draws the particle
+         */
+        void draw() const
+        {
+            _scene->drawing_policy()( data() );
+        }
+
+        /*
+         * Gives access to the particle data (Readonly if the scene is const).
+         */
+        auto data() const -> decltype( *std::declval<SCENE&>().data() )
+        {
+            return _scene->data()[_index];
+        }
+
+        operator const data_t&() const
+        {
+            return data();
+        }
+
+        /*
+         * Returns the index of the particle in the scene.
+         */
+        std::size_t index() const
+        {
+            return _index;
+        }
+
+    private:
+        SCENE*      _scene;
+        std::size_t _index;
+    };
+
+    /*
+     * Type-deduction-based builder for homogeneous scenes:
+     *
+     *     auto scene = sdst::make_homogeneous_scene( std::vector<sf::Vertex>( 1000000 ) , evolution{} , draw{} );
+     */
+    template<typename DATA , typename EVOLUTION_POLICY , typename DRAW_POLICY>
+    sdst::homogeneous_scene<DATA,typename std::decay<EVOLUTION_POLICY>::type,typename std::decay<DRAW_POLICY>::type>
+    make_homogeneous_scene( std::vector<DATA> data , EVOLUTION_POLICY&& evolution_policy , DRAW_POLICY&& draw_policy )
+    {
+        return { std::move( data ) , std::forward<EVOLUTION_POLICY>( evolution_policy ) , std::forward<DRAW_POLICY>( draw_policy ) };
+    }
+}
+
+#endif	/* HOMOGENEOUS_SCENE_HPP */
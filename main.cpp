@@ -19,133 +19,84 @@
 
 #include <iostream>
 #include <vector>
-#include <deque>
 #include <algorithm>
 #include <functional>
 
 #include "basic_engines.hpp"
 #include "particle.hpp"
+#include "random.hpp"
+#include "trails.hpp"
 
 #include "Turbo/overloaded_function.hpp"
 
 
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
-#include <random>
 
 
 #ifndef SCENE_SIZE
 #define SCENE_SIZE 10000
 #endif
 
+#ifndef TAIL_LENGTH
+#define TAIL_LENGTH 16
+#endif
+
 
 using particle_data = sf::Vertex;
 
 struct evolution
 {
 public:
-    
-private:
-    void restart( particle_data& data )
-    {
-        data.position.x = _x_dist( _prng() );
-        data.position.y = _y_dist( _prng() );
-        
-        data.color.a = 255;
-        data.color.r = _rgb_dist( _prng() );
-        data.color.g = _rgb_dist( _prng() );
-        data.color.b = _rgb_dist( _prng() );
-    }
-    
-    std::mt19937                                 _prng;
-    std::uniform_real_distribution<float>        _x_dist;
-    std::uniform_real_distribution<float>        _y_dist;
-    std::uniform_int_distribution<std::uint8_t>  _rgb_dist;
-    sf::Vector2f                                 _blackhole;
-    float                                        _vertical_gravity;
-};
-
-/* F...ng Standard Library... */
-template<typename T>
-struct fixed_size_queue
-{
-public:
-    fixed_size_queue( std::size_t size ) :
-        _remaining{ size }
+    //The generator lives in the engine arena, which advances its frame: Every copy of the
+    //policy (One per particle) shares it through the handle.
+    explicit evolution( sdst::arena_policy<sdst::counter_rng> random ) :
+        _random{ random }
     {}
     
-    template<typename... ARGS>
-    void push( ARGS&&... args )
-    {
-        if( _remaining > 0 )
-        {
-            _queue.emplace_back( std::forward<ARGS>( args )... );
-            _remaining--;
-        }
-    }
-    
-    void pop()
-    {
-        if( _queue.size() > 0 )
-        {
-            _queue.pop_front();
-            _remaining++;
-        }
-    }
-    
-    auto begin() const -> decltype( _queue.begin() )
-    {
-        return _queue.begin();
-    }
-    
-    auto end() const -> decltype( _queue.end() )
-    {
-        return _queue.end();
-    }
-    
-    std::size_t size() const
-    {
-        return _queue.size();
-    }
-    
 private:
-    std::deque<T> _queue;
-    std::size_t   _remaining;
-};
-
-struct particle_drawing
-{
-public:
-    particle_drawing( std::size_t tail_length , sf::RenderTarget& canvas ) :
-        _tail{ tail_length },
-        _canvas{ canvas }
-    {}
-    
-    void operator()( particle_data& data )
+    void restart( particle_data& data , std::uint32_t index )
     {
-        _tail.push( data );
-        std::vector<particle_data> buffer{ _tail.size() };
+        float random[4];
+        
+        _random.get().uniform( index , 0 , random );
         
-        std::copy( std::begin( _tail ) , std::end( _tail ) , std::begin( buffer ) );
+        data.position.x = _min.x + random[0] * ( _max.x - _min.x );
+        data.position.y = _min.y + random[1] * ( _max.y - _min.y );
         
-        _canvas.get().draw( buffer.data() , _tail.size() , sf::Points );
+        data.color.a = 255;
+        data.color.r = static_cast<std::uint8_t>( random[2] * 256.0f );
+        data.color.g = static_cast<std::uint8_t>( random[3] * 256.0f );
+        data.color.b = static_cast<std::uint8_t>( _random.get().uniform( index , 1 ) * 256.0f );
     }
     
-private:
-    std::reference_wrapper<sf::RenderTarget> _canvas;
-    fixed_size_queue<sf::Vertex> _tail;
+    sdst::arena_policy<sdst::counter_rng> _random; //Keyed by particle index and frame, shareable between threads
+    sf::Vector2f                          _min , _max;
+    sf::Vector2f                          _blackhole;
+    float                                 _vertical_gravity;
 };
 
 int main()
 {
     sf::RenderWindow window;
-    auto engine = sdst::make_basic_automatic_engine( generate_scene() , [&]( const std::vector<particle_data>& scene )
+    
+    //All the trails live in one slab and are drawn with a single call:
+    auto trails = sdst::make_trail_drawing<particle_data>( TAIL_LENGTH , [&]( const sf::Vertex* vertices , std::size_t count )
     {
-        for( auto& particle : particles )
-            particle.draw( window );
+        window.draw( vertices , count , sf::Points );
+    });
+    
+    auto engine = sdst::make_basic_automatic_engine( std::vector<particle_data>{} , [&]( const std::vector<particle_data>& scene )
+    {
+        trails( scene );
         
         window.display();
     });
     
+    //Only policies known by the engine get the global updates, so the generator goes to its arena:
+    const auto random = engine.policies().emplace<sdst::counter_rng>();
+    
+    engine.scene() = generate_scene( random );
+    
     
 }
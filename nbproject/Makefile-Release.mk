@@ -52,7 +52,7 @@ FFLAGS=
 ASFLAGS=
 
 # Link Libraries and Options
-LDLIBSOPTIONS=-lsfml-audio -lsfml-graphics -lsfml-network -lsfml-system -lsfml-window
+LDLIBSOPTIONS=-pthread -lsfml-audio -lsfml-graphics -lsfml-network -lsfml-system -lsfml-window
 
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
@@ -97,6 +97,41 @@ namespace sdst
             _draw_policy( sdst::state_change::local );
         }
         
+        /*
+         * Calls the evolution policy only, without the local update requests. For engines which
+         * send them later (See sdst::pipelined_engine).
+         */
+        void evolve()
+        {
+            _evolution_policy( _data );
+        }
+        
+        /*
+         * Sends the local update requests of the particle to its policies.
+         */
+        void request_local_update()
+        {
+            _evolution_policy( sdst::state_change::local );
+            _draw_policy( sdst::state_change::local );
+        }
+        
+        /*
+         * Calls the evolution policy only (Const overload)
+         */
+        void evolve() const
+        {
+            _evolution_policy( _data );
+        }
+        
+        /*
+         * Sends the local update requests of the particle to its policies (Const overload)
+         */
+        void request_local_update() const
+        {
+            _evolution_policy( sdst::state_change::local );
+            _draw_policy( sdst::state_change::local );
+        }
+        
         /*
          * Gives readonly access to the particle data
          */
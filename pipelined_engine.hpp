@@ -0,0 +1,403 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef PIPELINED_ENGINE_HPP
+#define	PIPELINED_ENGINE_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "basic_engines.hpp"
+
+namespace sdst
+{
+    namespace impl
+    {
+        /*
+         * A thread which runs the same task each time it is requested, while the requesting
+         * thread does something else. The thread is stopped and joined on destruction.
+         */
+        struct async_worker
+        {
+        public:
+            template<typename F>
+            explicit async_worker( F task ) :
+                _requested{ false },
+                _done{ true },
+                _stop{ false },
+                _thread{ [this,task]() mutable { loop( task ); } }
+            {}
+
+            async_worker( const async_worker& ) = delete;
+            async_worker& operator=( const async_worker& ) = delete;
+
+            ~async_worker()
+            {
+                {
+                    std::lock_guard<std::mutex> lock{ _mutex };
+                    _stop = true;
+                }
+
+                _wake.notify_all();
+                _thread.join();
+            }
+
+            /*
+             * Requests a run of the task. Returns immediately.
+             */
+            void run()
+            {
+                {
+                    std::lock_guard<std::mutex> lock{ _mutex };
+                    _requested = true;
+                    _done      = false;
+                }
+
+                _wake.notify_all();
+            }
+
+            /*
+             * Waits until the requested run finishes. Rethrows the exception thrown by the task, if any.
+             */
+            void wait()
+            {
+                std::unique_lock<std::mutex> lock{ _mutex };
+                _finished.wait( lock , [this](){ return _done; } );
+
+                if( _error )
+                {
+                    std::exception_ptr error = _error;
+                    _error = nullptr;
+                    std::rethrow_exception( error );
+                }
+            }
+
+        private:
+            template<typename F>
+            void loop( F& task )
+            {
+                for(;;)
+                {
+                    {
+                        std::unique_lock<std::mutex> lock{ _mutex };
+                        _wake.wait( lock , [this](){ return _requested || _stop; } );
+
+                        if( _stop )
+                            return;
+
+                        _requested = false;
+                    }
+
+                    std::exception_ptr error;
+
+                    try
+                    {
+                        task();
+                    }
+                    catch( ... )
+                    {
+                        error = std::current_exception();
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock{ _mutex };
+                        _error = error;
+                        _done  = true;
+                    }
+
+                    _finished.notify_all();
+                }
+            }
+
+            std::mutex              _mutex;
+            std::condition_variable _wake;
+            std::condition_variable _finished;
+            bool                    _requested;
+            bool                    _done;
+            bool                    _stop;
+            std::exception_ptr      _error;
+            std::thread             _thread; //Last, so its launched with the rest already initialized.
+        };
+    }
+
+    /*
+     * A pipelined engine overlaps the update of the next frame with the drawing of the current one.
+     * Its a double-buffered version of sdst::basic_automatic_engine: While the calling thread draws
+     * frame N from the front buffer, a worker thread updates a copy of it (The back buffer) to frame N+1.
+     * Then the buffers are swapped. That turns the frame time from update + draw into max(update,draw),
+     * plus the copy of the scene into the back buffer.
+     *
+     * The update itself runs through the execution policy, so the worker can split it across a
+     * thread pool too. Drawing always happens in the thread which calls start(), since most graphics
+     * APIs require it.
+     *
+     * The simulation stages run in this order, and see the buffers as follows:
+     *
+     *  - The front buffer is copied into the back buffer.
+     *  - before_update(): Runs in the worker thread, concurrently with before_draw() and the drawing.
+     *    Can modify the back buffer (update_scene()), which holds frame N and is about to be updated.
+     *    Shouldn't touch the front buffer (scene()) at all.
+     *  - before_draw() and draw: Run in the calling thread, concurrently with the update. scene() is the
+     *    front buffer, frame N. Its a stable snapshot but should be regarded as readonly: Its contents are
+     *    discarded when the buffers are swapped.
+     *  - The calling thread waits for the update (A barrier), swaps the buffers, and sends the state update
+     *    requests: The local update requests of the particles updated, and then the global ones.
+     *  - before_next() and the running condition: Run in the calling thread with no update in flight. scene()
+     *    is frame N+1, and this is the place to modify the simulation (Add particles, for example), since the
+     *    changes are copied into the next update.
+     *
+     * Both buffers are copies of the same scene, so policies shared through handles (sdst::shared_policy,
+     * sdst::arena_policy) are shared by both buffers too. To keep them free of data races:
+     *
+     *  - The worker only evolves the particles (Calls the evolution policies with the particle data). The
+     *    local update requests are held until the barrier, when nothing else runs.
+     *  - Drawing only calls the drawing policies with the particle data.
+     *  - So the state of stated policies only changes between frames. During a frame, the evolution and drawing
+     *    functions of a policy shared by both run concurrently (For different buffers), and should only read it.
+     *  - before_update() runs concurrently with the drawing, so it shouldn't touch shared policies either.
+     *
+     * Particles without evolve() can't hold their requests; those are updated as a whole by the worker, so
+     * they shouldn't have stated shared policies. sdst::particle and the particles of the scenes of this
+     * library have it.
+     */
+    template<typename SCENE , typename DRAW_POLICY , typename EXECUTION_POLICY = sdst::sequential_execution>
+    struct pipelined_engine
+    {
+        /*
+         * The type of the scene.
+         */
+        using scene_t = SCENE;
+
+        /*
+         * The type of the scene draw policy used.
+         */
+        using draw_policy_t = DRAW_POLICY;
+
+        /*
+         * The type of the execution policy used to update the back buffer.
+         */
+        using execution_policy_t = EXECUTION_POLICY;
+
+        /*
+         * The type of the engine
+         */
+        using engine_t = pipelined_engine;
+
+        /*
+         * The running condition, a boolean predicate evaluated after each frame.
+         */
+        using running_condition_t = std::function<bool(const engine_t&)>;
+
+        /*
+         * The type of the actions performed at the different simulation stages.
+         */
+        using mutable_action_t = std::function<void(engine_t&)>;
+
+        /*
+         * Result of the simulation. Currently void.
+         */
+        using simulation_result_t = void;
+
+
+        /*
+         * Initializes the engine passign the values to initialize the scene and the drawing policy
+         */
+        pipelined_engine( const scene_t& scene , const draw_policy_t& draw_policy , const execution_policy_t& execution_policy = execution_policy_t{} ) :
+            _scenes{ scene , scene },
+            _front{ 0 },
+            _drawing_policy{ draw_policy },
+            _execution_policy{ execution_policy },
+            _run_condition{ []( const engine_t& ){ return true; } },
+            _before_update{ []( engine_t& ){} },
+            _before_draw{ []( engine_t& ){} },
+            _before_next{ []( engine_t& ){} }
+        {}
+
+        /*
+         * Specifies the action to be performed (In the worker thread) before the engine updates
+         * the back buffer.
+         */
+        engine_t& before_update( const mutable_action_t& action )
+        {
+            _before_update = action;
+
+            return *this;
+        }
+
+        /*
+         * Specifies the action to be performed before the engine draws the front buffer.
+         */
+        engine_t& before_draw( const mutable_action_t& action )
+        {
+            _before_draw = action;
+
+            return *this;
+        }
+
+        /*
+         * Specifies the action to be performed between frames, after the buffers are swapped.
+         */
+        engine_t& before_next( const mutable_action_t& action )
+        {
+            _before_next = action;
+
+            return *this;
+        }
+
+        engine_t& run_condition( const running_condition_t& condition )
+        {
+            _run_condition = condition;
+
+            return *this;
+        }
+
+        /*
+         * Starts the simulation.
+         */
+        simulation_result_t start()
+        {
+            std::size_t updated = 0; //Particles evolved by the last update, written by the worker
+
+            //The worker only evolves the particles: The policies are shared with the front buffer, which is being
+            //drawn, so the local update requests are sent after the barrier.
+            sdst::impl::async_worker updater{ [this,&updated]()
+            {
+                _before_update( *this );
+                _execution_policy.for_each_chunk( update_scene() , sdst::impl::evolve_chunk{} );
+                updated = update_scene().size();
+                sdst::impl::end_step( update_scene() , 0 );
+            }};
+
+            do
+            {
+                update_scene() = scene();
+
+                updater.run();
+
+                _before_draw( *this );
+                _drawing_policy( scene() );
+
+                updater.wait();
+
+                _front = 1 - _front;
+                sdst::impl::request_local_updates( scene() , updated , _execution_policy , 0 ); //No update nor draw in flight
+                sdst::impl::global_update( scene() , 0 );
+                _policies.global_update( _execution_policy );
+                _drawing_policy( sdst::state_change::global );
+
+                _before_next( *this );
+            }while( _run_condition( *this ) );
+        }
+
+        /*
+         * Stops the simulation setting the running condition to false.
+         */
+        void stop()
+        {
+            _run_condition = []( const engine_t& ){ return false; };
+        }
+
+        /*
+         * Starts and runs the simulation while the passed condition is true.
+         */
+        simulation_result_t run_while( const running_condition_t& condition )
+        {
+            return run_condition( condition ).start();
+        }
+
+        /*
+         * Starts and runs the simulation until the passed condition is true.
+         */
+        simulation_result_t run_until( const running_condition_t& condition )
+        {
+            return run_while( [&]( const engine_t& e ){ return !condition(e); } );
+        }
+
+        /*
+         * Provides access to the front buffer, the last complete frame.
+         */
+        SCENE& scene()
+        {
+            return _scenes[_front];
+        }
+
+        const SCENE& scene() const
+        {
+            return _scenes[_front];
+        }
+
+        /*
+         * Provides access to the back buffer, the frame being updated.
+         */
+        SCENE& update_scene()
+        {
+            return _scenes[1 - _front];
+        }
+
+        const SCENE& update_scene() const
+        {
+            return _scenes[1 - _front];
+        }
+
+        /*
+         * Gives access to the arena of the shared policies of the scene. Both buffers share them
+         * (See the rules above).
+         */
+        sdst::policy_arena& policies()
+        {
+            return _policies;
+        }
+
+        const sdst::policy_arena& policies() const
+        {
+            return _policies;
+        }
+
+    private:
+        sdst::policy_arena               _policies; //Declared first, so it outlives the scenes
+        scene_t                          _scenes[2];
+        std::size_t                      _front;
+        sdst::erase_state<draw_policy_t> _drawing_policy;
+        execution_policy_t               _execution_policy;
+
+        running_condition_t _run_condition;
+        mutable_action_t    _before_update;
+        mutable_action_t    _before_draw;
+        mutable_action_t    _before_next;
+    };
+
+    template<typename SCENE , typename DRAW_POLICY>
+    sdst::pipelined_engine<typename std::decay<SCENE>::type,typename std::decay<DRAW_POLICY>::type> make_pipelined_engine( SCENE&& scene , DRAW_POLICY&& draw_policy )
+    {
+        return { std::forward<SCENE>( scene ) , std::forward<DRAW_POLICY>( draw_policy ) };
+    }
+
+    template<typename SCENE , typename DRAW_POLICY , typename EXECUTION_POLICY>
+    sdst::pipelined_engine<typename std::decay<SCENE>::type,typename std::decay<DRAW_POLICY>::type,typename std::decay<EXECUTION_POLICY>::type> make_pipelined_engine( SCENE&& scene , DRAW_POLICY&& draw_policy , EXECUTION_POLICY&& execution_policy )
+    {
+        return { std::forward<SCENE>( scene ) , std::forward<DRAW_POLICY>( draw_policy ) , std::forward<EXECUTION_POLICY>( execution_policy ) };
+    }
+}
+
+#endif	/* PIPELINED_ENGINE_HPP */
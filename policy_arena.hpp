@@ -0,0 +1,384 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef POLICY_ARENA_HPP
+#define	POLICY_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Turbo/type_traits.hpp"
+
+#include "execution_policies.hpp"
+#include "shared_policy.hpp"
+#include "stated_policies.hpp"
+
+/*
+ * sdst::shared_policy keeps the shared policy in a std::shared_ptr: Each copy of the handle (One per
+ * particle) is an atomic reference count increment, which contends when the scene is built in parallel,
+ * and each call goes through the control block to a separate heap allocation.
+ *
+ * A policy arena owns the shared policies instead, and hands out plain pointer handles (sdst::arena_policy)
+ * with no reference counting: Copying a handle is copying a pointer, and a call is one load. The policies
+ * are bump-allocated together in blocks, and live until the arena is destroyed. Engines own an arena, so
+ * the policies live as long as the engine:
+ *
+ *     auto gravity = engine.policies().emplace<gravity_policy>( 9.8f );
+ *     auto drawer  = engine.policies().insert( [&]( const particle_data& p ){ ... } );
+ *
+ *     for( std::size_t i = 0 ; i < 1000000 ; ++i )
+ *         engine.scene().emplace_back( particle_data{} , gravity , drawer );
+ *
+ * Handles are not owners: They must not outlive the arena (Or the engine which owns it).
+ *
+ * The arena is also the registry of the stated policies shared by the particles (See stated_policies.hpp),
+ * which should get exactly one global update per frame. The stated policies constructed in the arena are
+ * registered automatically, and policies shared by other means are registered with track():
+ *
+ *     auto wind = sdst::make_shared_policy<wind_policy>( ... );
+ *
+ *     engine.policies().track( wind ); //Keeps a copy of the handle, so the policy lives as long as the engine
+ *
+ * Registered policies are deduplicated by identity (Their address), so tracking a policy twice, or tracking
+ * an arena policy, still gives a single update per frame. The engines send the global updates after updating
+ * the whole scene, each policy once, through their execution policy: Distinct policies are independent, so
+ * the updates run in parallel.
+ */
+
+namespace sdst
+{
+    /*
+     * Non-owning handle to a policy allocated in a sdst::policy_arena. It has the function-like
+     * interface of the policy, as sdst::shared_policy.
+     */
+    template<typename POLICY>
+    struct arena_policy
+    {
+    private:
+        POLICY* _ptr; //Declared first, the call operators use it in their return types
+
+    public:
+        using policy_t = POLICY;
+
+        explicit arena_policy( POLICY* policy = nullptr ) :
+            _ptr{ policy }
+        {}
+
+        /*
+         * Call operator for the arena policy. Calls the underlying policy.
+         */
+        template<typename... ARGS>
+        auto operator()( ARGS&&... args ) -> decltype( (*_ptr)( std::forward<ARGS>( args )... ) )
+        {
+            return (*_ptr)( std::forward<ARGS>( args )... );
+        }
+
+        /*
+         * (const) Call operator for the arena policy. Calls the underlying policy.
+         */
+        template<typename... ARGS>
+        auto operator()( ARGS&&... args ) const -> decltype( (*_ptr)( std::forward<ARGS>( args )... ) )
+        {
+            return (*_ptr)( std::forward<ARGS>( args )... );
+        }
+
+        /*
+         * Gives access to the underlying policy.
+         */
+        POLICY& get() const
+        {
+            return *_ptr;
+        }
+    };
+
+    /*
+     * Owns a set of policies of any type, allocated contiguously in blocks. Policies are never
+     * moved, so the handles stay valid until the arena is destroyed or cleared. The arena can be
+     * moved (The blocks are not), but not copied.
+     */
+    struct policy_arena
+    {
+    public:
+        policy_arena() :
+            _used{ 0 },
+            _capacity{ 0 }
+        {}
+
+        policy_arena( const policy_arena& ) = delete;
+        policy_arena& operator=( const policy_arena& ) = delete;
+
+        policy_arena( policy_arena&& other ) :
+            policy_arena{}
+        {
+            swap( other );
+        }
+
+        policy_arena& operator=( policy_arena&& other )
+        {
+            policy_arena{ std::move( other ) }.swap( *this );
+
+            return *this;
+        }
+
+        ~policy_arena()
+        {
+            clear();
+        }
+
+        /*
+         * Constructs a policy in the arena from the given arguments, and returns a handle to it.
+         * Stated policies are registered for global updates.
+         */
+        template<typename POLICY , typename... ARGS>
+        sdst::arena_policy<POLICY> emplace( ARGS&&... args )
+        {
+            reserve_one( _stated );
+
+            POLICY* policy = construct<POLICY>( std::forward<ARGS>( args )... );
+
+            register_updates( policy );
+
+            return sdst::arena_policy<POLICY>{ policy };
+        }
+
+        /*
+         * Copies (Or moves) a policy into the arena, and returns a handle to it.
+         */
+        template<typename POLICY>
+        sdst::arena_policy<typename std::decay<POLICY>::type> insert( POLICY&& policy )
+        {
+            return emplace<typename std::decay<POLICY>::type>( std::forward<POLICY>( policy ) );
+        }
+
+        /*
+         * Registers a shared policy for global updates (If it is stated). The arena keeps a copy of
+         * the handle, so the policy lives at least as long as the arena.
+         */
+        template<typename POLICY>
+        void track( const sdst::shared_policy<POLICY>& policy )
+        {
+            reserve_one( _stated );
+
+            register_updates( &construct<sdst::shared_policy<POLICY>>( policy )->get() );
+        }
+
+        /*
+         * Registers an arena policy (Of this or another arena) for global updates, if it is stated.
+         */
+        template<typename POLICY>
+        void track( const sdst::arena_policy<POLICY>& policy )
+        {
+            register_updates( &policy.get() );
+        }
+
+        /*
+         * Sends a global update to each registered policy, once, through the execution policy.
+         */
+        template<typename EXECUTION_POLICY = sdst::sequential_execution>
+        void global_update( const EXECUTION_POLICY& execution_policy = EXECUTION_POLICY{} )
+        {
+            const std::size_t count = _stated.size();
+
+            if( count == 1 )
+                _stated.front().update( _stated.front().policy , sdst::state_change::global );
+            else if( count > 1 )
+            {
+                execution_policy.for_each_range( 0 , count , 1 , [this]( std::size_t begin , std::size_t end )
+                {
+                    for( std::size_t i = begin ; i < end ; ++i )
+                        _stated[i].update( _stated[i].policy , sdst::state_change::global );
+                });
+            }
+        }
+
+        /*
+         * Returns the number of policies registered for global updates.
+         */
+        std::size_t tracked() const
+        {
+            return _stated.size();
+        }
+
+        /*
+         * Returns the number of policies of the arena.
+         */
+        std::size_t size() const
+        {
+            return _entries.size();
+        }
+
+        /*
+         * Destroys all the policies, in reverse order of construction, and frees the blocks.
+         * The handles become dangling.
+         */
+        void clear()
+        {
+            for( auto it = _entries.rbegin() ; it != _entries.rend() ; ++it )
+                it->destroy( it->policy );
+
+            _entries.clear();
+            _stated.clear();
+            _blocks.clear();
+            _used     = 0;
+            _capacity = 0;
+        }
+
+        void swap( policy_arena& other )
+        {
+            std::swap( _blocks   , other._blocks );
+            std::swap( _entries  , other._entries );
+            std::swap( _stated   , other._stated );
+            std::swap( _used     , other._used );
+            std::swap( _capacity , other._capacity );
+        }
+
+    private:
+        enum : std::size_t { block_size = 4096 };
+
+        struct entry
+        {
+            void* policy;
+            void  (*destroy)( void* );
+        };
+
+        template<typename POLICY>
+        static void destroy( void* policy )
+        {
+            static_cast<POLICY*>( policy )->~POLICY();
+        }
+
+        using update_function_t = void(*)( void* , sdst::state_change );
+
+        struct stated_entry
+        {
+            void*             policy;
+            update_function_t update;
+        };
+
+        /*
+         * Gives the global update function of stated policies. This specialization is rejected if
+         * the policy is not stated.
+         */
+        template<typename POLICY , typename HAS_STATE = tml::is_valid_call<POLICY,sdst::state_change>>
+        struct updater
+        {
+            static void update( void* policy , sdst::state_change change )
+            {
+                ( *static_cast<POLICY*>( policy ) )( change );
+            }
+
+            static update_function_t get()
+            {
+                return &updater::update;
+            }
+        };
+
+        /*
+         * Gives the global update function of stated policies. This specialization is rejected if
+         * the policy is stated.
+         */
+        template<typename POLICY>
+        struct updater<POLICY,tml::false_type>
+        {
+            static update_function_t get()
+            {
+                return nullptr;
+            }
+        };
+
+        template<typename POLICY , typename... ARGS>
+        POLICY* construct( ARGS&&... args )
+        {
+            reserve_one( _entries ); //So registering the policy can't throw
+
+            POLICY* policy = new( allocate( sizeof( POLICY ) , alignof( POLICY ) ) ) POLICY{ std::forward<ARGS>( args )... };
+
+            _entries.push_back( entry{ policy , &policy_arena::destroy<POLICY> } );
+
+            return policy;
+        }
+
+        /*
+         * Makes room for one more element, so the next push_back() can't throw. Grows geometrically,
+         * as push_back() does, so inserting n policies stays linear.
+         */
+        template<typename T>
+        static void reserve_one( std::vector<T>& vector )
+        {
+            if( vector.size() == vector.capacity() )
+                vector.reserve( 2 * vector.size() + 1 );
+        }
+
+        /*
+         * Registers a policy for global updates, unless it is not stated or already registered. Callers
+         * reserve room for the entry first. Registration is done once per shared policy while building
+         * the scene, so a linear search is enough.
+         */
+        template<typename POLICY>
+        void register_updates( POLICY* policy )
+        {
+            const update_function_t update = updater<POLICY>::get();
+
+            if( update == nullptr )
+                return;
+
+            for( const stated_entry& e : _stated )
+                if( e.policy == static_cast<void*>( policy ) )
+                    return;
+
+            _stated.push_back( stated_entry{ policy , update } );
+        }
+
+        /*
+         * Bump allocation from the last block. Policies larger than a block get a block of their own.
+         */
+        void* allocate( std::size_t size , std::size_t alignment )
+        {
+            std::uintptr_t base    = _blocks.empty() ? 0 : reinterpret_cast<std::uintptr_t>( _blocks.back().get() );
+            std::uintptr_t address = ( base + _used + alignment - 1 ) & ~static_cast<std::uintptr_t>( alignment - 1 );
+
+            if( _blocks.empty() || address + size > base + _capacity )
+            {
+                _capacity = size + alignment > block_size ? size + alignment : block_size;
+
+                _blocks.emplace_back( new unsigned char[_capacity] );
+
+                base    = reinterpret_cast<std::uintptr_t>( _blocks.back().get() );
+                address = ( base + alignment - 1 ) & ~static_cast<std::uintptr_t>( alignment - 1 );
+            }
+
+            _used = address + size - base;
+
+            return reinterpret_cast<void*>( address );
+        }
+
+        std::vector<std::unique_ptr<unsigned char[]>> _blocks;
+        std::vector<entry>                            _entries;
+        std::vector<stated_entry>                     _stated;   //Registered for global updates
+        std::size_t                                   _used;     //Bytes used of the last block
+        std::size_t                                   _capacity; //Bytes of the last block
+    };
+}
+
+#endif	/* POLICY_ARENA_HPP */
@@ -0,0 +1,670 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef POOL_SCENE_HPP
+#define	POOL_SCENE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "batch_policies.hpp"
+#include "proxy_iterator.hpp"
+#include "spatial_grid.hpp"
+#include "stated_policies.hpp"
+
+/*
+ * Particles of the other scenes never die, so effects like fountains or explosions have to respawn
+ * particles in place from their evolution policies.
+ *
+ * A pool scene is a homogeneous scene (See homogeneous_scene.hpp) with a fixed capacity where particles
+ * are born and die: Each particle has a lifetime, consumed by each update, and dies when it reaches
+ * zero (Or when its killed through its proxy). The live particles are always the contiguous range
+ * [0,size()), so the updates only touch live particles. All the storage is allocated at construction,
+ * spawning and removing particles never allocates.
+ *
+ * Dead particles are not removed during the update (Which can run in parallel), they are removed when
+ * the step finishes: The engines call collect() on the scenes which provide it after updating the scene.
+ * The removal is done in one of two ways (See sdst::removal):
+ *
+ *  - Swap with last: Each dead particle is replaced by the last live one. Costs O(dead particles), but
+ *    the order of the particles changes.
+ *  - Compaction: The live particles after the first dead one are moved down, keeping their order.
+ *    Costs O(particles after the first dead one).
+ *
+ * Either way live particles change their index. Data kept outside the scene per index (Like particle
+ * trails, see trails.hpp) can follow them through the moves of the last collect() (See moves()).
+ */
+
+namespace sdst
+{
+    /*
+     * How a pool scene removes its dead particles.
+     */
+    enum class removal
+    {
+        swap_with_last,
+        compaction
+    };
+
+    /*
+     * A particle moved by the removal of dead particles, from one index of the scene to another.
+     */
+    struct particle_move
+    {
+        std::size_t from , to;
+    };
+
+    template<typename SCENE>
+    struct pool_particle;
+
+    template<typename DATA , typename EVOLUTION_POLICY , typename DRAW_POLICY>
+    struct pool_scene
+    {
+    public:
+        /*
+         * The type which holds the data of a particle
+         */
+        using data_t = DATA;
+
+        /*
+         * The type of the particle evolution policy
+         */
+        using evolution_policy_t = typename std::decay<EVOLUTION_POLICY>::type;
+
+        /*
+         * The type of the particle drawing policy
+         */
+        using drawing_policy_t = typename std::decay<DRAW_POLICY>::type;
+
+        /*
+         * The type of the scene
+         */
+        using scene_t = pool_scene;
+
+        /*
+         * The type of the proxies representing the particles of the scene.
+         */
+        using particle_t       = sdst::pool_particle<pool_scene>;
+        using const_particle_t = sdst::pool_particle<const pool_scene>;
+
+        using iterator       = sdst::proxy_iterator<particle_t,pool_scene>;
+        using const_iterator = sdst::proxy_iterator<const_particle_t,const pool_scene>;
+
+
+        /*
+         * Initializes an empty scene with room for 'capacity' particles, given the evolution and drawing
+         * policies of its particles.
+         */
+        explicit pool_scene( std::size_t capacity , const evolution_policy_t& evolution_policy = evolution_policy_t{} , const drawing_policy_t& drawing_policy = drawing_policy_t{} ) :
+            _data( capacity ),
+            _lifetimes( capacity ),
+            _dead( capacity ),
+            _size{ 0 },
+            _dying{ 0 },
+            _collections{ 0 },
+            _aging{ 1.0f },
+            _removal{ sdst::removal::swap_with_last },
+            _evolution_policy{ evolution_policy },
+            _draw_policy{ drawing_policy },
+            _spatial_index{ nullptr }
+        {}
+
+        pool_scene( const pool_scene& other ) :
+            _data( other._data ),
+            _lifetimes( other._lifetimes ),
+            _dead( other._dead ),
+            _size{ other._size },
+            _dying{ other._dying.load() },
+            _moves( other._moves ),
+            _collections{ other._collections },
+            _aging{ other._aging },
+            _removal{ other._removal },
+            _evolution_policy{ other._evolution_policy },
+            _draw_policy{ other._draw_policy },
+            _spatial_index{ other._spatial_index }
+        {}
+
+        pool_scene& operator=( const pool_scene& other )
+        {
+            _data             = other._data;
+            _lifetimes        = other._lifetimes;
+            _dead             = other._dead;
+            _size             = other._size;
+            _dying            = other._dying.load();
+            _moves            = other._moves;
+            _collections      = other._collections;
+            _aging            = other._aging;
+            _removal          = other._removal;
+            _evolution_policy = other._evolution_policy;
+            _draw_policy      = other._draw_policy;
+            _spatial_index    = other._spatial_index;
+
+            return *this;
+        }
+
+        /*
+         * Adds a particle which lives 'lifetime' units of time (See aging()). By default particles
+         * live forever. Returns false, and does nothing, if the scene is full or the lifetime is not
+         * positive (The particle would never be counted as dead, so it would never be removed).
+         *
+         * Spawning is not thread-safe: Particles should be spawned between steps (From the engine
+         * actions, for example), not from the policies.
+         */
+        bool spawn( const data_t& data , float lifetime = std::numeric_limits<float>::infinity() )
+        {
+            if( _size == capacity() || !( lifetime > 0.0f ) )
+                return false;
+
+            _data[_size]      = data;
+            _lifetimes[_size] = lifetime;
+            ++_size;
+
+            return true;
+        }
+
+        /*
+         * Adds up to 'count' particles without initializing them (As many as fit in the scene), and returns
+         * the index of the first one. The new particles are [first,size()), their data and lifetimes should
+         * be set through data() and lifetimes() before the next step, with positive lifetimes (See spawn()).
+         * Used by emitters to write new particles in place, in parallel.
+         */
+        std::size_t allocate( std::size_t count )
+        {
+            const std::size_t first = _size;
+
+            _size += std::min( count , capacity() - _size );
+
+            return first;
+        }
+
+        /*
+         * Kills a particle. Its removed when the current step finishes (See collect()).
+         *
+         * Killing is not synchronized with the updates: During a step a particle should only be killed
+         * from its own update (Through the proxy passed to the evolution policy), which runs on a single
+         * thread and ages the particle after evolving it. Between steps any particle can be killed.
+         */
+        void kill( std::size_t index )
+        {
+            if( _lifetimes[index] > 0.0f )
+            {
+                _lifetimes[index] = 0.0f;
+                _dead[_dying++]   = index;
+            }
+        }
+
+        /*
+         * Removes the dead particles. Called by the engines after each step.
+         */
+        void collect()
+        {
+            const std::size_t dying = _dying.exchange( 0 );
+
+            _moves.reserve( capacity() ); //Once, so recording the moves doesn't allocate
+            _moves.clear();
+            ++_collections;
+
+            if( dying == 0 )
+                return;
+
+            if( _removal == sdst::removal::swap_with_last )
+            {
+                //Processing the dead particles from the back, the last particle is always alive when moved.
+                //A particle listed twice would remove a live one, so duplicates are dropped:
+                std::sort( _dead.begin() , _dead.begin() + dying , std::greater<std::size_t>() );
+
+                const std::size_t unique = std::unique( _dead.begin() , _dead.begin() + dying ) - _dead.begin();
+
+                for( std::size_t i = 0 ; i < unique ; ++i )
+                {
+                    const std::size_t dead = _dead[i];
+
+                    if( dead != --_size )
+                    {
+                        _data[dead]      = std::move( _data[_size] );
+                        _lifetimes[dead] = _lifetimes[_size];
+                        _moves.push_back( sdst::particle_move{ _size , dead } );
+                    }
+                }
+            }
+            else
+            {
+                std::size_t live = *std::min_element( _dead.begin() , _dead.begin() + dying );
+
+                for( std::size_t i = live + 1 ; i < _size ; ++i )
+                {
+                    if( _lifetimes[i] > 0.0f )
+                    {
+                        _data[live]      = std::move( _data[i] );
+                        _lifetimes[live] = _lifetimes[i];
+                        _moves.push_back( sdst::particle_move{ i , live } );
+                        ++live;
+                    }
+                }
+
+                _size = live;
+            }
+        }
+
+        /*
+         * Returns the particles moved by the last collect(), in the order they were moved.
+         */
+        const std::vector<sdst::particle_move>& moves() const
+        {
+            return _moves;
+        }
+
+        /*
+         * Returns the number of calls to collect(), so observers of moves() can tell whether they
+         * missed some.
+         */
+        std::size_t collections() const
+        {
+            return _collections;
+        }
+
+        /*
+         * Sets the lifetime consumed by each update of a particle. One by default, so lifetimes are
+         * counted in steps. Set it to the timestep to count them in seconds.
+         */
+        void aging( float lifetime_per_step )
+        {
+            _aging = lifetime_per_step;
+        }
+
+        float aging() const
+        {
+            return _aging;
+        }
+
+        /*
+         * Sets how dead particles are removed. Swap with last by default.
+         */
+        void removal( sdst::removal removal )
+        {
+            _removal = removal;
+        }
+
+        sdst::removal removal() const
+        {
+            return _removal;
+        }
+
+        /*
+         * Kills all the particles.
+         */
+        void clear()
+        {
+            _size  = 0;
+            _dying = 0;
+        }
+
+        /*
+         * Returns the number of live particles.
+         */
+        std::size_t size() const
+        {
+            return _size;
+        }
+
+        std::size_t capacity() const
+        {
+            return _data.size();
+        }
+
+        bool empty() const
+        {
+            return _size == 0;
+        }
+
+        bool full() const
+        {
+            return _size == capacity();
+        }
+
+
+        iterator begin()
+        {
+            return { this , 0 };
+        }
+
+        iterator end()
+        {
+            return { this , size() };
+        }
+
+        const_iterator begin() const
+        {
+            return { this , 0 };
+        }
+
+        const_iterator end() const
+        {
+            return { this , size() };
+        }
+
+        particle_t operator[]( std::size_t index )
+        {
+            return { this , index };
+        }
+
+        const_particle_t operator[]( std::size_t index ) const
+        {
+            return { this , index };
+        }
+
+
+        /*
+         * Updates the particles in the range [first,first + count), as homogeneous_scene::update() does,
+         * and consumes their lifetime.
+         */
+        void update( std::size_t first , std::size_t count )
+        {
+            evolve( first , count );
+            request_local_updates( count );
+        }
+
+        /*
+         * Evolves the particles in the range [first,first + count) and consumes their lifetime, without
+         * sending their local update requests. For engines which send them later (See sdst::pipelined_engine).
+         */
+        void evolve( std::size_t first , std::size_t count )
+        {
+            evolve_block<evolution_policy_t>::execute( *this , first , count );
+        }
+
+        /*
+         * Sends the local update requests of 'count' particles to the policies at once.
+         */
+        void request_local_updates( std::size_t count )
+        {
+            _evolution_policy( sdst::local_updates{ count } );
+            _draw_policy( sdst::local_updates{ count } );
+        }
+
+
+        /*
+         * Gives access to the contiguous array where the data of the particles is stored.
+         */
+        data_t* data()
+        {
+            return _data.data();
+        }
+
+        const data_t* data() const
+        {
+            return _data.data();
+        }
+
+        /*
+         * Gives access to the contiguous array where the remaining lifetimes of the particles are stored.
+         */
+        float* lifetimes()
+        {
+            return _lifetimes.data();
+        }
+
+        const float* lifetimes() const
+        {
+            return _lifetimes.data();
+        }
+
+
+        /*
+         * Gives access to the evolution policy shared by all the particles.
+         */
+        sdst::erase_state<evolution_policy_t>& evolution_policy()
+        {
+            return _evolution_policy;
+        }
+
+        const sdst::erase_state<evolution_policy_t>& evolution_policy() const
+        {
+            return _evolution_policy;
+        }
+
+        /*
+         * Gives access to the drawing policy shared by all the particles.
+         */
+        sdst::erase_state<drawing_policy_t>& drawing_policy()
+        {
+            return _draw_policy;
+        }
+
+        const sdst::erase_state<drawing_policy_t>& drawing_policy() const
+        {
+            return _draw_policy;
+        }
+
+        /*
+         * Attaches a spatial index to the scene (nullptr detaches it). Evolution policies with the
+         * extended signature void(DATA&,const sdst::neighbors<DATA>&) are passed the neighbors of each
+         * particle found in the index (See spatial_grid.hpp). The index should outlive the scene.
+         */
+        void spatial_index( const sdst::spatial_index<data_t>* index )
+        {
+            _spatial_index = index;
+        }
+
+        const sdst::spatial_index<data_t>* spatial_index() const
+        {
+            return _spatial_index;
+        }
+
+    private:
+        template<typename SCENE>
+        friend struct sdst::pool_particle;
+
+        /*
+         * Consumes the lifetime of the particles in the range [first,first + count).
+         */
+        void age( std::size_t first , std::size_t count )
+        {
+            for( std::size_t i = first ; i < first + count ; ++i )
+            {
+                float& lifetime = _lifetimes[i];
+
+                if( lifetime > 0.0f && ( lifetime -= _aging ) <= 0.0f )
+                    _dead[_dying++] = i;
+            }
+        }
+
+        /*
+         * Block evolution. This specialization is rejected if the evolution
+         * policy doesn't support the batch signature.
+         */
+        template<typename P , typename IS_BATCH = sdst::is_batch_policy<P,data_t*>>
+        struct evolve_block
+        {
+            static void execute( pool_scene& scene , std::size_t first , std::size_t count )
+            {
+                scene._evolution_policy( scene.data() + first , count );
+
+                scene.age( first , count );
+            }
+        };
+
+        /*
+         * Block evolution. This specialization is rejected if the evolution
+         * policy supports the batch signature.
+         */
+        template<typename P>
+        struct evolve_block<P,tml::false_type>
+        {
+            static void execute( pool_scene& scene , std::size_t first , std::size_t count )
+            {
+                for( std::size_t i = first ; i < first + count ; ++i )
+                    scene[i].evolve();
+
+                scene.age( first , count );
+            }
+        };
+
+        std::vector<data_t>                   _data;
+        std::vector<float>                    _lifetimes;
+        std::vector<std::size_t>              _dead;  //Indices of the particles died since the last collect()
+        std::size_t                           _size;
+        std::atomic<std::size_t>              _dying; //Number of particles died since the last collect()
+        std::vector<sdst::particle_move>      _moves; //Particles moved by the last collect()
+        std::size_t                           _collections;
+        float                                 _aging;
+        sdst::removal                         _removal;
+        sdst::erase_state<evolution_policy_t> _evolution_policy;
+        sdst::erase_state<drawing_policy_t>   _draw_policy;
+        const sdst::spatial_index<data_t>*    _spatial_index;
+    };
+
+    /*
+     * A reference to a particle of a pool scene. SCENE is const-qualified for readonly proxies.
+     */
+    template<typename SCENE>
+    struct pool_particle
+    {
+    public:
+        using scene_t = typename std::remove_const<SCENE>::type;
+        using data_t  = typename scene_t::data_t;
+
+        pool_particle( SCENE* scene = nullptr , std::size_t index = 0 ) :
+            _scene{ scene },
+            _index{ index }
+        {}
+
+        /*
+         * Updates the particle: Calls the evolution policy, sends a local update
+         * request to the policies, and consumes its lifetime.
+         *
+         * The evolution policy is passed the proxy if it accepts it, so it can kill the particle or
+         * read its lifetime, else the particle data (And its neighbors, if the policy takes them).
+         */
+        void update() const
+        {
+            evolve();
+
+            _scene->evolution_policy()( sdst::state_change::local );
+            _scene->drawing_policy()( sdst::state_change::local );
+
+            _scene->age( _index , 1 );
+        }
+
+        /*
+         * Calls the evolution policy only, without the local update requests nor the aging (The
+         * scene does both for whole blocks, see pool_scene::update()).
+         */
+        void evolve() const
+        {
+            evolution_call<typename scene_t::evolution_policy_t>::execute( *this );
+        }
+
+        /*
+         * Draws the particle
+         */
+        void draw() const
+        {
+            _scene->drawing_policy()( data() );
+        }
+
+        /*
+         * Kills the particle. Its removed when the current step finishes.
+         */
+        void kill() const
+        {
+            _scene->kill( _index );
+        }
+
+        /*
+         * Returns the remaining lifetime of the particle.
+         */
+        float lifetime() const
+        {
+            return _scene->lifetimes()[_index];
+        }
+
+        /*
+         * Checks whether the particle is alive. Dead particles can still be seen
+         * during the step they die.
+         */
+        bool alive() const
+        {
+            return lifetime() > 0.0f;
+        }
+
+        /*
+         * Gives access to the particle data (Readonly if the scene is const).
+         */
+        auto data() const -> decltype( *std::declval<SCENE&>().data() )
+        {
+            return _scene->data()[_index];
+        }
+
+        operator const data_t&() const
+        {
+            return data();
+        }
+
+        /*
+         * Returns the index of the particle in the scene.
+         */
+        std::size_t index() const
+        {
+            return _index;
+        }
+
+    private:
+        template<typename P , typename ACCEPTS_PROXY = tml::is_valid_call<P,const pool_particle&>>
+        struct evolution_call
+        {
+            static void execute( const pool_particle& particle )
+            {
+                particle._scene->evolution_policy()( particle );
+            }
+        };
+
+        template<typename P>
+        struct evolution_call<P,tml::false_type>
+        {
+            static void execute( const pool_particle& particle )
+            {
+                sdst::impl::evolve_data<P,data_t>::execute( particle._scene->evolution_policy() , particle.data() , particle._scene->spatial_index() , particle._index );
+            }
+        };
+
+        SCENE*      _scene;
+        std::size_t _index;
+    };
+
+    /*
+     * Type-deduction-based builder for pool scenes:
+     *
+     *     auto scene = sdst::make_pool_scene<sf::Vertex>( 1000000 , evolution{} , draw{} );
+     */
+    template<typename DATA , typename EVOLUTION_POLICY , typename DRAW_POLICY>
+    sdst::pool_scene<DATA,typename std::decay<EVOLUTION_POLICY>::type,typename std::decay<DRAW_POLICY>::type>
+    make_pool_scene( std::size_t capacity , EVOLUTION_POLICY&& evolution_policy , DRAW_POLICY&& draw_policy )
+    {
+        return sdst::pool_scene<DATA,typename std::decay<EVOLUTION_POLICY>::type,typename std::decay<DRAW_POLICY>::type>{ capacity , std::forward<EVOLUTION_POLICY>( evolution_policy ) , std::forward<DRAW_POLICY>( draw_policy ) };
+    }
+}
+
+#endif	/* POOL_SCENE_HPP */
@@ -0,0 +1,204 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef PROXY_ITERATOR_HPP
+#define	PROXY_ITERATOR_HPP
+
+#include <cstddef>
+#include <iterator>
+
+namespace sdst
+{
+    /*
+     * Random access iterator for scenes which don't store particles as objects, and represent
+     * them through reference-like proxies instead (See soa_scene.hpp and homogeneous_scene.hpp).
+     *
+     * PROXY should be constructible from a pointer to the scene and the index of the particle, and
+     * copy assignable.
+     *
+     * Dereferencing returns the proxy by value (The proxy itself is the reference to the particle),
+     * so range-based for loops should bind it as 'for( auto&& particle : scene )' or
+     * 'for( const auto& particle : scene )'. Proxies are independent of the iterator which returned
+     * them, so they stay valid while the particle does.
+     */
+    template<typename PROXY , typename SCENE>
+    struct proxy_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type        = PROXY;
+        using difference_type   = std::ptrdiff_t;
+        using reference         = value_type;
+
+        /*
+         * Result of operator->(): Holds the proxy, since there's no particle object to point to.
+         */
+        struct pointer
+        {
+            value_type proxy;
+
+            const value_type* operator->() const
+            {
+                return &proxy;
+            }
+        };
+
+        proxy_iterator( SCENE* scene = nullptr , std::size_t index = 0 ) :
+            _scene{ scene },
+            _index{ index }
+        {}
+
+        proxy_iterator( const proxy_iterator& other ) :
+            _scene{ other._scene },
+            _index{ other._index }
+        {}
+
+        proxy_iterator& operator=( const proxy_iterator& other )
+        {
+            _scene = other._scene;
+            _index = other._index;
+            return *this;
+        }
+
+        reference operator*() const
+        {
+            return { _scene , _index };
+        }
+
+        pointer operator->() const
+        {
+            return { **this };
+        }
+
+        value_type operator[]( difference_type n ) const
+        {
+            return { _scene , _index + n };
+        }
+
+        /*
+         * Returns the index of the referenced particle in the scene.
+         */
+        std::size_t index() const
+        {
+            return _index;
+        }
+
+        /*
+         * Returns the scene the iterator traverses.
+         */
+        SCENE* scene() const
+        {
+            return _scene;
+        }
+
+        proxy_iterator& operator++()
+        {
+            ++_index;
+            return *this;
+        }
+
+        proxy_iterator& operator--()
+        {
+            --_index;
+            return *this;
+        }
+
+        proxy_iterator operator++( int )
+        {
+            proxy_iterator copy{ *this };
+            ++_index;
+            return copy;
+        }
+
+        proxy_iterator operator--( int )
+        {
+            proxy_iterator copy{ *this };
+            --_index;
+            return copy;
+        }
+
+        proxy_iterator& operator+=( difference_type n )
+        {
+            _index += n;
+            return *this;
+        }
+
+        proxy_iterator& operator-=( difference_type n )
+        {
+            _index -= n;
+            return *this;
+        }
+
+        friend proxy_iterator operator+( proxy_iterator it , difference_type n )
+        {
+            return it += n;
+        }
+
+        friend proxy_iterator operator+( difference_type n , proxy_iterator it )
+        {
+            return it += n;
+        }
+
+        friend proxy_iterator operator-( proxy_iterator it , difference_type n )
+        {
+            return it -= n;
+        }
+
+        friend difference_type operator-( const proxy_iterator& lhs , const proxy_iterator& rhs )
+        {
+            return static_cast<difference_type>( lhs._index ) - static_cast<difference_type>( rhs._index );
+        }
+
+        friend bool operator==( const proxy_iterator& lhs , const proxy_iterator& rhs )
+        {
+            return lhs._index == rhs._index;
+        }
+
+        friend bool operator!=( const proxy_iterator& lhs , const proxy_iterator& rhs )
+        {
+            return !( lhs == rhs );
+        }
+
+        friend bool operator<( const proxy_iterator& lhs , const proxy_iterator& rhs )
+        {
+            return lhs._index < rhs._index;
+        }
+
+        friend bool operator>( const proxy_iterator& lhs , const proxy_iterator& rhs )
+        {
+            return rhs < lhs;
+        }
+
+        friend bool operator<=( const proxy_iterator& lhs , const proxy_iterator& rhs )
+        {
+            return !( rhs < lhs );
+        }
+
+        friend bool operator>=( const proxy_iterator& lhs , const proxy_iterator& rhs )
+        {
+            return !( lhs < rhs );
+        }
+
+    private:
+        SCENE*      _scene;
+        std::size_t _index;
+    };
+}
+
+#endif	/* PROXY_ITERATOR_HPP */
@@ -0,0 +1,185 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef RANDOM_HPP
+#define	RANDOM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd_kernels.hpp"
+#include "stated_policies.hpp"
+
+/*
+ * A std::mt19937 is 2.5 KB of sequential state: Each number depends on the previous one, so a policy
+ * holding one can't be called from multiple threads, and the numbers a particle gets depend on the order
+ * the particles were updated in (And hence on the number of threads).
+ *
+ * sdst::counter_rng is a counter-based generator instead: The random numbers are a pure function of
+ * (seed, particle index, frame, stream), computed with Philox4x32-10 (See simd_kernels.hpp). It has no
+ * sequential state, so it can be shared by all the particles and threads, and a particle gets the same
+ * numbers regardless of how the scene is split:
+ *
+ *     sdst::counter_rng random{ seed };
+ *
+ *     float xy[4];
+ *     random.uniform( index , 0 , xy );       //Four uniform floats of the particle this frame
+ *     float jitter = random.normal( index , 1 ); //A normal float of another stream
+ *
+ * Whole blocks of particles are generated at once with the SIMD kernels, one particle per vector lane:
+ *
+ *     random.uniforms( first , count , 0 , out , count ); //Four columns of 'count' floats
+ *
+ * The frame is part of the generator: It is a stated policy (See stated_policies.hpp) which advances
+ * to the next frame on each global update. Engines only send global updates to the policies they know:
+ * The policies owned by the scene (sdst::homogeneous_scene and the like) forward them, else the generator
+ * should live in the engine arena (Or be tracked by it, see policy_arena.hpp), and the particle policies
+ * hold a handle to it:
+ *
+ *     auto random = engine.policies().emplace<sdst::counter_rng>( seed ); //sdst::arena_policy<counter_rng>
+ *
+ * A generator held by value in the policy of each particle is copied per particle and never advances.
+ * The stream tells apart the different uses of randomness on the same particle and frame.
+ */
+
+namespace sdst
+{
+    struct counter_rng
+    {
+    public:
+        explicit counter_rng( std::uint64_t seed = 0 , std::uint32_t frame = 0 ) :
+            _seed{ seed },
+            _frame{ frame }
+        {}
+
+        /*
+         * Stated policy update: The generator moves to the next frame once per simulation frame.
+         */
+        void operator()( sdst::state_change change )
+        {
+            if( change == sdst::state_change::global )
+                ++_frame;
+        }
+
+        /*
+         * Returns the random word 'word' (In [0,4)) of a particle in the current frame.
+         */
+        std::uint32_t bits( std::uint32_t index , std::uint32_t stream = 0 , std::size_t word = 0 ) const
+        {
+            std::uint32_t counter[] = { index , _frame , stream , 0 };
+
+            sdst::kernels::philox::block( counter , key0() , key1() );
+
+            return counter[word];
+        }
+
+        /*
+         * Returns a float uniform in [0,1) of a particle in the current frame.
+         */
+        float uniform( std::uint32_t index , std::uint32_t stream = 0 ) const
+        {
+            return sdst::kernels::philox::to_unit( bits( index , stream ) );
+        }
+
+        /*
+         * Writes four floats uniform in [0,1) of a particle in the current frame. The first one
+         * is uniform( index , stream ).
+         */
+        void uniform( std::uint32_t index , std::uint32_t stream , float* out ) const
+        {
+            sdst::kernels::scalar::philox_uniform( out , 1 , 1 , index , _frame , stream , key0() , key1() );
+        }
+
+        /*
+         * Returns a standard normal float of a particle in the current frame.
+         */
+        float normal( std::uint32_t index , std::uint32_t stream = 0 ) const
+        {
+            float out[4];
+
+            normal( index , stream , out );
+
+            return out[0];
+        }
+
+        /*
+         * Writes four standard normal floats of a particle in the current frame. The first one
+         * is normal( index , stream ).
+         */
+        void normal( std::uint32_t index , std::uint32_t stream , float* out ) const
+        {
+            uniform( index , stream , out );
+
+            sdst::kernels::philox::box_muller( out[0] , out[1] );
+            sdst::kernels::philox::box_muller( out[2] , out[3] );
+        }
+
+        /*
+         * Batch version of uniform( index , stream , out ) for the particles [first,first + count): The four
+         * floats of the particle first + i are written to out[i], out[stride + i], out[2*stride + i] and
+         * out[3*stride + i]. The numbers are exactly the ones of the per-particle calls.
+         */
+        void uniforms( std::uint32_t first , std::size_t count , std::uint32_t stream , float* out , std::size_t stride ) const
+        {
+            sdst::kernels::philox_uniform( out , stride , count , first , _frame , stream , key0() , key1() );
+        }
+
+        /*
+         * Batch version of normal( index , stream , out ), with the layout of uniforms().
+         */
+        void normals( std::uint32_t first , std::size_t count , std::uint32_t stream , float* out , std::size_t stride ) const
+        {
+            sdst::kernels::philox_normal( out , stride , count , first , _frame , stream , key0() , key1() );
+        }
+
+        std::uint64_t seed() const
+        {
+            return _seed;
+        }
+
+        std::uint32_t frame() const
+        {
+            return _frame;
+        }
+
+        /*
+         * Sets the current frame (To replay a frame, for example).
+         */
+        void set_frame( std::uint32_t frame )
+        {
+            _frame = frame;
+        }
+
+    private:
+        std::uint32_t key0() const
+        {
+            return static_cast<std::uint32_t>( _seed );
+        }
+
+        std::uint32_t key1() const
+        {
+            return static_cast<std::uint32_t>( _seed >> 32 );
+        }
+
+        std::uint64_t _seed;
+        std::uint32_t _frame;
+    };
+}
+
+#endif	/* RANDOM_HPP */
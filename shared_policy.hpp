@@ -30,10 +30,16 @@ namespace sdst
      * function entity that acts as a policy. This allows the library to perform 
      * static type-erasure and make shared policies behave like other policies, with 
      * exactly the same function-like interface.
+     * 
+     * Copies are reference counted atomically. For policies shared by many particles see
+     * sdst::policy_arena (policy_arena.hpp), whose handles are plain pointers.
      */
     template<typename POLICY>
     struct shared_policy
     {
+    private:
+        std::shared_ptr<POLICY> _ptr; //Declared first, the call operators use it in their return types
+        
     public:
         /*
          * Initializes a shared policy given an underlying policy.
@@ -60,9 +66,14 @@ namespace sdst
         {
             return (*_ptr)( std::forward<ARGS>( args )... );
         }
-            
-    private:
-        std::shared_ptr<POLICY> _ptr;
+        
+        /*
+         * Gives access to the underlying policy.
+         */
+        POLICY& get() const
+        {
+            return *_ptr;
+        }
     };
     
     /*
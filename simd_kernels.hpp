@@ -0,0 +1,555 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef SIMD_KERNELS_HPP
+#define	SIMD_KERNELS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Low level kinematic kernels used by the built-in evolution policies (See forces.hpp).
+ *
+ * Kernels work on contiguous columns of 2D vectors stored interleaved (x0,y0,x1,y1,...), the layout of
+ * a column of sf::Vector2f or any other {float x,y} type. 'count' is the number of particles (vectors).
+ *
+ * Each kernel is implemented for SSE, AVX2 and AVX-512, plus a scalar fallback. The implementation is
+ * selected at runtime depending on the features of the CPU, so the library can be compiled for a generic
+ * x86 target and still use the widest vectors available. Define SDST_NO_SIMD to use the scalar kernels only.
+ *
+ * The random kernels (philox_uniform(), philox_normal()) fill columns of floats from the Philox counter-based
+ * generator, one vector lane per counter. All the implementations give exactly the same numbers.
+ */
+
+#if !defined( SDST_NO_SIMD ) && ( defined( __GNUC__ ) || defined( __clang__ ) ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define SDST_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SDST_SIMD_X86 0
+#endif
+
+namespace sdst
+{
+    namespace kernels
+    {
+        /*
+         * Instruction sets with a kernel implementation, from narrowest to widest.
+         */
+        enum class isa
+        {
+            scalar,
+            sse,
+            avx2,
+            avx512
+        };
+
+        /*
+         * Returns the widest instruction set supported by the CPU.
+         */
+        inline sdst::kernels::isa detect_isa()
+        {
+#if SDST_SIMD_X86
+            __builtin_cpu_init();
+
+            if( __builtin_cpu_supports( "avx512f" ) )
+                return sdst::kernels::isa::avx512;
+            if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+                return sdst::kernels::isa::avx2;
+            if( __builtin_cpu_supports( "sse2" ) )
+                return sdst::kernels::isa::sse;
+#endif
+            return sdst::kernels::isa::scalar;
+        }
+
+        namespace impl
+        {
+            inline std::atomic<int>& isa_storage()
+            {
+                static std::atomic<int> isa{ static_cast<int>( sdst::kernels::detect_isa() ) };
+
+                return isa;
+            }
+        }
+
+        /*
+         * Returns the instruction set used by the kernels.
+         */
+        inline sdst::kernels::isa active_isa()
+        {
+            return static_cast<sdst::kernels::isa>( sdst::kernels::impl::isa_storage().load( std::memory_order_relaxed ) );
+        }
+
+        /*
+         * Limits the instruction set used by the kernels (To benchmark the different implementations,
+         * for example). Instruction sets not supported by the CPU are clamped to the detected one.
+         */
+        inline void set_isa( sdst::kernels::isa isa )
+        {
+            const int detected = static_cast<int>( sdst::kernels::detect_isa() );
+
+            sdst::kernels::impl::isa_storage() = std::min( static_cast<int>( isa ) , detected );
+        }
+
+        /*
+         * Philox4x32-10 (Salmon et al, "Parallel random numbers: As easy as 1, 2, 3"): A keyed bijection of
+         * a 128 bit counter, whose output passes BigCrush. Random numbers are a function of the counter, so
+         * they can be generated in any order and in parallel. See sdst::counter_rng (random.hpp).
+         */
+        namespace philox
+        {
+            constexpr std::uint32_t multiplier_0 = 0xD2511F53;
+            constexpr std::uint32_t multiplier_1 = 0xCD9E8D57;
+            constexpr std::uint32_t weyl_0       = 0x9E3779B9; //Key schedule
+            constexpr std::uint32_t weyl_1       = 0xBB67AE85;
+            constexpr int           rounds       = 10;
+
+            /*
+             * Replaces the counter with its four random words.
+             */
+            inline void block( std::uint32_t counter[4] , std::uint32_t key0 , std::uint32_t key1 )
+            {
+                for( int round = 0 ; round < rounds ; ++round )
+                {
+                    const std::uint64_t p0 = static_cast<std::uint64_t>( multiplier_0 ) * counter[0];
+                    const std::uint64_t p1 = static_cast<std::uint64_t>( multiplier_1 ) * counter[2];
+
+                    counter[0] = static_cast<std::uint32_t>( p1 >> 32 ) ^ counter[1] ^ key0;
+                    counter[1] = static_cast<std::uint32_t>( p1 );
+                    counter[2] = static_cast<std::uint32_t>( p0 >> 32 ) ^ counter[3] ^ key1;
+                    counter[3] = static_cast<std::uint32_t>( p0 );
+
+                    key0 += weyl_0;
+                    key1 += weyl_1;
+                }
+            }
+
+            /*
+             * Maps a random word to a float in [0,1), using its 24 high bits (Exact in single precision,
+             * so the vectorized conversion gives the same floats).
+             */
+            inline float to_unit( std::uint32_t word )
+            {
+                return static_cast<float>( word >> 8 ) * ( 1.0f / 16777216.0f );
+            }
+
+            /*
+             * Box-Muller transform: Turns two floats uniform in [0,1) into two independent standard normal floats.
+             */
+            inline void box_muller( float& a , float& b )
+            {
+                const float radius = std::sqrt( -2.0f * std::log( 1.0f - a ) ); //1 - a is in (0,1]
+                const float angle  = 6.28318530718f * b;
+
+                a = radius * std::cos( angle );
+                b = radius * std::sin( angle );
+            }
+        }
+
+        /*
+         * Scalar kernels. Used when the CPU doesn't support any vector instruction set, and to
+         * process the particles which don't fill a whole vector.
+         */
+        namespace scalar
+        {
+            inline void integrate( float* position , const float* velocity , std::size_t count , float dt )
+            {
+                for( std::size_t i = 0 ; i < 2 * count ; ++i )
+                    position[i] += velocity[i] * dt;
+            }
+
+            inline void accelerate( float* velocity , std::size_t count , float ax , float ay , float dt )
+            {
+                for( std::size_t i = 0 ; i < 2 * count ; i += 2 )
+                {
+                    velocity[i]     += ax * dt;
+                    velocity[i + 1] += ay * dt;
+                }
+            }
+
+            inline void scale( float* velocity , std::size_t count , float factor )
+            {
+                for( std::size_t i = 0 ; i < 2 * count ; ++i )
+                    velocity[i] *= factor;
+            }
+
+            inline void quadratic_drag( float* velocity , std::size_t count , float k , float dt )
+            {
+                //Semi-implicit: v' = v / (1 + k*|v|*dt) is stable for any dt.
+                for( std::size_t i = 0 ; i < 2 * count ; i += 2 )
+                {
+                    const float speed  = std::sqrt( velocity[i] * velocity[i] + velocity[i + 1] * velocity[i + 1] );
+                    const float factor = 1.0f / ( 1.0f + k * dt * speed );
+
+                    velocity[i]     *= factor;
+                    velocity[i + 1] *= factor;
+                }
+            }
+
+            inline void attract( const float* position , float* velocity , std::size_t count , float cx , float cy , float strength , float softening , float dt )
+            {
+                for( std::size_t i = 0 ; i < 2 * count ; i += 2 )
+                {
+                    const float dx = cx - position[i];
+                    const float dy = cy - position[i + 1];
+                    const float r2 = dx * dx + dy * dy + softening * softening;
+                    const float f  = strength * dt / ( r2 * std::sqrt( r2 ) );
+
+                    velocity[i]     += dx * f;
+                    velocity[i + 1] += dy * f;
+                }
+            }
+
+            inline void vortex( const float* position , float* velocity , std::size_t count , float cx , float cy , float strength , float softening , float dt )
+            {
+                for( std::size_t i = 0 ; i < 2 * count ; i += 2 )
+                {
+                    const float dx = position[i]     - cx;
+                    const float dy = position[i + 1] - cy;
+                    const float r2 = dx * dx + dy * dy + softening * softening;
+                    const float f  = strength * dt / r2;
+
+                    velocity[i]     -= dy * f;
+                    velocity[i + 1] += dx * f;
+                }
+            }
+
+            inline void bounce( float* position , float* velocity , std::size_t count , float min_x , float min_y , float max_x , float max_y , float restitution )
+            {
+                const float lo[] = { min_x , min_y };
+                const float hi[] = { max_x , max_y };
+
+                for( std::size_t i = 0 ; i < 2 * count ; ++i )
+                {
+                    const float l = lo[i % 2];
+                    const float h = hi[i % 2];
+
+                    if( position[i] < l )
+                    {
+                        position[i] = 2 * l - position[i];
+                        velocity[i] *= -restitution;
+                    }
+                    else if( h < position[i] )
+                    {
+                        position[i] = 2 * h - position[i];
+                        velocity[i] *= -restitution;
+                    }
+
+                    position[i] = std::max( l , std::min( h , position[i] ) );
+                }
+            }
+
+            inline void wrap( float* position , std::size_t count , float min_x , float min_y , float max_x , float max_y )
+            {
+                const float lo[] = { min_x , min_y };
+                const float hi[] = { max_x , max_y };
+
+                for( std::size_t i = 0 ; i < 2 * count ; ++i )
+                {
+                    const float size = hi[i % 2] - lo[i % 2];
+
+                    if( position[i] < lo[i % 2] )
+                        position[i] += size;
+                    if( !( position[i] < hi[i % 2] ) )
+                        position[i] -= size;
+                }
+            }
+
+            inline void philox_uniform( float* out , std::size_t stride , std::size_t count , std::uint32_t first , std::uint32_t frame , std::uint32_t stream , std::uint32_t key0 , std::uint32_t key1 )
+            {
+                for( std::size_t i = 0 ; i < count ; ++i )
+                {
+                    std::uint32_t counter[] = { first + static_cast<std::uint32_t>( i ) , frame , stream , 0 };
+
+                    sdst::kernels::philox::block( counter , key0 , key1 );
+
+                    for( std::size_t word = 0 ; word < 4 ; ++word )
+                        out[word * stride + i] = sdst::kernels::philox::to_unit( counter[word] );
+                }
+            }
+        }
+
+#if SDST_SIMD_X86
+
+/*
+ * Each instruction set is compiled with the compiler targeting it (Regardless of the -m flags
+ * of the translation unit), and selected at runtime.
+ * 
+ * Note GCC intrinsic headers trigger spurious -Wmaybe-uninitialized warnings when inlined
+ * (The _mm*_undefined_ps() idiom), so they are silenced inside the kernels.
+ */
+#if defined( __clang__ )
+#define SDST_SIMD_TARGET_BEGIN( TARGET ) _Pragma( "clang attribute push (__attribute__((target(" #TARGET "))), apply_to = function)" )
+#define SDST_SIMD_TARGET_END             _Pragma( "clang attribute pop" )
+#else
+#define SDST_SIMD_TARGET_PRAGMA( X )     _Pragma( #X )
+#define SDST_SIMD_TARGET_BEGIN( TARGET ) _Pragma( "GCC push_options" ) SDST_SIMD_TARGET_PRAGMA( GCC target( TARGET ) ) \
+                                         _Pragma( "GCC diagnostic push" ) _Pragma( "GCC diagnostic ignored \"-Wmaybe-uninitialized\"" )
+#define SDST_SIMD_TARGET_END             _Pragma( "GCC diagnostic pop" ) _Pragma( "GCC pop_options" )
+#endif
+
+SDST_SIMD_TARGET_BEGIN( "sse2" )
+        namespace sse
+        {
+            struct ops
+            {
+                using vector_t = __m128;
+                using mask_t   = __m128;
+
+                static const std::size_t width = 4;
+
+                static vector_t load( const float* p )                      { return _mm_loadu_ps( p ); }
+                static void     store( float* p , vector_t v )              { _mm_storeu_ps( p , v ); }
+                static vector_t set1( float x )                             { return _mm_set1_ps( x ); }
+                static vector_t pattern( float x , float y )                { return _mm_setr_ps( x , y , x , y ); }
+                static vector_t add( vector_t a , vector_t b )              { return _mm_add_ps( a , b ); }
+                static vector_t sub( vector_t a , vector_t b )              { return _mm_sub_ps( a , b ); }
+                static vector_t mul( vector_t a , vector_t b )              { return _mm_mul_ps( a , b ); }
+                static vector_t div( vector_t a , vector_t b )              { return _mm_div_ps( a , b ); }
+                static vector_t sqrt( vector_t a )                          { return _mm_sqrt_ps( a ); }
+                static vector_t min( vector_t a , vector_t b )              { return _mm_min_ps( a , b ); }
+                static vector_t max( vector_t a , vector_t b )              { return _mm_max_ps( a , b ); }
+                static vector_t swap_pairs( vector_t a )                    { return _mm_shuffle_ps( a , a , _MM_SHUFFLE( 2 , 3 , 0 , 1 ) ); }
+                static vector_t pair_sum( vector_t a )                      { return _mm_add_ps( a , swap_pairs( a ) ); }
+                static mask_t   lt( vector_t a , vector_t b )               { return _mm_cmplt_ps( a , b ); }
+                static vector_t select( mask_t m , vector_t a , vector_t b ) { return _mm_or_ps( _mm_and_ps( m , a ) , _mm_andnot_ps( m , b ) ); }
+
+                //32 bit integer lanes, for the random kernels:
+                using ivector_t = __m128i;
+
+                static ivector_t iset1( std::uint32_t x )                    { return _mm_set1_epi32( static_cast<int>( x ) ); }
+                static ivector_t lanes()                                     { return _mm_setr_epi32( 0 , 1 , 2 , 3 ); }
+                static ivector_t iadd( ivector_t a , ivector_t b )           { return _mm_add_epi32( a , b ); }
+                static ivector_t ixor( ivector_t a , ivector_t b )           { return _mm_xor_si128( a , b ); }
+                static ivector_t ior( ivector_t a , ivector_t b )            { return _mm_or_si128( a , b ); }
+                static ivector_t mul_even( ivector_t a , ivector_t b )       { return _mm_mul_epu32( a , b ); } //64 bit products of the even lanes
+                static ivector_t shift_up( ivector_t a )                     { return _mm_slli_epi64( a , 32 ); } //Within 64 bit lanes
+                static ivector_t shift_down( ivector_t a )                   { return _mm_srli_epi64( a , 32 ); }
+                static vector_t  to_unit( ivector_t a )                      { return _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( a , 8 ) ) , _mm_set1_ps( 1.0f / 16777216.0f ) ); }
+            };
+
+#include "simd_kernels.inl"
+        }
+SDST_SIMD_TARGET_END
+
+SDST_SIMD_TARGET_BEGIN( "avx2,fma" )
+        namespace avx2
+        {
+            struct ops
+            {
+                using vector_t = __m256;
+                using mask_t   = __m256;
+
+                static const std::size_t width = 8;
+
+                static vector_t load( const float* p )                      { return _mm256_loadu_ps( p ); }
+                static void     store( float* p , vector_t v )              { _mm256_storeu_ps( p , v ); }
+                static vector_t set1( float x )                             { return _mm256_set1_ps( x ); }
+                static vector_t pattern( float x , float y )                { return _mm256_setr_ps( x , y , x , y , x , y , x , y ); }
+                static vector_t add( vector_t a , vector_t b )              { return _mm256_add_ps( a , b ); }
+                static vector_t sub( vector_t a , vector_t b )              { return _mm256_sub_ps( a , b ); }
+                static vector_t mul( vector_t a , vector_t b )              { return _mm256_mul_ps( a , b ); }
+                static vector_t div( vector_t a , vector_t b )              { return _mm256_div_ps( a , b ); }
+                static vector_t sqrt( vector_t a )                          { return _mm256_sqrt_ps( a ); }
+                static vector_t min( vector_t a , vector_t b )              { return _mm256_min_ps( a , b ); }
+                static vector_t max( vector_t a , vector_t b )              { return _mm256_max_ps( a , b ); }
+                static vector_t swap_pairs( vector_t a )                    { return _mm256_permute_ps( a , 0xB1 ); }
+                static vector_t pair_sum( vector_t a )                      { return _mm256_add_ps( a , swap_pairs( a ) ); }
+                static mask_t   lt( vector_t a , vector_t b )               { return _mm256_cmp_ps( a , b , _CMP_LT_OQ ); }
+                static vector_t select( mask_t m , vector_t a , vector_t b ) { return _mm256_blendv_ps( b , a , m ); }
+
+                using ivector_t = __m256i;
+
+                static ivector_t iset1( std::uint32_t x )                    { return _mm256_set1_epi32( static_cast<int>( x ) ); }
+                static ivector_t lanes()                                     { return _mm256_setr_epi32( 0 , 1 , 2 , 3 , 4 , 5 , 6 , 7 ); }
+                static ivector_t iadd( ivector_t a , ivector_t b )           { return _mm256_add_epi32( a , b ); }
+                static ivector_t ixor( ivector_t a , ivector_t b )           { return _mm256_xor_si256( a , b ); }
+                static ivector_t ior( ivector_t a , ivector_t b )            { return _mm256_or_si256( a , b ); }
+                static ivector_t mul_even( ivector_t a , ivector_t b )       { return _mm256_mul_epu32( a , b ); }
+                static ivector_t shift_up( ivector_t a )                     { return _mm256_slli_epi64( a , 32 ); }
+                static ivector_t shift_down( ivector_t a )                   { return _mm256_srli_epi64( a , 32 ); }
+                static vector_t  to_unit( ivector_t a )                      { return _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_srli_epi32( a , 8 ) ) , _mm256_set1_ps( 1.0f / 16777216.0f ) ); }
+            };
+
+#include "simd_kernels.inl"
+        }
+SDST_SIMD_TARGET_END
+
+SDST_SIMD_TARGET_BEGIN( "avx512f" )
+        namespace avx512
+        {
+            struct ops
+            {
+                using vector_t = __m512;
+                using mask_t   = __mmask16;
+
+                static const std::size_t width = 16;
+
+                static vector_t load( const float* p )                      { return _mm512_loadu_ps( p ); }
+                static void     store( float* p , vector_t v )              { _mm512_storeu_ps( p , v ); }
+                static vector_t set1( float x )                             { return _mm512_set1_ps( x ); }
+                static vector_t pattern( float x , float y )                { return _mm512_set_ps( y , x , y , x , y , x , y , x , y , x , y , x , y , x , y , x ); }
+                static vector_t add( vector_t a , vector_t b )              { return _mm512_add_ps( a , b ); }
+                static vector_t sub( vector_t a , vector_t b )              { return _mm512_sub_ps( a , b ); }
+                static vector_t mul( vector_t a , vector_t b )              { return _mm512_mul_ps( a , b ); }
+                static vector_t div( vector_t a , vector_t b )              { return _mm512_div_ps( a , b ); }
+                static vector_t sqrt( vector_t a )                          { return _mm512_sqrt_ps( a ); }
+                static vector_t min( vector_t a , vector_t b )              { return _mm512_min_ps( a , b ); }
+                static vector_t max( vector_t a , vector_t b )              { return _mm512_max_ps( a , b ); }
+                static vector_t swap_pairs( vector_t a )                    { return _mm512_shuffle_ps( a , a , 0xB1 ); }
+                static vector_t pair_sum( vector_t a )                      { return _mm512_add_ps( a , swap_pairs( a ) ); }
+                static mask_t   lt( vector_t a , vector_t b )               { return _mm512_cmp_ps_mask( a , b , _CMP_LT_OQ ); }
+                static vector_t select( mask_t m , vector_t a , vector_t b ) { return _mm512_mask_blend_ps( m , b , a ); }
+
+                using ivector_t = __m512i;
+
+                static ivector_t iset1( std::uint32_t x )                    { return _mm512_set1_epi32( static_cast<int>( x ) ); }
+                static ivector_t lanes()                                     { return _mm512_setr_epi32( 0 , 1 , 2 , 3 , 4 , 5 , 6 , 7 , 8 , 9 , 10 , 11 , 12 , 13 , 14 , 15 ); }
+                static ivector_t iadd( ivector_t a , ivector_t b )           { return _mm512_add_epi32( a , b ); }
+                static ivector_t ixor( ivector_t a , ivector_t b )           { return _mm512_xor_si512( a , b ); }
+                static ivector_t ior( ivector_t a , ivector_t b )            { return _mm512_or_si512( a , b ); }
+                static ivector_t mul_even( ivector_t a , ivector_t b )       { return _mm512_mul_epu32( a , b ); }
+                static ivector_t shift_up( ivector_t a )                     { return _mm512_slli_epi64( a , 32 ); }
+                static ivector_t shift_down( ivector_t a )                   { return _mm512_srli_epi64( a , 32 ); }
+                static vector_t  to_unit( ivector_t a )                      { return _mm512_mul_ps( _mm512_cvtepi32_ps( _mm512_srli_epi32( a , 8 ) ) , _mm512_set1_ps( 1.0f / 16777216.0f ) ); }
+            };
+
+#include "simd_kernels.inl"
+        }
+SDST_SIMD_TARGET_END
+
+#undef SDST_SIMD_TARGET_BEGIN
+#undef SDST_SIMD_TARGET_END
+#undef SDST_SIMD_TARGET_PRAGMA
+
+/*
+ * Calls the implementation of KERNEL for the active instruction set.
+ */
+#define SDST_DISPATCH_KERNEL( KERNEL , ... )                                                     \
+        switch( sdst::kernels::active_isa() )                                                    \
+        {                                                                                        \
+        case sdst::kernels::isa::avx512: sdst::kernels::avx512::KERNEL( __VA_ARGS__ ); break;    \
+        case sdst::kernels::isa::avx2:   sdst::kernels::avx2::KERNEL( __VA_ARGS__ );   break;    \
+        case sdst::kernels::isa::sse:    sdst::kernels::sse::KERNEL( __VA_ARGS__ );    break;    \
+        default:                         sdst::kernels::scalar::KERNEL( __VA_ARGS__ ); break;    \
+        }
+#else
+#define SDST_DISPATCH_KERNEL( KERNEL , ... ) sdst::kernels::scalar::KERNEL( __VA_ARGS__ );
+#endif
+
+        /*
+         * position += velocity * dt
+         */
+        inline void integrate( float* position , const float* velocity , std::size_t count , float dt )
+        {
+            SDST_DISPATCH_KERNEL( integrate , position , velocity , count , dt )
+        }
+
+        /*
+         * velocity += (ax,ay) * dt
+         */
+        inline void accelerate( float* velocity , std::size_t count , float ax , float ay , float dt )
+        {
+            SDST_DISPATCH_KERNEL( accelerate , velocity , count , ax , ay , dt )
+        }
+
+        /*
+         * velocity *= factor
+         */
+        inline void scale( float* velocity , std::size_t count , float factor )
+        {
+            SDST_DISPATCH_KERNEL( scale , velocity , count , factor )
+        }
+
+        /*
+         * Drag proportional to the square of the speed.
+         */
+        inline void quadratic_drag( float* velocity , std::size_t count , float k , float dt )
+        {
+            SDST_DISPATCH_KERNEL( quadratic_drag , velocity , count , k , dt )
+        }
+
+        /*
+         * Inverse-square attraction towards the point (cx,cy). The softening length avoids
+         * the singularity at the center.
+         */
+        inline void attract( const float* position , float* velocity , std::size_t count , float cx , float cy , float strength , float softening , float dt )
+        {
+            SDST_DISPATCH_KERNEL( attract , position , velocity , count , cx , cy , strength , softening , dt )
+        }
+
+        /*
+         * Tangential acceleration around the point (cx,cy), counter-clockwise for positive strengths.
+         */
+        inline void vortex( const float* position , float* velocity , std::size_t count , float cx , float cy , float strength , float softening , float dt )
+        {
+            SDST_DISPATCH_KERNEL( vortex , position , velocity , count , cx , cy , strength , softening , dt )
+        }
+
+        /*
+         * Reflects the particles which left the box, scaling their velocity by the restitution.
+         */
+        inline void bounce( float* position , float* velocity , std::size_t count , float min_x , float min_y , float max_x , float max_y , float restitution )
+        {
+            SDST_DISPATCH_KERNEL( bounce , position , velocity , count , min_x , min_y , max_x , max_y , restitution )
+        }
+
+        /*
+         * Moves the particles which left the box to the opposite side (Periodic boundaries).
+         */
+        inline void wrap( float* position , std::size_t count , float min_x , float min_y , float max_x , float max_y )
+        {
+            SDST_DISPATCH_KERNEL( wrap , position , count , min_x , min_y , max_x , max_y )
+        }
+
+        /*
+         * Philox4x32-10 random floats in [0,1), for the counters (first + i , frame , stream , 0) with i in [0,count)
+         * and the key (key0,key1). The four words of the counter i go to out[i], out[stride + i], out[2*stride + i]
+         * and out[3*stride + i] (Four columns of 'stride' floats).
+         */
+        inline void philox_uniform( float* out , std::size_t stride , std::size_t count , std::uint32_t first , std::uint32_t frame , std::uint32_t stream , std::uint32_t key0 , std::uint32_t key1 )
+        {
+            SDST_DISPATCH_KERNEL( philox_uniform , out , stride , count , first , frame , stream , key0 , key1 )
+        }
+
+        /*
+         * As philox_uniform(), but standard normal floats. The words 0,1 and 2,3 of each counter are paired
+         * through the Box-Muller transform, which is scalar (There are no vector log/sin/cos to dispatch to).
+         */
+        inline void philox_normal( float* out , std::size_t stride , std::size_t count , std::uint32_t first , std::uint32_t frame , std::uint32_t stream , std::uint32_t key0 , std::uint32_t key1 )
+        {
+            sdst::kernels::philox_uniform( out , stride , count , first , frame , stream , key0 , key1 );
+
+            for( std::size_t word = 0 ; word < 4 ; word += 2 )
+            {
+                float* a = out + word * stride;
+                float* b = a + stride;
+
+                for( std::size_t i = 0 ; i < count ; ++i )
+                    sdst::kernels::philox::box_muller( a[i] , b[i] );
+            }
+        }
+
+#undef SDST_DISPATCH_KERNEL
+    }
+}
+
+#endif	/* SIMD_KERNELS_HPP */
@@ -0,0 +1,226 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+/*
+ * Vectorized kernel bodies, written once for all the instruction sets.
+ *
+ * This file is included by simd_kernels.hpp once per instruction set, inside a namespace
+ * which defines the 'ops' vector abstraction (Width, loads, arithmetic, etc) and with the
+ * compiler targeting that instruction set. Don't include it directly.
+ *
+ * Columns are interleaved 2D vectors (x0,y0,x1,y1,...) and the width of a vector is always
+ * even, so each vector holds whole particles. The particles which don't fill a vector are
+ * processed by the scalar kernels.
+ */
+
+inline std::size_t vectorized_floats( std::size_t count )
+{
+    return ( 2 * count ) - ( 2 * count ) % ops::width;
+}
+
+inline void integrate( float* position , const float* velocity , std::size_t count , float dt )
+{
+    const std::size_t floats = vectorized_floats( count );
+    const ops::vector_t vdt  = ops::set1( dt );
+
+    for( std::size_t i = 0 ; i < floats ; i += ops::width )
+        ops::store( position + i , ops::add( ops::load( position + i ) , ops::mul( ops::load( velocity + i ) , vdt ) ) );
+
+    sdst::kernels::scalar::integrate( position + floats , velocity + floats , count - floats / 2 , dt );
+}
+
+inline void accelerate( float* velocity , std::size_t count , float ax , float ay , float dt )
+{
+    const std::size_t floats = vectorized_floats( count );
+    const ops::vector_t dv   = ops::pattern( ax * dt , ay * dt );
+
+    for( std::size_t i = 0 ; i < floats ; i += ops::width )
+        ops::store( velocity + i , ops::add( ops::load( velocity + i ) , dv ) );
+
+    sdst::kernels::scalar::accelerate( velocity + floats , count - floats / 2 , ax , ay , dt );
+}
+
+inline void scale( float* velocity , std::size_t count , float factor )
+{
+    const std::size_t floats = vectorized_floats( count );
+    const ops::vector_t vf   = ops::set1( factor );
+
+    for( std::size_t i = 0 ; i < floats ; i += ops::width )
+        ops::store( velocity + i , ops::mul( ops::load( velocity + i ) , vf ) );
+
+    sdst::kernels::scalar::scale( velocity + floats , count - floats / 2 , factor );
+}
+
+inline void quadratic_drag( float* velocity , std::size_t count , float k , float dt )
+{
+    const std::size_t floats = vectorized_floats( count );
+    const ops::vector_t kdt  = ops::set1( k * dt );
+    const ops::vector_t one  = ops::set1( 1.0f );
+
+    for( std::size_t i = 0 ; i < floats ; i += ops::width )
+    {
+        const ops::vector_t v     = ops::load( velocity + i );
+        const ops::vector_t speed = ops::sqrt( ops::pair_sum( ops::mul( v , v ) ) );
+
+        ops::store( velocity + i , ops::div( v , ops::add( one , ops::mul( kdt , speed ) ) ) );
+    }
+
+    sdst::kernels::scalar::quadratic_drag( velocity + floats , count - floats / 2 , k , dt );
+}
+
+inline void attract( const float* position , float* velocity , std::size_t count , float cx , float cy , float strength , float softening , float dt )
+{
+    const std::size_t floats = vectorized_floats( count );
+    const ops::vector_t c    = ops::pattern( cx , cy );
+    const ops::vector_t eps  = ops::set1( softening * softening );
+    const ops::vector_t sdt  = ops::set1( strength * dt );
+
+    for( std::size_t i = 0 ; i < floats ; i += ops::width )
+    {
+        const ops::vector_t d  = ops::sub( c , ops::load( position + i ) );
+        const ops::vector_t r2 = ops::add( ops::pair_sum( ops::mul( d , d ) ) , eps );
+        const ops::vector_t f  = ops::div( sdt , ops::mul( r2 , ops::sqrt( r2 ) ) );
+
+        ops::store( velocity + i , ops::add( ops::load( velocity + i ) , ops::mul( d , f ) ) );
+    }
+
+    sdst::kernels::scalar::attract( position + floats , velocity + floats , count - floats / 2 , cx , cy , strength , softening , dt );
+}
+
+inline void vortex( const float* position , float* velocity , std::size_t count , float cx , float cy , float strength , float softening , float dt )
+{
+    const std::size_t floats = vectorized_floats( count );
+    const ops::vector_t c    = ops::pattern( cx , cy );
+    const ops::vector_t eps  = ops::set1( softening * softening );
+    const ops::vector_t sdt  = ops::set1( strength * dt );
+    const ops::vector_t sign = ops::pattern( -1.0f , 1.0f );
+
+    for( std::size_t i = 0 ; i < floats ; i += ops::width )
+    {
+        const ops::vector_t d    = ops::sub( ops::load( position + i ) , c );
+        const ops::vector_t r2   = ops::add( ops::pair_sum( ops::mul( d , d ) ) , eps );
+        const ops::vector_t perp = ops::mul( ops::swap_pairs( d ) , sign ); //(-dy,dx)
+
+        ops::store( velocity + i , ops::add( ops::load( velocity + i ) , ops::mul( perp , ops::div( sdt , r2 ) ) ) );
+    }
+
+    sdst::kernels::scalar::vortex( position + floats , velocity + floats , count - floats / 2 , cx , cy , strength , softening , dt );
+}
+
+inline void bounce( float* position , float* velocity , std::size_t count , float min_x , float min_y , float max_x , float max_y , float restitution )
+{
+    const std::size_t floats = vectorized_floats( count );
+    const ops::vector_t lo   = ops::pattern( min_x , min_y );
+    const ops::vector_t hi   = ops::pattern( max_x , max_y );
+    const ops::vector_t lo2  = ops::add( lo , lo );
+    const ops::vector_t hi2  = ops::add( hi , hi );
+    const ops::vector_t r    = ops::set1( -restitution );
+
+    for( std::size_t i = 0 ; i < floats ; i += ops::width )
+    {
+        ops::vector_t p = ops::load( position + i );
+        ops::vector_t v = ops::load( velocity + i );
+
+        const ops::mask_t below = ops::lt( p , lo );
+        const ops::mask_t above = ops::lt( hi , p );
+
+        p = ops::select( below , ops::sub( lo2 , p ) , p );
+        p = ops::select( above , ops::sub( hi2 , p ) , p );
+        v = ops::select( below , ops::mul( v , r ) , v );
+        v = ops::select( above , ops::mul( v , r ) , v );
+
+        ops::store( position + i , ops::max( lo , ops::min( hi , p ) ) );
+        ops::store( velocity + i , v );
+    }
+
+    sdst::kernels::scalar::bounce( position + floats , velocity + floats , count - floats / 2 , min_x , min_y , max_x , max_y , restitution );
+}
+
+inline void wrap( float* position , std::size_t count , float min_x , float min_y , float max_x , float max_y )
+{
+    const std::size_t floats = vectorized_floats( count );
+    const ops::vector_t lo   = ops::pattern( min_x , min_y );
+    const ops::vector_t hi   = ops::pattern( max_x , max_y );
+    const ops::vector_t size = ops::sub( hi , lo );
+
+    for( std::size_t i = 0 ; i < floats ; i += ops::width )
+    {
+        ops::vector_t p = ops::load( position + i );
+
+        p = ops::select( ops::lt( p , lo ) , ops::add( p , size ) , p );
+        p = ops::select( ops::lt( p , hi ) , p , ops::sub( p , size ) );
+
+        ops::store( position + i , p );
+    }
+
+    sdst::kernels::scalar::wrap( position + floats , count - floats / 2 , min_x , min_y , max_x , max_y );
+}
+
+/*
+ * Philox rounds on ops::width counters at once, one per lane. The 32x32->64 bit multiplications
+ * are done on the even lanes and on the odd lanes (Shifted down) separately, and their halves merged.
+ */
+inline void philox_mulhilo( ops::ivector_t a , ops::ivector_t m , ops::ivector_t& hi , ops::ivector_t& lo )
+{
+    const ops::ivector_t even = ops::mul_even( a , m );
+    const ops::ivector_t odd  = ops::mul_even( ops::shift_down( a ) , m );
+
+    lo = ops::ior( ops::shift_down( ops::shift_up( even ) ) , ops::shift_up( odd ) );
+    hi = ops::ior( ops::shift_down( even ) , ops::shift_up( ops::shift_down( odd ) ) );
+}
+
+inline void philox_uniform( float* out , std::size_t stride , std::size_t count , std::uint32_t first , std::uint32_t frame , std::uint32_t stream , std::uint32_t key0 , std::uint32_t key1 )
+{
+    const std::size_t vectorized = count - count % ops::width;
+    const ops::ivector_t m0      = ops::iset1( sdst::kernels::philox::multiplier_0 );
+    const ops::ivector_t m1      = ops::iset1( sdst::kernels::philox::multiplier_1 );
+
+    for( std::size_t i = 0 ; i < vectorized ; i += ops::width )
+    {
+        ops::ivector_t c0 = ops::iadd( ops::iset1( first + static_cast<std::uint32_t>( i ) ) , ops::lanes() );
+        ops::ivector_t c1 = ops::iset1( frame );
+        ops::ivector_t c2 = ops::iset1( stream );
+        ops::ivector_t c3 = ops::iset1( 0 );
+
+        std::uint32_t k0 = key0 , k1 = key1;
+
+        for( int round = 0 ; round < sdst::kernels::philox::rounds ; ++round )
+        {
+            ops::ivector_t hi0 , lo0 , hi1 , lo1;
+
+            philox_mulhilo( c0 , m0 , hi0 , lo0 );
+            philox_mulhilo( c2 , m1 , hi1 , lo1 );
+
+            c0 = ops::ixor( ops::ixor( hi1 , c1 ) , ops::iset1( k0 ) );
+            c1 = lo1;
+            c2 = ops::ixor( ops::ixor( hi0 , c3 ) , ops::iset1( k1 ) );
+            c3 = lo0;
+
+            k0 += sdst::kernels::philox::weyl_0;
+            k1 += sdst::kernels::philox::weyl_1;
+        }
+
+        ops::store( out + i              , ops::to_unit( c0 ) );
+        ops::store( out + stride + i     , ops::to_unit( c1 ) );
+        ops::store( out + 2 * stride + i , ops::to_unit( c2 ) );
+        ops::store( out + 3 * stride + i , ops::to_unit( c3 ) );
+    }
+
+    sdst::kernels::scalar::philox_uniform( out + vectorized , stride , count - vectorized , first + static_cast<std::uint32_t>( vectorized ) , frame , stream , key0 , key1 );
+}
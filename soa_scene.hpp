@@ -0,0 +1,495 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef SOA_SCENE_HPP
+#define	SOA_SCENE_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "batch_policies.hpp"
+#include "field.hpp"
+#include "proxy_iterator.hpp"
+#include "stated_policies.hpp"
+
+/*
+ * A structure-of-arrays scene stores each field of the particle data in its own contiguous
+ * column instead of storing whole particles next to each other. A policy which only
+ * touches the position of the particles only loads the position column, instead of
+ * dragging the color, the texture coordinates, etc, through the cache.
+ *
+ * Since particles are not stored anywhere, the scene is traversed through proxies: Iterators
+ * give access to a sdst::soa_particle, a reference-like object which has the same interface as
+ * sdst::particle (update(), draw(), data()), so engines and run_while_all()-like predicates written
+ * against begin()/end() keep working.
+ *
+ * The evolution and draw policies of a SoA scene are shared by all its particles, and are stored once
+ * in the scene. Each policy is called with the proxy itself if it supports that signature, so it can
+ * access only the columns it needs through get<FIELD>():
+ *
+ *     using position = SDST_FIELD( sf::Vertex , position );
+ *
+ *     struct fall
+ *     {
+ *         template<typename SCENE>
+ *         void operator()( const sdst::soa_particle<SCENE>& particle ) const
+ *         {
+ *             particle.template get<position>().y += 1.0f;
+ *         }
+ *     };
+ *
+ * (Note the proxy type is spelled out. An unconstrained template would be regarded as a stated policy too, since
+ * it accepts a sdst::state_change).
+ *
+ * Policies written for the particle data (void(DATA&)) work too, but the proxy has to gather the data
+ * from the columns before the call and scatter it back after, so they don't get any bandwidth benefit.
+ * Only the fields specified in the scene are stored, the rest of the data is value-initialized when
+ * gathered.
+ *
+ * If the evolution policy supports the batch signature void(const sdst::soa_particle<SCENE>&,std::size_t)
+ * (See batch_policies.hpp) the engine hands it whole blocks of particles through update(first,count). The
+ * policy reaches the contiguous columns of the block through column<FIELD>() of the first particle.
+ *
+ * Note that the policies are shared, so if the scene is updated in parallel they are called concurrently.
+ */
+
+namespace sdst
+{
+    template<typename SCENE>
+    struct soa_particle;
+
+    /*
+     * Random access iterator over the particles of a SoA scene.
+     */
+    template<typename SCENE>
+    using soa_iterator = sdst::proxy_iterator<sdst::soa_particle<SCENE>,SCENE>;
+
+    template<typename DATA , typename EVOLUTION_POLICY , typename DRAW_POLICY , typename... FIELDS>
+    struct soa_scene
+    {
+        static_assert( sizeof...(FIELDS) > 0 , "A SoA scene should store at least one field" );
+
+    public:
+        /*
+         * The type which holds the data of a particle
+         */
+        using data_t = DATA;
+
+        /*
+         * The type of the particle evolution policy
+         */
+        using evolution_policy_t = typename std::decay<EVOLUTION_POLICY>::type;
+
+        /*
+         * The type of the particle drawing policy
+         */
+        using drawing_policy_t = typename std::decay<DRAW_POLICY>::type;
+
+        /*
+         * The type of the scene
+         */
+        using scene_t = soa_scene;
+
+        /*
+         * The type of the proxies representing the particles of the scene.
+         */
+        using particle_t       = sdst::soa_particle<soa_scene>;
+        using const_particle_t = sdst::soa_particle<const soa_scene>;
+
+        using iterator       = sdst::soa_iterator<soa_scene>;
+        using const_iterator = sdst::soa_iterator<const soa_scene>;
+
+
+        /*
+         * Initializes an empty scene given the evolution and drawing policies of its particles.
+         */
+        soa_scene( const evolution_policy_t& evolution_policy = evolution_policy_t{} , const drawing_policy_t& drawing_policy = drawing_policy_t{} ) :
+            _evolution_policy{ evolution_policy },
+            _draw_policy{ drawing_policy }
+        {}
+
+        /*
+         * Adds a particle to the scene, splitting its data across the columns.
+         */
+        void push_back( const data_t& data )
+        {
+            using swallow = int[];
+            (void)swallow{ 0 , ( column<FIELDS>().push_back( FIELDS::get( data ) ) , 0 )... };
+        }
+
+        void reserve( std::size_t capacity )
+        {
+            using swallow = int[];
+            (void)swallow{ 0 , ( column<FIELDS>().reserve( capacity ) , 0 )... };
+        }
+
+        void resize( std::size_t size )
+        {
+            using swallow = int[];
+            (void)swallow{ 0 , ( column<FIELDS>().resize( size ) , 0 )... };
+        }
+
+        void clear()
+        {
+            using swallow = int[];
+            (void)swallow{ 0 , ( column<FIELDS>().clear() , 0 )... };
+        }
+
+        std::size_t size() const
+        {
+            return std::get<0>( _columns ).size();
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+
+        iterator begin()
+        {
+            return { this , 0 };
+        }
+
+        iterator end()
+        {
+            return { this , size() };
+        }
+
+        const_iterator begin() const
+        {
+            return { this , 0 };
+        }
+
+        const_iterator end() const
+        {
+            return { this , size() };
+        }
+
+        particle_t operator[]( std::size_t index )
+        {
+            return { this , index };
+        }
+
+        const_particle_t operator[]( std::size_t index ) const
+        {
+            return { this , index };
+        }
+
+
+        /*
+         * Gives access to the column where the specified field of the particles is stored.
+         */
+        template<typename FIELD>
+        std::vector<typename FIELD::value_t>& column()
+        {
+            return std::get<sdst::impl::index_of<FIELD,FIELDS...>::value>( _columns );
+        }
+
+        /*
+         * Gives readonly access to the column where the specified field of the particles is stored.
+         */
+        template<typename FIELD>
+        const std::vector<typename FIELD::value_t>& column() const
+        {
+            return std::get<sdst::impl::index_of<FIELD,FIELDS...>::value>( _columns );
+        }
+
+        /*
+         * Updates the particles in the range [first,first + count). If the evolution policy supports
+         * the batch signature the whole block is evolved in one call, else each particle is evolved
+         * as with evolve() of its proxy. Then the local update requests of the block are sent to the
+         * policies at once (See sdst::local_updates).
+         */
+        void update( std::size_t first , std::size_t count )
+        {
+            evolve( first , count );
+            request_local_updates( count );
+        }
+
+        /*
+         * Evolves the particles in the range [first,first + count), without sending their local
+         * update requests. For engines which send them later (See sdst::pipelined_engine).
+         */
+        void evolve( std::size_t first , std::size_t count )
+        {
+            evolve_block<evolution_policy_t>::execute( *this , first , count );
+        }
+
+        /*
+         * Sends the local update requests of 'count' particles to the policies at once.
+         */
+        void request_local_updates( std::size_t count )
+        {
+            _evolution_policy( sdst::local_updates{ count } );
+            _draw_policy( sdst::local_updates{ count } );
+        }
+
+        /*
+         * Reads the data of the index-th particle from the columns.
+         */
+        data_t gather( std::size_t index ) const
+        {
+            data_t data{};
+
+            using swallow = int[];
+            (void)swallow{ 0 , ( FIELDS::get( data ) = column<FIELDS>()[index] , 0 )... };
+
+            return data;
+        }
+
+        /*
+         * Writes the data of the index-th particle into the columns.
+         */
+        void scatter( std::size_t index , const data_t& data )
+        {
+            using swallow = int[];
+            (void)swallow{ 0 , ( column<FIELDS>()[index] = FIELDS::get( data ) , 0 )... };
+        }
+
+
+        /*
+         * Gives access to the evolution policy shared by all the particles.
+         */
+        sdst::erase_state<evolution_policy_t>& evolution_policy()
+        {
+            return _evolution_policy;
+        }
+
+        const sdst::erase_state<evolution_policy_t>& evolution_policy() const
+        {
+            return _evolution_policy;
+        }
+
+        /*
+         * Gives access to the drawing policy shared by all the particles.
+         */
+        sdst::erase_state<drawing_policy_t>& drawing_policy()
+        {
+            return _draw_policy;
+        }
+
+        const sdst::erase_state<drawing_policy_t>& drawing_policy() const
+        {
+            return _draw_policy;
+        }
+
+    private:
+        /*
+         * Block evolution. This specialization is rejected if the evolution
+         * policy doesn't support the batch signature.
+         */
+        template<typename P , typename IS_BATCH = sdst::is_batch_policy<P,const particle_t&>>
+        struct evolve_block
+        {
+            static void execute( soa_scene& scene , std::size_t first , std::size_t count )
+            {
+                scene._evolution_policy( scene[first] , count );
+            }
+        };
+
+        /*
+         * Block evolution. This specialization is rejected if the evolution
+         * policy supports the batch signature.
+         */
+        template<typename P>
+        struct evolve_block<P,tml::false_type>
+        {
+            static void execute( soa_scene& scene , std::size_t first , std::size_t count )
+            {
+                for( std::size_t i = first ; i < first + count ; ++i )
+                    scene[i].evolve();
+            }
+        };
+
+        std::tuple<std::vector<typename FIELDS::value_t>...> _columns;
+        sdst::erase_state<evolution_policy_t>                _evolution_policy;
+        sdst::erase_state<drawing_policy_t>                  _draw_policy;
+    };
+
+    /*
+     * A reference to a particle of a SoA scene. SCENE is const-qualified for readonly proxies.
+     */
+    template<typename SCENE>
+    struct soa_particle
+    {
+    public:
+        using scene_t = typename std::remove_const<SCENE>::type;
+        using data_t  = typename scene_t::data_t;
+
+        soa_particle( SCENE* scene = nullptr , std::size_t index = 0 ) :
+            _scene{ scene },
+            _index{ index }
+        {}
+
+        /*
+         * Gives access to a field of the particle, directly in its column.
+         */
+        template<typename FIELD>
+        auto get() const -> decltype( std::declval<SCENE&>().template column<FIELD>()[0] )
+        {
+            return _scene->template column<FIELD>()[_index];
+        }
+
+        /*
+         * Gives access to the column of the specified field, starting at this particle.
+         */
+        template<typename FIELD>
+        auto column() const -> decltype( &std::declval<SCENE&>().template column<FIELD>()[0] )
+        {
+            return _scene->template column<FIELD>().data() + _index;
+        }
+
+        /*
+         * Updates the particle: Calls the evolution policy and then sends a local update
+         * request to the policies.
+         */
+        void update() const
+        {
+            evolve();
+
+            _scene->evolution_policy()( sdst::state_change::local );
+            _scene->drawing_policy()( sdst::state_change::local );
+        }
+
+        /*
+         * Calls the evolution policy only, without the local update requests (The scene
+         * sends them for whole blocks, see soa_scene::update()).
+         */
+        void evolve() const
+        {
+            evolution_call<typename scene_t::evolution_policy_t>::execute( *this );
+        }
+
+        /*
+         * Draws the particle
+         */
+        void draw() const
+        {
+            render<typename scene_t::drawing_policy_t>::execute( *this );
+        }
+
+        /*
+         * Gathers the data of the particle
+         */
+        data_t data() const
+        {
+            return _scene->gather( _index );
+        }
+
+        operator data_t() const
+        {
+            return data();
+        }
+
+        /*
+         * Assigning particle data writes it into the columns (The proxy is not rebound).
+         */
+        const soa_particle& operator=( const data_t& data ) const
+        {
+            _scene->scatter( _index , data );
+
+            return *this;
+        }
+
+        /*
+         * Returns the index of the particle in the scene.
+         */
+        std::size_t index() const
+        {
+            return _index;
+        }
+
+        /*
+         * Returns the scene the particle belongs to.
+         */
+        SCENE* scene() const
+        {
+            return _scene;
+        }
+
+    private:
+        /*
+         * Calls the policy with the proxy if the policy supports it, else through the data.
+         *
+         * This specialization is rejected if the policy doesn't accept proxies.
+         */
+        template<typename P , typename ACCEPTS_PROXY = tml::is_valid_call<P,const soa_particle&>>
+        struct evolution_call
+        {
+            static void execute( const soa_particle& particle )
+            {
+                particle._scene->evolution_policy()( particle );
+            }
+        };
+
+        template<typename P>
+        struct evolution_call<P,tml::false_type>
+        {
+            static void execute( const soa_particle& particle )
+            {
+                data_t data = particle.data();
+
+                particle._scene->evolution_policy()( data );
+                particle._scene->scatter( particle._index , data );
+            }
+        };
+
+        template<typename P , typename ACCEPTS_PROXY = tml::is_valid_call<P,const soa_particle&>>
+        struct render
+        {
+            static void execute( const soa_particle& particle )
+            {
+                particle._scene->drawing_policy()( particle );
+            }
+        };
+
+        template<typename P>
+        struct render<P,tml::false_type>
+        {
+            static void execute( const soa_particle& particle )
+            {
+                data_t data = particle.data();
+
+                particle._scene->drawing_policy()( data );
+            }
+        };
+
+        SCENE*      _scene;
+        std::size_t _index;
+    };
+
+    /*
+     * Type-deduction-based builder for SoA scenes. The particle data type is taken from the fields:
+     *
+     *     auto scene = sdst::make_soa_scene<position,color>( evolution{} , draw{} );
+     */
+    template<typename FIELD , typename... FIELDS , typename EVOLUTION_POLICY , typename DRAW_POLICY>
+    sdst::soa_scene<typename FIELD::data_t,typename std::decay<EVOLUTION_POLICY>::type,typename std::decay<DRAW_POLICY>::type,FIELD,FIELDS...>
+    make_soa_scene( EVOLUTION_POLICY&& evolution_policy , DRAW_POLICY&& draw_policy )
+    {
+        return { std::forward<EVOLUTION_POLICY>( evolution_policy ) , std::forward<DRAW_POLICY>( draw_policy ) };
+    }
+}
+
+#endif	/* SOA_SCENE_HPP */
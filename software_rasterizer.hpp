@@ -0,0 +1,540 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef SOFTWARE_RASTERIZER_HPP
+#define	SOFTWARE_RASTERIZER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "execution_policies.hpp"
+#include "vertex_buffer_drawing.hpp"
+
+/*
+ * A headless renderer: Rasterizes points and lines into an in-memory RGBA framebuffer, so the draw
+ * side of the engines can be run and measured without a display (On a build server, for example).
+ *
+ * The framebuffer is split in square tiles. Each batch of primitives is first binned to the tiles
+ * it touches, and then the tiles are rasterized in parallel through an execution policy. Each tile
+ * draws its primitives in submission order, so the result doesn't depend on the number of threads.
+ *
+ * The rasterizer is a submission function void(const raster_vertex*,std::size_t) (See trails.hpp),
+ * and sdst::raster_drawing is a scene drawing policy which draws the particles as points:
+ *
+ *     sdst::software_rasterizer<sdst::parallel_execution> rasterizer{ 1920 , 1080 , sdst::parallel_execution{ pool } };
+ *
+ *     auto engine = sdst::make_basic_manual_engine( scene , sdst::make_raster_drawing( rasterizer ) );
+ *
+ *     engine.draw();
+ *     const sdst::framebuffer& image = rasterizer.framebuffer();
+ */
+
+namespace sdst
+{
+    /*
+     * An 8-bit per channel RGBA color.
+     */
+    struct rgba
+    {
+        std::uint8_t r , g , b , a;
+    };
+
+    inline bool operator==( const sdst::rgba& lhs , const sdst::rgba& rhs )
+    {
+        return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a;
+    }
+
+    inline bool operator!=( const sdst::rgba& lhs , const sdst::rgba& rhs )
+    {
+        return !( lhs == rhs );
+    }
+
+    /*
+     * A vertex of the software rasterizer: Its position in pixels and its color.
+     */
+    struct raster_vertex
+    {
+        float      x , y;
+        sdst::rgba color;
+    };
+
+    /*
+     * How the primitives are combined with the framebuffer:
+     *
+     *  - alpha:    dst = src * src.a + dst * (1 - src.a)
+     *  - additive: dst = dst + src * src.a (Saturated)
+     */
+    enum class blend_mode
+    {
+        alpha,
+        additive
+    };
+
+    /*
+     * How the vertices submitted are assembled: Each vertex a point, or each two vertices a line
+     * (As sf::Points and sf::Lines).
+     */
+    enum class primitive_type
+    {
+        points,
+        lines
+    };
+
+    /*
+     * A row-major RGBA image.
+     */
+    struct framebuffer
+    {
+    public:
+        framebuffer( std::size_t width , std::size_t height ) :
+            _width{ width },
+            _height{ height },
+            _pixels( width * height )
+        {}
+
+        void clear( const sdst::rgba& color )
+        {
+            std::fill( _pixels.begin() , _pixels.end() , color );
+        }
+
+        sdst::rgba& operator()( std::size_t x , std::size_t y )
+        {
+            return _pixels[y * _width + x];
+        }
+
+        const sdst::rgba& operator()( std::size_t x , std::size_t y ) const
+        {
+            return _pixels[y * _width + x];
+        }
+
+        sdst::rgba* data()
+        {
+            return _pixels.data();
+        }
+
+        const sdst::rgba* data() const
+        {
+            return _pixels.data();
+        }
+
+        std::size_t width() const
+        {
+            return _width;
+        }
+
+        std::size_t height() const
+        {
+            return _height;
+        }
+
+    private:
+        std::size_t             _width , _height;
+        std::vector<sdst::rgba> _pixels;
+    };
+
+    namespace impl
+    {
+        inline std::uint8_t blend_channel( std::uint8_t dst , std::uint8_t src , std::uint8_t alpha , sdst::blend_mode mode )
+        {
+            if( mode == sdst::blend_mode::additive )
+                return static_cast<std::uint8_t>( std::min( 255u , dst + ( src * alpha + 127u ) / 255u ) );
+            else
+                return static_cast<std::uint8_t>( ( src * alpha + dst * ( 255u - alpha ) + 127u ) / 255u );
+        }
+
+        inline void blend( sdst::rgba& dst , const sdst::rgba& src , sdst::blend_mode mode )
+        {
+            dst.r = sdst::impl::blend_channel( dst.r , src.r , src.a , mode );
+            dst.g = sdst::impl::blend_channel( dst.g , src.g , src.a , mode );
+            dst.b = sdst::impl::blend_channel( dst.b , src.b , src.a , mode );
+            dst.a = sdst::impl::blend_channel( dst.a , 255   , src.a , mode );
+        }
+
+        inline sdst::rgba lerp( const sdst::rgba& from , const sdst::rgba& to , float t )
+        {
+            return { static_cast<std::uint8_t>( from.r + ( to.r - from.r ) * t + 0.5f ) ,
+                     static_cast<std::uint8_t>( from.g + ( to.g - from.g ) * t + 0.5f ) ,
+                     static_cast<std::uint8_t>( from.b + ( to.b - from.b ) * t + 0.5f ) ,
+                     static_cast<std::uint8_t>( from.a + ( to.a - from.a ) * t + 0.5f ) };
+        }
+    }
+
+    template<typename EXECUTION_POLICY = sdst::sequential_execution>
+    struct software_rasterizer
+    {
+    public:
+        using execution_policy_t = EXECUTION_POLICY;
+
+        /*
+         * Side of the tiles, in pixels.
+         */
+        static constexpr std::size_t tile_size = 64;
+
+        software_rasterizer( std::size_t width , std::size_t height , const execution_policy_t& execution_policy = execution_policy_t{} ) :
+            _framebuffer{ width , height },
+            _execution_policy{ execution_policy },
+            _tiles_x{ ( width + tile_size - 1 ) / tile_size },
+            _tiles_y{ ( height + tile_size - 1 ) / tile_size },
+            _blending{ sdst::blend_mode::alpha },
+            _primitive{ sdst::primitive_type::points },
+            _clear_color( sdst::rgba{ 0 , 0 , 0 , 255 } )
+        {}
+
+        /*
+         * Sets how the next primitives are blended (Alpha blending by default).
+         */
+        software_rasterizer& blending( sdst::blend_mode mode )
+        {
+            _blending = mode;
+
+            return *this;
+        }
+
+        /*
+         * Sets how the next vertices submitted are assembled (Points by default).
+         */
+        software_rasterizer& primitive( sdst::primitive_type primitive )
+        {
+            _primitive = primitive;
+
+            return *this;
+        }
+
+        /*
+         * Sets the color the framebuffer is cleared to (Opaque black by default).
+         */
+        software_rasterizer& clear_color( const sdst::rgba& color )
+        {
+            _clear_color = color;
+
+            return *this;
+        }
+
+        void clear()
+        {
+            _framebuffer.clear( _clear_color );
+        }
+
+        /*
+         * Rasterizes a batch of vertices, assembled as the current primitive type.
+         */
+        void draw( const sdst::raster_vertex* vertices , std::size_t count )
+        {
+            const std::size_t primitives = _primitive == sdst::primitive_type::points ? count : count / 2;
+            const std::size_t tiles      = _tiles_x * _tiles_y;
+
+            if( primitives == 0 || tiles == 0 )
+                return;
+
+            const std::size_t blocks = std::max<std::size_t>( std::min( ( primitives + block_size - 1 ) / block_size , max_blocks ) , 1 );
+
+            _counts.assign( blocks * tiles , 0 );
+
+            //Count the primitives of each block falling on each tile:
+            _execution_policy.for_each_range( 0 , blocks , 1 , [&]( std::size_t first_block , std::size_t last_block )
+            {
+                for( std::size_t b = first_block ; b < last_block ; ++b )
+                {
+                    std::uint32_t* counts = _counts.data() + b * tiles;
+
+                    for( std::size_t p = b * primitives / blocks ; p < ( b + 1 ) * primitives / blocks ; ++p )
+                        for_each_tile( vertices , p , [counts]( std::size_t tile ){ ++counts[tile]; } );
+                }
+            });
+
+            //Exclusive scan, tile-major, so the primitives of each tile stay in submission order:
+            _starts.resize( tiles + 1 );
+
+            std::uint32_t start = 0;
+
+            for( std::size_t t = 0 ; t < tiles ; ++t )
+            {
+                _starts[t] = start;
+
+                for( std::size_t b = 0 ; b < blocks ; ++b )
+                {
+                    const std::uint32_t count = _counts[b * tiles + t];
+
+                    _counts[b * tiles + t] = start;
+                    start += count;
+                }
+            }
+
+            _starts[tiles] = start;
+            _bins.resize( start );
+
+            _execution_policy.for_each_range( 0 , blocks , 1 , [&]( std::size_t first_block , std::size_t last_block )
+            {
+                for( std::size_t b = first_block ; b < last_block ; ++b )
+                {
+                    std::uint32_t* cursors = _counts.data() + b * tiles;
+
+                    for( std::size_t p = b * primitives / blocks ; p < ( b + 1 ) * primitives / blocks ; ++p )
+                        for_each_tile( vertices , p , [&]( std::size_t tile ){ _bins[cursors[tile]++] = static_cast<std::uint32_t>( p ); } );
+                }
+            });
+
+            //Rasterize each tile:
+            _execution_policy.for_each_range( 0 , tiles , 1 , [&]( std::size_t first_tile , std::size_t last_tile )
+            {
+                for( std::size_t t = first_tile ; t < last_tile ; ++t )
+                {
+                    const long x0 = static_cast<long>( ( t % _tiles_x ) * tile_size );
+                    const long y0 = static_cast<long>( ( t / _tiles_x ) * tile_size );
+                    const long x1 = std::min( x0 + static_cast<long>( tile_size ) , static_cast<long>( _framebuffer.width() ) );
+                    const long y1 = std::min( y0 + static_cast<long>( tile_size ) , static_cast<long>( _framebuffer.height() ) );
+
+                    for( std::uint32_t i = _starts[t] ; i < _starts[t + 1] ; ++i )
+                    {
+                        if( _primitive == sdst::primitive_type::points )
+                            plot( std::floor( vertices[_bins[i]].x ) , std::floor( vertices[_bins[i]].y ) , vertices[_bins[i]].color , x0 , y0 , x1 , y1 );
+                        else
+                            line( vertices[2 * _bins[i]] , vertices[2 * _bins[i] + 1] , x0 , y0 , x1 , y1 );
+                    }
+                }
+            });
+        }
+
+        /*
+         * Submission function interface: Same as draw().
+         */
+        void operator()( const sdst::raster_vertex* vertices , std::size_t count )
+        {
+            draw( vertices , count );
+        }
+
+        const sdst::framebuffer& framebuffer() const
+        {
+            return _framebuffer;
+        }
+
+        sdst::framebuffer& framebuffer()
+        {
+            return _framebuffer;
+        }
+
+        const execution_policy_t& execution_policy() const
+        {
+            return _execution_policy;
+        }
+
+    private:
+        static constexpr std::size_t block_size = 16384; //Primitives
+        static constexpr std::size_t max_blocks = 64;
+
+        /*
+         * Calls f(tile) for each tile the bounding box of a primitive overlaps.
+         */
+        template<typename F>
+        void for_each_tile( const sdst::raster_vertex* vertices , std::size_t primitive , F f ) const
+        {
+            float min_x , min_y , max_x , max_y;
+
+            if( _primitive == sdst::primitive_type::points )
+            {
+                min_x = max_x = vertices[primitive].x;
+                min_y = max_y = vertices[primitive].y;
+            }
+            else
+            {
+                const sdst::raster_vertex& a = vertices[2 * primitive];
+                const sdst::raster_vertex& b = vertices[2 * primitive + 1];
+
+                min_x = std::min( a.x , b.x );
+                min_y = std::min( a.y , b.y );
+                max_x = std::max( a.x , b.x );
+                max_y = std::max( a.y , b.y );
+            }
+
+            const float width  = static_cast<float>( _framebuffer.width() );
+            const float height = static_cast<float>( _framebuffer.height() );
+
+            //Also rejects NaN coordinates:
+            if( !( max_x >= 0.0f && max_y >= 0.0f && min_x < width && min_y < height ) )
+                return;
+
+            const std::size_t tx0 = static_cast<std::size_t>( std::max( min_x , 0.0f ) ) / tile_size;
+            const std::size_t ty0 = static_cast<std::size_t>( std::max( min_y , 0.0f ) ) / tile_size;
+            const std::size_t tx1 = static_cast<std::size_t>( std::min( max_x , width - 1.0f ) ) / tile_size;
+            const std::size_t ty1 = static_cast<std::size_t>( std::min( max_y , height - 1.0f ) ) / tile_size;
+
+            if( _primitive == sdst::primitive_type::points || ( tx0 == tx1 && ty0 == ty1 ) )
+            {
+                for( std::size_t ty = ty0 ; ty <= ty1 ; ++ty )
+                    for( std::size_t tx = tx0 ; tx <= tx1 ; ++tx )
+                        f( ty * _tiles_x + tx );
+
+                return;
+            }
+
+            //Long lines skip the tiles of their bounding box they don't cross: Those whose corners
+            //(With a pixel of margin) are all on the same side of the line.
+            const sdst::raster_vertex& a = vertices[2 * primitive];
+            const sdst::raster_vertex& b = vertices[2 * primitive + 1];
+
+            const float nx = a.y - b.y;
+            const float ny = b.x - a.x;
+            const float c  = -( nx * a.x + ny * a.y );
+
+            for( std::size_t ty = ty0 ; ty <= ty1 ; ++ty )
+            {
+                for( std::size_t tx = tx0 ; tx <= tx1 ; ++tx )
+                {
+                    const float x0 = static_cast<float>( tx * tile_size ) - 1.0f , x1 = x0 + tile_size + 2.0f;
+                    const float y0 = static_cast<float>( ty * tile_size ) - 1.0f , y1 = y0 + tile_size + 2.0f;
+
+                    const float d00 = nx * x0 + ny * y0 + c , d10 = nx * x1 + ny * y0 + c;
+                    const float d01 = nx * x0 + ny * y1 + c , d11 = nx * x1 + ny * y1 + c;
+
+                    const bool above = d00 > 0.0f && d10 > 0.0f && d01 > 0.0f && d11 > 0.0f;
+                    const bool below = d00 < 0.0f && d10 < 0.0f && d01 < 0.0f && d11 < 0.0f;
+
+                    if( !above && !below )
+                        f( ty * _tiles_x + tx );
+                }
+            }
+        }
+
+        /*
+         * Blends a pixel, if it is inside the tile [x0,x1)x[y0,y1).
+         */
+        void plot( float x , float y , const sdst::rgba& color , long x0 , long y0 , long x1 , long y1 )
+        {
+            const long px = static_cast<long>( x );
+            const long py = static_cast<long>( y );
+
+            if( px >= x0 && px < x1 && py >= y0 && py < y1 )
+                sdst::impl::blend( _framebuffer( px , py ) , color , _blending );
+        }
+
+        /*
+         * DDA line, with the color interpolated between the endpoints. Only the steps along the major
+         * axis which may fall inside the tile are walked, so each tile pays for its part of the line.
+         */
+        void line( const sdst::raster_vertex& a , const sdst::raster_vertex& b , long x0 , long y0 , long x1 , long y1 )
+        {
+            const float dx    = b.x - a.x;
+            const float dy    = b.y - a.y;
+            const bool  major = std::abs( dx ) >= std::abs( dy ); //True if x is the major axis
+            const float span  = major ? dx : dy;
+            const long  steps = static_cast<long>( std::ceil( std::abs( span ) ) );
+
+            if( steps == 0 )
+            {
+                plot( std::floor( a.x ) , std::floor( a.y ) , a.color , x0 , y0 , x1 , y1 );
+                return;
+            }
+
+            //Range of steps whose major coordinate falls in the tile (Plus a step of margin):
+            const float from  = major ? a.x : a.y;
+            const float low   = static_cast<float>( major ? x0 : y0 );
+            const float high  = static_cast<float>( major ? x1 : y1 );
+            const float k0    = ( low  - from ) * steps / span;
+            const float k1    = ( high - from ) * steps / span;
+            const long  first = std::max( 0L , static_cast<long>( std::floor( std::min( k0 , k1 ) ) ) - 1 );
+            const long  last  = std::min( steps , static_cast<long>( std::ceil( std::max( k0 , k1 ) ) ) + 1 );
+
+            for( long k = first ; k <= last ; ++k )
+            {
+                const float t = static_cast<float>( k ) / steps;
+
+                plot( std::floor( a.x + dx * t ) , std::floor( a.y + dy * t ) , sdst::impl::lerp( a.color , b.color , t ) , x0 , y0 , x1 , y1 );
+            }
+        }
+
+        sdst::framebuffer          _framebuffer;
+        execution_policy_t         _execution_policy;
+        std::size_t                _tiles_x , _tiles_y;
+        sdst::blend_mode           _blending;
+        sdst::primitive_type       _primitive;
+        sdst::rgba                 _clear_color;
+        std::vector<std::uint32_t> _counts; //Per block and tile, then the cursors of the binning
+        std::vector<std::uint32_t> _starts; //Per tile
+        std::vector<std::uint32_t> _bins;   //Primitives of each tile
+    };
+
+    template<typename EXECUTION_POLICY>
+    constexpr std::size_t software_rasterizer<EXECUTION_POLICY>::tile_size;
+
+    template<typename EXECUTION_POLICY>
+    constexpr std::size_t software_rasterizer<EXECUTION_POLICY>::block_size;
+
+    template<typename EXECUTION_POLICY>
+    constexpr std::size_t software_rasterizer<EXECUTION_POLICY>::max_blocks;
+
+    namespace impl
+    {
+        /*
+         * The default projection of raster_drawing, for particle data with the layout of sf::Vertex
+         * (A 'position' vector and a 'color' with r, g, b and a channels).
+         */
+        struct to_raster_vertex
+        {
+            template<typename DATA>
+            sdst::raster_vertex operator()( const DATA& data ) const
+            {
+                return { data.position.x , data.position.y ,
+                         sdst::rgba{ static_cast<std::uint8_t>( data.color.r ) , static_cast<std::uint8_t>( data.color.g ) ,
+                                     static_cast<std::uint8_t>( data.color.b ) , static_cast<std::uint8_t>( data.color.a ) } };
+            }
+        };
+
+        /*
+         * Submission function of raster_drawing: Clears the framebuffer and draws the vertices as points.
+         */
+        template<typename RASTERIZER>
+        struct raster_submit
+        {
+            RASTERIZER* rasterizer;
+
+            void operator()( const sdst::raster_vertex* vertices , std::size_t count ) const
+            {
+                rasterizer->clear();
+                rasterizer->primitive( sdst::primitive_type::points ).draw( vertices , count );
+            }
+        };
+    }
+
+    /*
+     * Scene drawing policy which clears the framebuffer of a software rasterizer and draws each particle
+     * as a point (A vertex buffer drawing policy, see vertex_buffer_drawing.hpp). The projection, a function
+     * sdst::raster_vertex(const DATA&), gives the vertex of each particle. The rasterizer should outlive the policy.
+     */
+    template<typename RASTERIZER , typename PROJECTION = sdst::impl::to_raster_vertex>
+    using raster_drawing = sdst::vertex_buffer_drawing<sdst::raster_vertex,sdst::impl::raster_submit<RASTERIZER>,PROJECTION,typename RASTERIZER::execution_policy_t>;
+
+    template<typename RASTERIZER>
+    sdst::raster_drawing<RASTERIZER> make_raster_drawing( RASTERIZER& rasterizer )
+    {
+        return { sdst::impl::raster_submit<RASTERIZER>{ &rasterizer } , sdst::impl::to_raster_vertex{} , rasterizer.execution_policy() };
+    }
+
+    template<typename RASTERIZER , typename PROJECTION>
+    sdst::raster_drawing<RASTERIZER,typename std::decay<PROJECTION>::type> make_raster_drawing( RASTERIZER& rasterizer , PROJECTION&& projection )
+    {
+        return { sdst::impl::raster_submit<RASTERIZER>{ &rasterizer } , std::forward<PROJECTION>( projection ) , rasterizer.execution_policy() };
+    }
+}
+
+#endif	/* SOFTWARE_RASTERIZER_HPP */
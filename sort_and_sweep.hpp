@@ -0,0 +1,315 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef SORT_AND_SWEEP_HPP
+#define	SORT_AND_SWEEP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "execution_policies.hpp"
+
+/*
+ * Particle-particle collisions. Checking each pair of particles is O(N^2), so the sort and sweep
+ * broadphase keeps the particles sorted by the left side of their bounding box: The boxes overlapping
+ * a box along the x axis are the ones right after it in the sorted order, and the sweep stops at the
+ * first one starting past its right side.
+ *
+ * The particles barely move between frames, so the order of the previous frame is almost sorted, and
+ * the broadphase sorts it again with an insertion sort (Linear when the order didn't change much).
+ *
+ * The broadphase is a stage run between the update and the draw of each frame, from the before_draw
+ * action of the engine:
+ *
+ *     sdst::sort_and_sweep<position> broadphase{ radius };
+ *     sdst::elastic_collision<position,velocity> response{ radius , 0.9f };
+ *
+ *     engine.before_draw( [&]( scene_t& scene ){ broadphase.run( scene , response , pool ); } );
+ *
+ * The pairs are found in parallel, each chunk of the sorted particles writing its own pair buffer,
+ * and then the response policy is called once per pair, sequentially (The same particle can be part
+ * of multiple pairs). The response is a function with the signature:
+ *
+ *     void( DATA& a , DATA& b );
+ *
+ * Only the bounding boxes are tested, so the response should check the actual shapes. The scene
+ * should store its particles contiguously (See data() of sdst::homogeneous_scene and sdst::pool_scene).
+ */
+
+namespace sdst
+{
+    template<typename POSITION>
+    struct sort_and_sweep
+    {
+    public:
+        using data_t = typename POSITION::data_t;
+
+        /*
+         * A pair of particles whose bounding boxes overlap, given by their indices in the scene.
+         */
+        struct pair
+        {
+            std::uint32_t a , b;
+        };
+
+        /*
+         * Initializes the broadphase given the radius of the particles. The bounding box of
+         * a particle is the square of side 2*radius centered at its position.
+         */
+        explicit sort_and_sweep( float radius ) :
+            _radius{ radius },
+            _pair_count{ 0 }
+        {}
+
+        /*
+         * Finds the overlapping pairs of the scene, and then calls the response for each one.
+         * Returns the number of pairs.
+         */
+        template<typename SCENE , typename RESPONSE , typename EXECUTION_POLICY = sdst::sequential_execution>
+        std::size_t run( SCENE& scene , const RESPONSE& response , const EXECUTION_POLICY& execution_policy = EXECUTION_POLICY{} )
+        {
+            find_pairs( scene , execution_policy );
+
+            data_t* data = scene.data();
+
+            for( const std::vector<pair>& buffer : _pairs )
+                for( const pair& p : buffer )
+                    response( data[p.a] , data[p.b] );
+
+            return _pair_count;
+        }
+
+        /*
+         * Finds the overlapping pairs of the scene, without responding to them (See for_each_pair()).
+         * Returns the number of pairs.
+         */
+        template<typename SCENE , typename EXECUTION_POLICY = sdst::sequential_execution>
+        std::size_t find_pairs( const SCENE& scene , const EXECUTION_POLICY& execution_policy = EXECUTION_POLICY{} )
+        {
+            const std::size_t size = scene.size();
+
+            //Particles may have been added or removed since the last frame. The indices still in the scene
+            //keep their place in the order, and the new ones are appended:
+            const std::size_t previous = _entries.size();
+
+            _entries.erase( std::remove_if( _entries.begin() , _entries.end() , [size]( const entry& e ){ return e.index >= size; } ) , _entries.end() );
+
+            for( std::size_t i = previous ; i < size ; ++i )
+                _entries.push_back( entry{ 0.0f , 0.0f , static_cast<std::uint32_t>( i ) } );
+
+            execution_policy.for_each_range( 0 , size , [&]( std::size_t begin , std::size_t end )
+            {
+                for( std::size_t i = begin ; i < end ; ++i )
+                {
+                    const data_t& data = scene[_entries[i].index];
+
+                    _entries[i].min_x = POSITION::get( data ).x - _radius;
+                    _entries[i].y     = POSITION::get( data ).y;
+                }
+            });
+
+            sort();
+
+            const std::size_t blocks = std::max<std::size_t>( std::min( ( size + block_size - 1 ) / block_size , max_blocks ) , 1 );
+
+            if( _pairs.size() < blocks )
+                _pairs.resize( blocks );
+
+            for( std::vector<pair>& buffer : _pairs )
+                buffer.clear();
+
+            //Sweep, each block of the sorted particles writing to its own buffer:
+            const float width = 2.0f * _radius;
+
+            execution_policy.for_each_range( 0 , blocks , 1 , [&]( std::size_t first_block , std::size_t last_block )
+            {
+                for( std::size_t b = first_block ; b < last_block ; ++b )
+                {
+                    std::vector<pair>& buffer = _pairs[b];
+
+                    for( std::size_t i = b * size / blocks ; i < ( b + 1 ) * size / blocks ; ++i )
+                    {
+                        const entry& e     = _entries[i];
+                        const float  limit = e.min_x + width;
+
+                        for( std::size_t j = i + 1 ; j < size && _entries[j].min_x <= limit ; ++j )
+                        {
+                            if( std::abs( _entries[j].y - e.y ) <= width )
+                                buffer.push_back( pair{ e.index , _entries[j].index } );
+                        }
+                    }
+                }
+            });
+
+            _pair_count = 0;
+
+            for( const std::vector<pair>& buffer : _pairs )
+                _pair_count += buffer.size();
+
+            return _pair_count;
+        }
+
+        /*
+         * Calls f(pair) for each pair found by the last run.
+         */
+        template<typename F>
+        void for_each_pair( F f ) const
+        {
+            for( const std::vector<pair>& buffer : _pairs )
+                for( const pair& p : buffer )
+                    f( p );
+        }
+
+        /*
+         * Returns the number of pairs found by the last run.
+         */
+        std::size_t pair_count() const
+        {
+            return _pair_count;
+        }
+
+        float radius() const
+        {
+            return _radius;
+        }
+
+    private:
+        static constexpr std::size_t block_size = 4096;
+        static constexpr std::size_t max_blocks = 64;
+        static constexpr std::size_t max_moves  = 16; //Per particle, before giving up the insertion sort
+
+        struct entry
+        {
+            float         min_x; //Left side of the bounding box
+            float         y;
+            std::uint32_t index;
+        };
+
+        static bool less( const entry& lhs , const entry& rhs )
+        {
+            return lhs.min_x < rhs.min_x;
+        }
+
+        /*
+         * Insertion sort, linear on almost sorted orders. If the order changed too much (The first run,
+         * or after spawning many particles) it falls back to a full sort.
+         */
+        void sort()
+        {
+            const std::size_t size  = _entries.size();
+            std::size_t       moves = 0;
+
+            for( std::size_t i = 1 ; i < size ; ++i )
+            {
+                const entry e = _entries[i];
+                std::size_t j = i;
+
+                for( ; j > 0 && less( e , _entries[j - 1] ) ; --j )
+                    _entries[j] = _entries[j - 1];
+
+                _entries[j] = e;
+                moves      += i - j;
+
+                if( moves > max_moves * size )
+                {
+                    std::sort( _entries.begin() , _entries.end() , &sort_and_sweep::less );
+                    return;
+                }
+            }
+        }
+
+        float                          _radius;
+        std::size_t                    _pair_count;
+        std::vector<entry>             _entries; //Sorted by min_x, kept between runs
+        std::vector<std::vector<pair>> _pairs;   //Per block, reused between runs
+    };
+
+    template<typename POSITION>
+    constexpr std::size_t sort_and_sweep<POSITION>::block_size;
+
+    template<typename POSITION>
+    constexpr std::size_t sort_and_sweep<POSITION>::max_blocks;
+
+    template<typename POSITION>
+    constexpr std::size_t sort_and_sweep<POSITION>::max_moves;
+
+    /*
+     * Collision response for particles which are discs of the same radius and mass: Particles
+     * overlapping and approaching each other exchange the normal component of their velocities
+     * (Scaled by the restitution, 1 for perfectly elastic collisions), and are pushed apart.
+     */
+    template<typename POSITION , typename VELOCITY>
+    struct elastic_collision
+    {
+    public:
+        using data_t = typename POSITION::data_t;
+
+        elastic_collision( float radius , float restitution = 1.0f ) :
+            _diameter{ 2.0f * radius },
+            _restitution{ restitution }
+        {}
+
+        void operator()( data_t& a , data_t& b ) const
+        {
+            auto& pa = POSITION::get( a );
+            auto& pb = POSITION::get( b );
+            auto& va = VELOCITY::get( a );
+            auto& vb = VELOCITY::get( b );
+
+            const float dx = pb.x - pa.x;
+            const float dy = pb.y - pa.y;
+            const float d2 = dx * dx + dy * dy;
+
+            if( d2 >= _diameter * _diameter || d2 == 0.0f )
+                return;
+
+            const float d  = std::sqrt( d2 );
+            const float nx = dx / d;
+            const float ny = dy / d;
+
+            //Push the particles apart, half the overlap each:
+            const float overlap = 0.5f * ( _diameter - d );
+
+            pa.x -= nx * overlap;
+            pa.y -= ny * overlap;
+            pb.x += nx * overlap;
+            pb.y += ny * overlap;
+
+            const float approach = ( va.x - vb.x ) * nx + ( va.y - vb.y ) * ny;
+
+            if( approach <= 0.0f )
+                return;
+
+            const float impulse = 0.5f * ( 1.0f + _restitution ) * approach;
+
+            va.x -= nx * impulse;
+            va.y -= ny * impulse;
+            vb.x += nx * impulse;
+            vb.y += ny * impulse;
+        }
+
+    private:
+        float _diameter , _restitution;
+    };
+}
+
+#endif	/* SORT_AND_SWEEP_HPP */
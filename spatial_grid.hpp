@@ -0,0 +1,491 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef SPATIAL_GRID_HPP
+#define	SPATIAL_GRID_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "Turbo/type_traits.hpp"
+
+#include "execution_policies.hpp"
+#include "stated_policies.hpp"
+
+/*
+ * Evolution policies only see the data of their particle, so interactions between particles
+ * (Collisions, flocking, SPH, etc) would need a O(N^2) traversal of the scene from an action.
+ *
+ * A spatial index is a snapshot of the scene sorted by position, which answers neighbor queries
+ * (Particles within a radius, k nearest particles) visiting only the particles close to the query.
+ * sdst::uniform_grid buckets the particles in square cells and is rebuilt each frame with a
+ * parallel counting sort:
+ *
+ *     using position = SDST_FIELD( particle_data , position );
+ *
+ *     sdst::uniform_grid<position> grid{ 8.0f , 0.0f , 0.0f , 800.0f , 600.0f }; //Cell size and bounds
+ *     scene.spatial_index( &grid );
+ *
+ *     engine.before_update( [&]( scene_t& scene ){ grid.rebuild( scene , execution_policy ); } );
+ *
+ * Scenes with an attached index (sdst::homogeneous_scene, sdst::pool_scene) pass the neighbors of
+ * each particle to evolution policies which have the extended signature:
+ *
+ *     void( DATA& data , const sdst::neighbors<DATA>& neighbors );
+ *
+ * The neighbors are read from the snapshot, the state of the scene when the index was rebuilt, so
+ * querying them while the scene is updated in parallel is safe.
+ */
+
+namespace sdst
+{
+    /*
+     * Snapshot of the particles of a scene sorted by cell, and the neighbor queries on it. Its
+     * filled by the rebuild() of a concrete index (See sdst::uniform_grid).
+     */
+    template<typename DATA>
+    struct spatial_index
+    {
+    public:
+        using data_t = DATA;
+
+        /*
+         * Index of no particle, to run queries which don't exclude any particle.
+         */
+        static const std::size_t nobody = std::numeric_limits<std::size_t>::max();
+
+        /*
+         * Returns the number of particles indexed.
+         */
+        std::size_t size() const
+        {
+            return _size;
+        }
+
+        /*
+         * Reads the position of a particle data.
+         */
+        void position( const data_t& data , float& x , float& y ) const
+        {
+            _position( data , x , y );
+        }
+
+        /*
+         * Calls f( const DATA& data , float dx , float dy , float distance_squared ) for each particle, except
+         * the one with index 'exclude', within 'radius' of (x,y). (dx,dy) is the offset from (x,y) to the particle.
+         */
+        template<typename F>
+        void for_each_within( float x , float y , float radius , std::size_t exclude , F&& f ) const
+        {
+            if( _size == 0 )
+                return;
+
+            const std::size_t first_column = column( x - radius ) , last_column = column( x + radius );
+            const std::size_t first_row    = row( y - radius )    , last_row    = row( y + radius );
+            const float       radius2      = radius * radius;
+
+            for( std::size_t r = first_row ; r <= last_row ; ++r )
+            {
+                //The cells of a row are contiguous in the snapshot:
+                const std::size_t begin = _starts[r * _columns + first_column];
+                const std::size_t end   = _starts[r * _columns + last_column + 1];
+
+                for( std::size_t slot = begin ; slot < end ; ++slot )
+                {
+                    const float dx = _xs[slot] - x;
+                    const float dy = _ys[slot] - y;
+                    const float d2 = dx * dx + dy * dy;
+
+                    if( d2 <= radius2 && _indices[slot] != exclude )
+                        f( _data[slot] , dx , dy , d2 );
+                }
+            }
+        }
+
+        /*
+         * Finds the (Up to) k particles closest to (x,y) within 'max_radius', except the one with index 'exclude'.
+         * Writes them to 'neighbors' and their squared distances to 'distances_squared' (Arrays of at least k
+         * elements), closest first. Returns the number of particles found.
+         */
+        std::size_t nearest( float x , float y , std::size_t k , std::size_t exclude , const data_t** neighbors , float* distances_squared ,
+                             float max_radius = std::numeric_limits<float>::infinity() ) const
+        {
+            if( _size == 0 || k == 0 )
+                return 0;
+
+            const std::size_t home_column = column( x );
+            const std::size_t home_row    = row( y );
+            const float       max_radius2 = max_radius * max_radius;
+            std::size_t       found       = 0;
+
+            //Inserts the particles of a cell into the sorted result:
+            auto visit = [&]( std::size_t cell )
+            {
+                for( std::size_t slot = _starts[cell] ; slot < _starts[cell + 1] ; ++slot )
+                {
+                    const float dx = _xs[slot] - x;
+                    const float dy = _ys[slot] - y;
+                    const float d2 = dx * dx + dy * dy;
+
+                    if( d2 > max_radius2 || _indices[slot] == exclude || ( found == k && d2 >= distances_squared[k - 1] ) )
+                        continue;
+
+                    std::size_t i = found < k ? found++ : k - 1;
+
+                    for( ; i > 0 && distances_squared[i - 1] > d2 ; --i )
+                    {
+                        distances_squared[i] = distances_squared[i - 1];
+                        neighbors[i]         = neighbors[i - 1];
+                    }
+
+                    distances_squared[i] = d2;
+                    neighbors[i]         = &_data[slot];
+                }
+            };
+
+            //Visits rings of cells around the home cell. Particles beyond the ring r are at least r - 1 cells away:
+            for( std::size_t ring = 0 ; ; ++ring )
+            {
+                const float reach = ring > 0 ? ( ring - 1 ) * _cell_size : 0.0f;
+
+                if( reach > max_radius || ( found == k && distances_squared[k - 1] <= reach * reach ) )
+                    break;
+
+                //Which sides of the ring are inside the grid:
+                const bool left   = home_column >= ring;
+                const bool right  = home_column + ring < _columns;
+                const bool top    = home_row >= ring;
+                const bool bottom = home_row + ring < _rows;
+
+                if( !left && !right && !top && !bottom )
+                    break;
+
+                const std::size_t first_column = left   ? home_column - ring : 0;
+                const std::size_t last_column  = right  ? home_column + ring : _columns - 1;
+                const std::size_t first_row    = top    ? home_row - ring    : 0;
+                const std::size_t last_row     = bottom ? home_row + ring    : _rows - 1;
+
+                for( std::size_t r = first_row ; r <= last_row ; ++r )
+                {
+                    if( ring == 0 || ( top && r == home_row - ring ) || ( bottom && r == home_row + ring ) )
+                    {
+                        for( std::size_t c = first_column ; c <= last_column ; ++c )
+                            visit( r * _columns + c );
+                    }
+                    else
+                    {
+                        if( left )
+                            visit( r * _columns + home_column - ring );
+                        if( right )
+                            visit( r * _columns + home_column + ring );
+                    }
+                }
+            }
+
+            return found;
+        }
+
+    protected:
+        using position_function_t = void(*)( const data_t& , float& , float& );
+
+        spatial_index( position_function_t position , float cell_size , float min_x , float min_y , std::size_t columns , std::size_t rows ) :
+            _position{ position },
+            _cell_size{ cell_size },
+            _inverse_cell_size{ 1.0f / cell_size },
+            _min_x{ min_x },
+            _min_y{ min_y },
+            _columns{ columns },
+            _rows{ rows },
+            _size{ 0 },
+            _starts( columns * rows + 1 , 0 )
+        {}
+
+        std::size_t column( float x ) const
+        {
+            const float c = std::floor( ( x - _min_x ) * _inverse_cell_size );
+
+            return c <= 0.0f ? 0 : std::min( static_cast<std::size_t>( c ) , _columns - 1 );
+        }
+
+        std::size_t row( float y ) const
+        {
+            const float r = std::floor( ( y - _min_y ) * _inverse_cell_size );
+
+            return r <= 0.0f ? 0 : std::min( static_cast<std::size_t>( r ) , _rows - 1 );
+        }
+
+        std::size_t cell( float x , float y ) const
+        {
+            return row( y ) * _columns + column( x );
+        }
+
+        position_function_t _position;
+        float               _cell_size;
+        float               _inverse_cell_size;
+        float               _min_x , _min_y;
+        std::size_t         _columns , _rows;
+
+        //The snapshot, sorted by cell. The particles of the cell c are the slots [_starts[c],_starts[c + 1]).
+        std::size_t                _size;
+        std::vector<std::uint32_t> _starts;
+        std::vector<float>         _xs;
+        std::vector<float>         _ys;
+        std::vector<data_t>        _data;
+        std::vector<std::size_t>   _indices; //Index in the scene of each slot
+    };
+
+    /*
+     * The neighborhood of a particle: Neighbor queries around its position, which never
+     * return the particle itself. Passed to evolution policies with the extended signature.
+     */
+    template<typename DATA>
+    struct neighbors
+    {
+    public:
+        using data_t = DATA;
+
+        neighbors( const sdst::spatial_index<data_t>* index , std::size_t self , const data_t& data ) :
+            _index{ index },
+            _self{ self },
+            _x{ 0.0f },
+            _y{ 0.0f }
+        {
+            if( _index != nullptr )
+                _index->position( data , _x , _y );
+        }
+
+        /*
+         * Calls f( const DATA& data , float dx , float dy , float distance_squared ) for each
+         * neighbor within 'radius'. See spatial_index::for_each_within().
+         */
+        template<typename F>
+        void for_each_within( float radius , F&& f ) const
+        {
+            if( _index != nullptr )
+                _index->for_each_within( _x , _y , radius , _self , std::forward<F>( f ) );
+        }
+
+        /*
+         * Returns the number of neighbors within 'radius'.
+         */
+        std::size_t count_within( float radius ) const
+        {
+            std::size_t count = 0;
+
+            for_each_within( radius , [&]( const data_t& , float , float , float ){ ++count; } );
+
+            return count;
+        }
+
+        /*
+         * Finds the k nearest neighbors. See spatial_index::nearest().
+         */
+        std::size_t nearest( std::size_t k , const data_t** neighbors , float* distances_squared , float max_radius = std::numeric_limits<float>::infinity() ) const
+        {
+            return _index != nullptr ? _index->nearest( _x , _y , k , _self , neighbors , distances_squared , max_radius ) : 0;
+        }
+
+        /*
+         * The position the queries are centered on.
+         */
+        float x() const
+        {
+            return _x;
+        }
+
+        float y() const
+        {
+            return _y;
+        }
+
+    private:
+        const sdst::spatial_index<data_t>* _index;
+        std::size_t                        _self;
+        float                              _x , _y;
+    };
+
+    namespace impl
+    {
+        /*
+         * Calls an evolution policy on the data of a particle, passing the neighbors of the particle
+         * if the policy has the extended signature. Used by the scenes which support spatial indices.
+         */
+        template<typename P , typename DATA , typename ACCEPTS_NEIGHBORS = tml::is_valid_call<P,DATA&,const sdst::neighbors<DATA>&>>
+        struct evolve_data
+        {
+            static void execute( sdst::erase_state<P>& policy , DATA& data , const sdst::spatial_index<DATA>* index , std::size_t self )
+            {
+                policy( data , sdst::neighbors<DATA>{ index , self , data } );
+            }
+        };
+
+        template<typename P , typename DATA>
+        struct evolve_data<P,DATA,tml::false_type>
+        {
+            static void execute( sdst::erase_state<P>& policy , DATA& data , const sdst::spatial_index<DATA>* , std::size_t )
+            {
+                policy( data );
+            }
+        };
+    }
+
+    /*
+     * Spatial index which buckets the particles in a uniform grid of square cells, given the field
+     * with the position of the particles (A type with x and y members) and the bounds of the grid.
+     * Particles out of the bounds are stored in the border cells, so they are still found, but
+     * queries around them are slower.
+     *
+     * Queries cost O(particles in the cells overlapped), so the cell size should be about the
+     * radius of the queries.
+     */
+    template<typename FIELD>
+    struct uniform_grid : public sdst::spatial_index<typename FIELD::data_t>
+    {
+    private:
+        using base_t = sdst::spatial_index<typename FIELD::data_t>;
+
+    public:
+        using data_t = typename FIELD::data_t;
+
+        uniform_grid( float cell_size , float min_x , float min_y , float max_x , float max_y ) :
+            base_t{ &uniform_grid::read_position , cell_size , min_x , min_y ,
+                    std::max<std::size_t>( static_cast<std::size_t>( std::ceil( ( max_x - min_x ) / cell_size ) ) , 1 ) ,
+                    std::max<std::size_t>( static_cast<std::size_t>( std::ceil( ( max_y - min_y ) / cell_size ) ) , 1 ) }
+        {}
+
+        /*
+         * Rebuilds the index from the current state of the scene, sorting the particles by cell
+         * with a counting sort whose passes are split in blocks through the execution policy.
+         * Each block has its own histogram, so the sort is stable: The particles of a cell keep
+         * their scene order whatever the number of threads, and so do the queries.
+         * Only allocates when the scene is larger than in previous rebuilds.
+         */
+        template<typename SCENE , typename EXECUTION_POLICY = sdst::sequential_execution>
+        void rebuild( const SCENE& scene , const EXECUTION_POLICY& execution_policy = EXECUTION_POLICY{} )
+        {
+            const std::size_t size  = scene.size();
+            const std::size_t cells = this->_columns * this->_rows;
+
+            //Blocks of at least a histogram worth of particles, so the scan stays O(particles):
+            const std::size_t blocks = std::min( std::max<std::size_t>( size / std::max( block_size , cells ) , 1 ) , max_blocks );
+
+            if( _cells.size() < size )
+            {
+                _cells.resize( size );
+                this->_xs.resize( size );
+                this->_ys.resize( size );
+                this->_data.resize( size );
+                this->_indices.resize( size );
+            }
+
+            if( _histograms.size() < cells * blocks )
+                _histograms.resize( cells * blocks );
+
+            this->_size = size;
+
+            //Count the particles of each cell, per block:
+            execution_policy.for_each_range( 0 , blocks , 1 , [&]( std::size_t first_block , std::size_t last_block )
+            {
+                for( std::size_t b = first_block ; b < last_block ; ++b )
+                {
+                    std::uint32_t* histogram = _histograms.data() + cells * b;
+
+                    std::fill( histogram , histogram + cells , 0 );
+
+                    for( std::size_t i = block_begin( b , blocks ) ; i < block_begin( b + 1 , blocks ) ; ++i )
+                    {
+                        const auto&       position = FIELD::get( scene[i] );
+                        const std::size_t cell     = this->cell( position.x , position.y );
+
+                        _cells[i] = static_cast<std::uint32_t>( cell );
+                        ++histogram[cell];
+                    }
+                }
+            });
+
+            //Exclusive scan, cell-major, turning the histograms into the cursors of each block:
+            std::uint32_t start = 0;
+
+            for( std::size_t c = 0 ; c < cells ; ++c )
+            {
+                this->_starts[c] = start;
+
+                for( std::size_t b = 0 ; b < blocks ; ++b )
+                {
+                    const std::uint32_t count = _histograms[cells * b + c];
+
+                    _histograms[cells * b + c] = start;
+                    start += count;
+                }
+            }
+
+            this->_starts[cells] = start;
+
+            //Scatter the particles to their slots:
+            execution_policy.for_each_range( 0 , blocks , 1 , [&]( std::size_t first_block , std::size_t last_block )
+            {
+                for( std::size_t b = first_block ; b < last_block ; ++b )
+                {
+                    std::uint32_t* cursors = _histograms.data() + cells * b;
+
+                    for( std::size_t i = block_begin( b , blocks ) ; i < block_begin( b + 1 , blocks ) ; ++i )
+                    {
+                        const std::size_t slot = cursors[_cells[i]]++;
+                        const data_t&     data = scene[i];
+
+                        this->_data[slot]    = data;
+                        this->_indices[slot] = i;
+                        read_position( data , this->_xs[slot] , this->_ys[slot] );
+                    }
+                }
+            });
+        }
+
+    private:
+        static constexpr std::size_t block_size = 16384;
+        static constexpr std::size_t max_blocks = 64;
+
+        std::size_t block_begin( std::size_t block , std::size_t blocks ) const
+        {
+            return block * this->_size / blocks;
+        }
+
+        static void read_position( const data_t& data , float& x , float& y )
+        {
+            x = FIELD::get( data ).x;
+            y = FIELD::get( data ).y;
+        }
+
+        std::vector<std::uint32_t> _histograms; //Per block
+        std::vector<std::uint32_t> _cells;      //Cell of each particle
+    };
+
+    template<typename FIELD>
+    constexpr std::size_t uniform_grid<FIELD>::block_size;
+
+    template<typename FIELD>
+    constexpr std::size_t uniform_grid<FIELD>::max_blocks;
+}
+
+#endif	/* SPATIAL_GRID_HPP */
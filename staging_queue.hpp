@@ -0,0 +1,233 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef STAGING_QUEUE_HPP
+#define	STAGING_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Writing to disk from the frame loop stalls the frame. A staging queue moves the slow part to a
+ * background thread: The frame loop fills a buffer of a bounded pool (A cheap copy of the state to
+ * save) and submits it, and the background thread consumes the submitted buffers in order (Compressing
+ * and writing them, for example) and then returns them to the pool:
+ *
+ *     sdst::staging_queue<std::vector<char>> queue{ 2 , []( std::vector<char>& buffer ){ write( buffer ); } };
+ *
+ *     if( std::vector<char>* buffer = queue.try_acquire() ) //nullptr if all the buffers are in flight
+ *     {
+ *         fill( *buffer );
+ *         queue.submit( buffer );
+ *     }
+ *
+ * The buffers are reused, so once they are large enough staging doesn't allocate. The pool bounds the
+ * memory used when the disk is slower than the frame loop: The frame loop chooses between skipping
+ * (try_acquire()) or waiting (acquire()), never queuing more.
+ */
+
+namespace sdst
+{
+    template<typename BUFFER>
+    struct staging_queue
+    {
+    public:
+        using buffer_t   = BUFFER;
+        using consumer_t = std::function<void(buffer_t&)>;
+
+        /*
+         * Initializes a pool of 'buffers' buffers, and starts the thread which consumes them.
+         */
+        staging_queue( std::size_t buffers , const consumer_t& consumer ) :
+            _buffers( buffers ),
+            _consumer( consumer ),
+            _busy{ false },
+            _stop{ false }
+        {
+            for( buffer_t& buffer : _buffers )
+                _free.push_back( &buffer );
+
+            _thread = std::thread{ [this](){ loop(); } };
+        }
+
+        staging_queue( const staging_queue& ) = delete;
+        staging_queue& operator=( const staging_queue& ) = delete;
+
+        /*
+         * Consumes the buffers already submitted, and stops the thread.
+         */
+        ~staging_queue()
+        {
+            {
+                std::lock_guard<std::mutex> lock{ _mutex };
+                _stop = true;
+            }
+
+            _wake.notify_all();
+            _thread.join();
+        }
+
+        /*
+         * Returns a free buffer, or nullptr if all the buffers are submitted or being consumed.
+         * Never blocks (Beyond the queue lock).
+         */
+        buffer_t* try_acquire()
+        {
+            std::lock_guard<std::mutex> lock{ _mutex };
+
+            return pop_free();
+        }
+
+        /*
+         * Returns a free buffer, waiting for the consumer to release one if necessary.
+         */
+        buffer_t* acquire()
+        {
+            std::unique_lock<std::mutex> lock{ _mutex };
+            _released.wait( lock , [this](){ return !_free.empty(); } );
+
+            return pop_free();
+        }
+
+        /*
+         * Queues an acquired buffer to be consumed. Buffers are consumed in submission order.
+         */
+        void submit( buffer_t* buffer )
+        {
+            {
+                std::lock_guard<std::mutex> lock{ _mutex };
+                _queue.push_back( buffer );
+            }
+
+            _wake.notify_all();
+        }
+
+        /*
+         * Returns an acquired buffer to the pool without consuming it.
+         */
+        void release( buffer_t* buffer )
+        {
+            {
+                std::lock_guard<std::mutex> lock{ _mutex };
+                _free.push_back( buffer );
+            }
+
+            _released.notify_all();
+        }
+
+        /*
+         * Waits until all the submitted buffers are consumed. Rethrows the first exception thrown
+         * by the consumer since the last wait(), if any.
+         */
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock{ _mutex };
+            _released.wait( lock , [this](){ return _queue.empty() && !_busy; } );
+
+            if( _error )
+            {
+                std::exception_ptr error = _error;
+                _error = nullptr;
+                std::rethrow_exception( error );
+            }
+        }
+
+        /*
+         * Returns the number of buffers of the pool.
+         */
+        std::size_t size() const
+        {
+            return _buffers.size();
+        }
+
+    private:
+        buffer_t* pop_free()
+        {
+            if( _free.empty() )
+                return nullptr;
+
+            buffer_t* buffer = _free.back();
+            _free.pop_back();
+
+            return buffer;
+        }
+
+        void loop()
+        {
+            for(;;)
+            {
+                buffer_t* buffer;
+
+                {
+                    std::unique_lock<std::mutex> lock{ _mutex };
+                    _wake.wait( lock , [this](){ return !_queue.empty() || _stop; } );
+
+                    if( _queue.empty() ) //Stopped, with all the buffers consumed
+                        return;
+
+                    buffer = _queue.front();
+                    _queue.pop_front();
+                    _busy  = true;
+                }
+
+                std::exception_ptr error;
+
+                try
+                {
+                    _consumer( *buffer );
+                }
+                catch( ... )
+                {
+                    error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock{ _mutex };
+                    _free.push_back( buffer );
+                    _busy = false;
+
+                    if( error && !_error )
+                        _error = error;
+                }
+
+                _released.notify_all();
+            }
+        }
+
+        std::vector<buffer_t>   _buffers;
+        consumer_t              _consumer;
+        std::vector<buffer_t*>  _free;
+        std::deque<buffer_t*>   _queue;
+        bool                    _busy;
+        bool                    _stop;
+        std::exception_ptr      _error;
+        std::mutex              _mutex;
+        std::condition_variable _wake;
+        std::condition_variable _released;
+        std::thread             _thread; //Launched in the constructor body, with the rest already initialized
+    };
+}
+
+#endif	/* STAGING_QUEUE_HPP */
@@ -8,6 +8,8 @@
 #ifndef STATED_POLICIES_HPP
 #define	STATED_POLICIES_HPP
 
+#include <cstddef>
+
 #include "Turbo/enable_if.hpp"
 #include "Turbo/type_traits.hpp"
 
@@ -27,7 +29,8 @@
  * and a simple particle engine could easily handle it traversing the set of particles and calling 'update()' 
  * for each one. A global update, on the other hand, can't be handled correctly using that pattern, and should 
  * be requested manually by the user or a more complex engine which takes care and stores policies shared between 
- * particles.
+ * particles. The engines of the library do so for the shared policies registered in their policy arena (See 
+ * policy_arena.hpp).
  * 
  * The signature of the update function-like call is:
  *     
@@ -36,6 +39,14 @@
  * Any policy where such signature is valid is regarded to have state and candidate for update. 
  * A 'sdst::erase_state<P>' template is provided to perform static type erasure and treat both types of policies 
  * (Stated and non-stated) in the same homogeneous way. 
+ * 
+ * Scenes which update blocks of particles sharing their policies (See homogeneous_scene.hpp) request the local
+ * updates of a whole block at once, passing a 'sdst::local_updates' with the number of particles updated:
+ * 
+ *     void(sdst::local_updates)
+ * 
+ * Policies supporting that signature advance their state once per block. For the rest, sdst::erase_state
+ * turns the request into 'count' local updates.
  */
 
 namespace sdst
@@ -54,6 +65,21 @@ namespace sdst
      */
     using update_request_t = void(sdst::state_change);
     
+    /*
+     * A batch of local updates: Equivalent to 'count' sdst::state_change::local updates, one per particle
+     * of a block of the scene.
+     */
+    struct local_updates
+    {
+        std::size_t count;
+    };
+    
+    /*
+     * Checks whether POLICY supports batched local updates. Evaluates to tml::true_type or tml::false_type.
+     */
+    template<typename POLICY>
+    using is_batch_stated = tml::is_valid_call<POLICY,sdst::local_updates>;
+    
     
     /*
      * Performs static type erasure to manage homogenoeusly both stated
@@ -100,6 +126,15 @@ namespace sdst
             update_request<POLICY>::execute( _policy , change );
         }
         
+        /*
+         * Call overload for batched local update requests. Policies which don't support
+         * them get one local update per particle, if they are stated.
+         */
+        void operator()( sdst::local_updates updates )
+        {
+            batch_update_request<POLICY>::execute( _policy , updates );
+        }
+        
         
         /*
          * Gives const access to the underlying policy.
@@ -178,6 +213,33 @@ namespace sdst
                 /* does nothing */
             }
         };
+        
+        /*
+         * Batched local update request. This specialization is rejected if the
+         * underlying policy doesn't support batched updates.
+         */
+        template<typename P , typename IS_BATCH_STATED = sdst::is_batch_stated<P>>
+        struct batch_update_request
+        {
+            static void execute( P& policy , sdst::local_updates updates )
+            {
+                policy( updates );
+            }
+        };
+        
+        /*
+         * Batched local update request. This specialization is rejected if the
+         * underlying policy supports batched updates.
+         */
+        template<typename P>
+        struct batch_update_request<P,tml::false_type>
+        {
+            static void execute( P& policy , sdst::local_updates updates )
+            {
+                for( std::size_t i = 0 ; i < updates.count ; ++i )
+                    update_request<P>::execute( policy , sdst::state_change::local );
+            }
+        };
     };
 }
 
@@ -0,0 +1,423 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef STATIC_ENGINE_HPP
+#define	STATIC_ENGINE_HPP
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+#include "Turbo/type_traits.hpp"
+
+#include "basic_engines.hpp"
+
+namespace sdst
+{
+    namespace impl
+    {
+        /*
+         * Default action of a simulation stage: Does nothing.
+         */
+        struct no_action
+        {
+            template<typename T>
+            void operator()( const T& ) const
+            {}
+        };
+
+        /*
+         * Default running condition: Runs forever.
+         */
+        struct always_running
+        {
+            template<typename T>
+            bool operator()( const T& ) const
+            {
+                return true;
+            }
+        };
+
+        /*
+         * Calls a simulation stage action. Actions can take the engine or the scene, since C++11 lambdas
+         * can't name the type of the engine they are part of.
+         */
+        template<typename F , typename ENGINE , typename ACCEPTS_ENGINE = tml::is_valid_call<F,ENGINE&>>
+        struct call_action
+        {
+            static auto execute( F& action , ENGINE& engine ) -> decltype( action( engine ) )
+            {
+                return action( engine );
+            }
+        };
+
+        template<typename F , typename ENGINE>
+        struct call_action<F,ENGINE,tml::false_type>
+        {
+            static auto execute( F& action , ENGINE& engine ) -> decltype( action( engine.scene() ) )
+            {
+                return action( engine.scene() );
+            }
+        };
+    }
+
+    /*
+     * An automatic engine whose simulation stages are part of its type: The actions and the running condition
+     * are stored as their concrete types (Not as std::functions as in sdst::basic_automatic_engine), so
+     * they can be inlined into the simulation loop, and capturing lambdas need no heap allocations.
+     *
+     * Specifying an action returns a new engine type, so engines are built chaining the specifiers on the
+     * engine returned by make_static_automatic_engine():
+     *
+     *     auto engine = sdst::make_static_automatic_engine( scene , draw_policy )
+     *                   .before_update( []( scene_t& scene ){ ... } )
+     *                   .before_next( []( scene_t& scene ){ ... } );
+     *
+     *     engine.run_while( []( const scene_t& scene ){ return ...; } );
+     *
+     * Actions (And conditions) take the engine or, if they can't, its scene. The specifiers move the engine
+     * into the new one, so they only work on rvalues (Use std::move() on an engine variable).
+     */
+    template<typename SCENE , typename DRAW_POLICY , typename EXECUTION_POLICY = sdst::sequential_execution ,
+             typename BEFORE_UPDATE = sdst::impl::no_action , typename BEFORE_DRAW = sdst::impl::no_action ,
+             typename BEFORE_NEXT = sdst::impl::no_action , typename RUN_CONDITION = sdst::impl::always_running>
+    struct static_automatic_engine
+    {
+        /*
+         * The type of the scene.
+         */
+        using scene_t = SCENE;
+
+        /*
+         * The type of the scene draw policy used.
+         */
+        using draw_policy_t = DRAW_POLICY;
+
+        /*
+         * The type of the execution policy used to update the scene.
+         */
+        using execution_policy_t = EXECUTION_POLICY;
+
+        /*
+         * The engine runs a manual engine. This is the type of such engine.
+         */
+        using underlying_engine_t = sdst::basic_manual_engine<scene_t,draw_policy_t,execution_policy_t>;
+
+        /*
+         * The type of the engine
+         */
+        using engine_t = static_automatic_engine;
+
+        /*
+         * Result of the simulation (See sdst::simulation_result).
+         */
+        using simulation_result_t = sdst::simulation_result;
+
+
+        /*
+         * Initializes the engine passign the values to initialize the scene and the drawing policy
+         */
+        static_automatic_engine( const scene_t& scene , const draw_policy_t& draw_policy , const execution_policy_t& execution_policy = execution_policy_t{} ) :
+            _engine{ scene , draw_policy , execution_policy },
+            _stopped{ false },
+            _test_during_update{ false }
+        {}
+
+        /*
+         * Specifies the action to be performed before the engine updates the state of
+         * the simulation.
+         */
+        template<typename F>
+        sdst::static_automatic_engine<SCENE,DRAW_POLICY,EXECUTION_POLICY,typename std::decay<F>::type,BEFORE_DRAW,BEFORE_NEXT,RUN_CONDITION> before_update( F&& action ) &&
+        {
+            return { std::move( _engine ) , _loop , _test_during_update , std::forward<F>( action ) , std::move( _before_draw ) , std::move( _before_next ) , std::move( _run_condition ) };
+        }
+
+        /*
+         * Specifies the action to be performed before the engine draws the current
+         * state of the scene.
+         */
+        template<typename F>
+        sdst::static_automatic_engine<SCENE,DRAW_POLICY,EXECUTION_POLICY,BEFORE_UPDATE,typename std::decay<F>::type,BEFORE_NEXT,RUN_CONDITION> before_draw( F&& action ) &&
+        {
+            return { std::move( _engine ) , _loop , _test_during_update , std::move( _before_update ) , std::forward<F>( action ) , std::move( _before_next ) , std::move( _run_condition ) };
+        }
+
+        /*
+         * Specifies the action to be performed before the engine goes to the next
+         * step of the simulation.
+         */
+        template<typename F>
+        sdst::static_automatic_engine<SCENE,DRAW_POLICY,EXECUTION_POLICY,BEFORE_UPDATE,BEFORE_DRAW,typename std::decay<F>::type,RUN_CONDITION> before_next( F&& action ) &&
+        {
+            return { std::move( _engine ) , _loop , _test_during_update , std::move( _before_update ) , std::move( _before_draw ) , std::forward<F>( action ) , std::move( _run_condition ) };
+        }
+
+        /*
+         * Specifies the running condition used by start().
+         */
+        template<typename F>
+        sdst::static_automatic_engine<SCENE,DRAW_POLICY,EXECUTION_POLICY,BEFORE_UPDATE,BEFORE_DRAW,BEFORE_NEXT,typename std::decay<F>::type> run_condition( F&& condition ) &&
+        {
+            return { std::move( _engine ) , _loop , _test_during_update , std::move( _before_update ) , std::move( _before_draw ) , std::move( _before_next ) , std::forward<F>( condition ) };
+        }
+
+        /*
+         * See basic_automatic_engine::fixed_timestep().
+         */
+        engine_t& fixed_timestep( double timestep , std::size_t max_steps = 5 )
+        {
+            _loop.fixed_timestep( timestep , max_steps );
+
+            return *this;
+        }
+
+        /*
+         * Returns the fixed timestep of the simulation, zero if the simulation runs one step per frame.
+         */
+        double timestep() const
+        {
+            return _loop.timestep();
+        }
+
+        /*
+         * Returns the interpolation factor between the previous and the current simulation steps
+         * of the frame being drawn.
+         */
+        float interpolation() const
+        {
+            return _loop.interpolation();
+        }
+
+        /*
+         * See basic_automatic_engine::profile_every().
+         */
+        engine_t& profile_every( std::size_t period )
+        {
+            _loop.profile_every( period );
+
+            return *this;
+        }
+
+        /*
+         * See basic_automatic_engine::test_during_update().
+         */
+        engine_t& test_during_update( bool enabled = true )
+        {
+            _test_during_update = enabled;
+
+            return *this;
+        }
+
+        /*
+         * Starts the simulation.
+         */
+        simulation_result_t start()
+        {
+            return run_while( _run_condition );
+        }
+
+        /*
+         * Stops the simulation after the current frame.
+         */
+        void stop()
+        {
+            _stopped = true;
+        }
+
+        /*
+         * Starts and runs the simulation while the passed condition is true.
+         */
+        template<typename CONDITION>
+        simulation_result_t run_while( CONDITION condition )
+        {
+            return run( _engine , condition );
+        }
+
+        /*
+         * Starts and runs the simulation until the passed condition is true.
+         */
+        template<typename CONDITION>
+        simulation_result_t run_until( CONDITION condition )
+        {
+            return run_while( [this,&condition]( const engine_t& ){ return !sdst::impl::call_action<CONDITION,const engine_t>::execute( condition , *this ); } );
+        }
+
+        /*
+         * Starts and runs the simulation while some property is met by all the particles
+         * of the scene.
+         */
+        template<typename PROPERTY>
+        simulation_result_t run_while_all( PROPERTY property )
+        {
+            if( _test_during_update )
+                return run_tested( sdst::quantifier::all , true , property );
+
+            return run_while( [&]( const engine_t& e )
+            {
+                return std::all_of( std::begin( e.scene() ) , std::end( e.scene() ) , property );
+            });
+        }
+
+        /*
+         * Starts and runs the simulation while some property is met by at least one particle
+         * of the scene.
+         */
+        template<typename PROPERTY>
+        simulation_result_t run_while_any( PROPERTY property )
+        {
+            if( _test_during_update )
+                return run_tested( sdst::quantifier::any , true , property );
+
+            return run_while( [&]( const engine_t& e )
+            {
+                return std::any_of( std::begin( e.scene() ) , std::end( e.scene() ) , property );
+            });
+        }
+
+        /*
+         * Starts and runs the simulation until some property is met by all the particles
+         * of the scene.
+         */
+        template<typename PROPERTY>
+        simulation_result_t run_until_all( PROPERTY property )
+        {
+            if( _test_during_update )
+                return run_tested( sdst::quantifier::all , false , property );
+
+            return run_until( [&]( const engine_t& e )
+            {
+                return std::all_of( std::begin( e.scene() ) , std::end( e.scene() ) , property );
+            });
+        }
+
+        /*
+         * Starts and runs the simulation until some property is met by at least one particle
+         * of the scene.
+         */
+        template<typename PROPERTY>
+        simulation_result_t run_until_any( PROPERTY property )
+        {
+            if( _test_during_update )
+                return run_tested( sdst::quantifier::any , false , property );
+
+            return run_until( [&]( const engine_t& e )
+            {
+                return std::any_of( std::begin( e.scene() ) , std::end( e.scene() ) , property );
+            });
+        }
+
+        /*
+         * Provides full (Read/Write) access to the underlying scene of an engine.
+         */
+        SCENE& scene()
+        {
+            return _engine.scene();
+        }
+
+        /*
+         * Provides readonly access to the underlying scene of an engine
+         */
+        const SCENE& scene() const
+        {
+            return _engine.scene();
+        }
+
+        /*
+         * Gives access to the arena of the shared policies of the scene.
+         */
+        sdst::policy_arena& policies()
+        {
+            return _engine.policies();
+        }
+
+        const sdst::policy_arena& policies() const
+        {
+            return _engine.policies();
+        }
+
+    private:
+        template<typename , typename , typename , typename , typename , typename , typename>
+        friend struct sdst::static_automatic_engine;
+
+        static_automatic_engine( underlying_engine_t&& engine , const sdst::impl::frame_loop& loop , bool test_during_update ,
+                                 BEFORE_UPDATE before_update , BEFORE_DRAW before_draw , BEFORE_NEXT before_next , RUN_CONDITION run_condition ) :
+            _engine{ std::move( engine ) },
+            _loop( loop ),
+            _stopped{ false },
+            _test_during_update{ test_during_update },
+            _before_update( std::move( before_update ) ),
+            _before_draw( std::move( before_draw ) ),
+            _before_next( std::move( before_next ) ),
+            _run_condition( std::move( run_condition ) )
+        {}
+
+        /*
+         * Runs the simulation loop on the manual engine, or on a wrapper of it.
+         */
+        template<typename ENGINE , typename CONDITION>
+        simulation_result_t run( ENGINE& engine , CONDITION& condition )
+        {
+            _stopped = false;
+
+            return _loop.run( engine ,
+                              [this](){ sdst::impl::call_action<BEFORE_UPDATE,engine_t>::execute( _before_update , *this ); } ,
+                              [this](){ sdst::impl::call_action<BEFORE_DRAW,engine_t>::execute( _before_draw , *this ); } ,
+                              [this](){ sdst::impl::call_action<BEFORE_NEXT,engine_t>::execute( _before_next , *this ); } ,
+                              [this,&condition](){ return !_stopped && sdst::impl::call_action<CONDITION,const engine_t>::execute( condition , *this ); } );
+        }
+
+        /*
+         * Runs the simulation while the quantified property tested during the updates equals 'expected'.
+         */
+        template<typename PROPERTY>
+        simulation_result_t run_tested( sdst::quantifier quantifier , bool expected , PROPERTY& property )
+        {
+            sdst::impl::tested_steps<underlying_engine_t,PROPERTY> steps{ _engine , quantifier , property };
+
+            auto condition = [&steps,expected]( const engine_t& ){ return steps.holds() == expected; };
+
+            return run( steps , condition );
+        }
+
+        underlying_engine_t    _engine;
+        sdst::impl::frame_loop _loop;
+        bool                   _stopped;
+        bool                   _test_during_update;
+
+        BEFORE_UPDATE _before_update;
+        BEFORE_DRAW   _before_draw;
+        BEFORE_NEXT   _before_next;
+        RUN_CONDITION _run_condition;
+    };
+
+    template<typename SCENE , typename DRAW_POLICY>
+    sdst::static_automatic_engine<typename std::decay<SCENE>::type,typename std::decay<DRAW_POLICY>::type> make_static_automatic_engine( SCENE&& scene , DRAW_POLICY&& draw_policy )
+    {
+        return { std::forward<SCENE>( scene ) , std::forward<DRAW_POLICY>( draw_policy ) };
+    }
+
+    template<typename SCENE , typename DRAW_POLICY , typename EXECUTION_POLICY>
+    sdst::static_automatic_engine<typename std::decay<SCENE>::type,typename std::decay<DRAW_POLICY>::type,typename std::decay<EXECUTION_POLICY>::type> make_static_automatic_engine( SCENE&& scene , DRAW_POLICY&& draw_policy , EXECUTION_POLICY&& execution_policy )
+    {
+        return { std::forward<SCENE>( scene ) , std::forward<DRAW_POLICY>( draw_policy ) , std::forward<EXECUTION_POLICY>( execution_policy ) };
+    }
+}
+
+#endif	/* STATIC_ENGINE_HPP */
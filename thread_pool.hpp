@@ -0,0 +1,312 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef THREAD_POOL_HPP
+#define	THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sdst
+{
+    /*
+     * A persistent pool of worker threads designed to run data-parallel loops over a scene.
+     *
+     * The threads are launched once when the pool is constructed and sleep between jobs, so
+     * running a parallel loop each simulation frame doesn't pay thread creation costs.
+     *
+     * Each worker owns a queue of chunks. A job is split into chunks which are distributed
+     * between the queues, and a worker which runs out of chunks steals them from the front of
+     * the other queues. That keeps all the cores busy even if some chunks are more expensive
+     * than others (Particles with different policies, a core preempted by the OS, etc).
+     *
+     * The thread which submits a job participates in it, and is blocked until all the chunks
+     * have been processed. That is, parallel_for() acts as a barrier.
+     */
+    struct thread_pool
+    {
+    public:
+        /*
+         * Initializes the pool. The number of threads includes the calling thread, so
+         * a pool of N threads launches N - 1 workers.
+         */
+        explicit thread_pool( std::size_t threads = std::thread::hardware_concurrency() ) :
+            _pending{ 0 },
+            _generation{ 0 },
+            _stop{ false }
+        {
+            threads = std::max<std::size_t>( threads , 1 );
+
+            for( std::size_t i = 0 ; i < threads ; ++i )
+                _queues.emplace_back( new work_queue{} );
+
+            for( std::size_t i = 1 ; i < threads ; ++i )
+                _workers.emplace_back( [this,i](){ worker_loop( i ); } );
+        }
+
+        thread_pool( const thread_pool& ) = delete;
+        thread_pool& operator=( const thread_pool& ) = delete;
+
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock{ _sleep_mutex };
+                _stop = true;
+            }
+
+            _wake.notify_all();
+
+            for( auto& worker : _workers )
+                worker.join();
+        }
+
+        /*
+         * Returns the number of threads running jobs, the calling thread included.
+         */
+        std::size_t size() const
+        {
+            return _queues.size();
+        }
+
+        /*
+         * Splits the range [begin,end) in chunks of at most 'grain' elements and calls
+         * f(chunk_begin,chunk_end) for each one, in parallel. Returns when all the chunks
+         * have been processed.
+         *
+         * If a call throws, the first exception is rethrown in the calling thread after
+         * the rest of the chunks have finished.
+         *
+         * Jobs submitted from different threads are serialized. Submitting a job from inside
+         * a running job is not supported.
+         */
+        template<typename F>
+        void parallel_for( std::size_t begin , std::size_t end , std::size_t grain , F&& f )
+        {
+            if( begin >= end )
+                return;
+
+            grain = std::max<std::size_t>( grain , 1 );
+
+            const std::size_t chunks = ( end - begin + grain - 1 ) / grain;
+
+            if( chunks == 1 || _workers.empty() )
+            {
+                f( begin , end );
+                return;
+            }
+
+            std::lock_guard<std::mutex> submit_lock{ _submit_mutex };
+
+            using job_t = typename std::remove_reference<F>::type;
+
+            task t;
+            t.run     = []( void* job , std::size_t b , std::size_t e ){ (*static_cast<job_t*>( job ))( b , e ); };
+            t.context = const_cast<void*>( static_cast<const void*>( std::addressof( f ) ) );
+
+            _pending = chunks;
+            _error   = nullptr;
+
+            for( std::size_t i = 0 ; i < chunks ; ++i )
+            {
+                t.begin = begin + i * grain;
+                t.end   = std::min( t.begin + grain , end );
+
+                _queues[i % _queues.size()]->push( t );
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{ _sleep_mutex };
+                ++_generation;
+            }
+
+            _wake.notify_all();
+
+            run_available( 0 );
+
+            {
+                std::unique_lock<std::mutex> lock{ _sleep_mutex };
+                _done.wait( lock , [this](){ return _pending.load() == 0; } );
+            }
+
+            if( _error )
+                std::rethrow_exception( _error );
+        }
+
+    private:
+        /*
+         * A chunk of a job. The job is type-erased through a plain function pointer
+         * so submitting chunks doesn't allocate.
+         */
+        struct task
+        {
+            void      (*run)( void* , std::size_t , std::size_t );
+            void*       context;
+            std::size_t begin;
+            std::size_t end;
+        };
+
+        /*
+         * The owner takes chunks from the back and thieves from the front, so they
+         * only compete for the last chunk of a queue.
+         */
+        struct work_queue
+        {
+        public:
+            void push( const task& t )
+            {
+                std::lock_guard<std::mutex> lock{ _mutex };
+                _tasks.push_back( t );
+            }
+
+            bool pop( task& t )
+            {
+                std::lock_guard<std::mutex> lock{ _mutex };
+
+                if( _head == _tasks.size() )
+                    return false;
+
+                t = _tasks.back();
+                _tasks.pop_back();
+                reset_if_empty();
+                return true;
+            }
+
+            bool steal( task& t )
+            {
+                std::lock_guard<std::mutex> lock{ _mutex };
+
+                if( _head == _tasks.size() )
+                    return false;
+
+                t = _tasks[_head++];
+                reset_if_empty();
+                return true;
+            }
+
+        private:
+            void reset_if_empty()
+            {
+                //clear() keeps the capacity, so steady-state jobs don't allocate.
+                if( _head == _tasks.size() )
+                {
+                    _tasks.clear();
+                    _head = 0;
+                }
+            }
+
+            std::mutex        _mutex;
+            std::vector<task> _tasks;
+            std::size_t       _head = 0;
+        };
+
+        bool acquire( std::size_t index , task& t )
+        {
+            if( _queues[index]->pop( t ) )
+                return true;
+
+            for( std::size_t i = 1 ; i < _queues.size() ; ++i )
+            {
+                if( _queues[( index + i ) % _queues.size()]->steal( t ) )
+                    return true;
+            }
+
+            return false;
+        }
+
+        void run_available( std::size_t index )
+        {
+            task t;
+
+            while( acquire( index , t ) )
+            {
+                try
+                {
+                    t.run( t.context , t.begin , t.end );
+                }
+                catch( ... )
+                {
+                    std::lock_guard<std::mutex> lock{ _sleep_mutex };
+
+                    if( !_error )
+                        _error = std::current_exception();
+                }
+
+                if( _pending.fetch_sub( 1 ) == 1 )
+                {
+                    std::lock_guard<std::mutex> lock{ _sleep_mutex };
+                    _done.notify_all();
+                }
+            }
+        }
+
+        void worker_loop( std::size_t index )
+        {
+            std::size_t seen = 0;
+
+            for(;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock{ _sleep_mutex };
+                    _wake.wait( lock , [&](){ return _stop || _generation != seen; } );
+
+                    if( _stop )
+                        return;
+
+                    seen = _generation;
+                }
+
+                run_available( index );
+            }
+        }
+
+        std::vector<std::unique_ptr<work_queue>> _queues; //_queues[0] belongs to the submitting thread
+        std::vector<std::thread>                 _workers;
+
+        std::atomic<std::size_t> _pending;
+        std::exception_ptr       _error;
+
+        std::mutex              _submit_mutex;
+        std::mutex              _sleep_mutex;
+        std::condition_variable _wake;
+        std::condition_variable _done;
+        std::size_t             _generation;
+        bool                    _stop;
+    };
+
+    /*
+     * Returns a process-wide pool with one thread per hardware thread. Its the pool used
+     * by parallel engines when no other is specified.
+     */
+    inline sdst::thread_pool& default_thread_pool()
+    {
+        static sdst::thread_pool pool;
+
+        return pool;
+    }
+}
+
+#endif	/* THREAD_POOL_HPP */
@@ -0,0 +1,328 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef TRAILS_HPP
+#define	TRAILS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "execution_policies.hpp"
+#include "vertex_buffer_drawing.hpp"
+
+/*
+ * Particle trails: The last positions (Vertices, in general) of each particle, drawn behind it.
+ *
+ * Keeping a queue per particle means an allocation per particle, and drawing each trail on its own
+ * means a draw call per particle. Instead, sdst::trail_store keeps all the trails in one slab, a ring
+ * buffer of tail_length slots per particle, and sdst::trail_drawing records and draws the trails of
+ * the whole scene at once: It is the drawing policy of the engine, and submits the vertices of all
+ * the trails in one call:
+ *
+ *     auto draw = sdst::make_trail_drawing<sf::Vertex>( 16 , [&]( const sf::Vertex* vertices , std::size_t count )
+ *     {
+ *         window.draw( vertices , count , sf::Points );
+ *     });
+ *
+ *     auto engine = sdst::make_basic_automatic_engine( scene , draw );
+ *
+ * Once the slab and the vertex buffer are large enough for the scene, drawing doesn't allocate.
+ */
+
+namespace sdst
+{
+    /*
+     * The trails of a set of particles, each one a ring buffer of (Up to) tail_length vertices
+     * stored in a shared slab. Pushing into a full trail overwrites its oldest vertex.
+     */
+    template<typename VERTEX>
+    struct trail_store
+    {
+    public:
+        using vertex_t = VERTEX;
+
+        explicit trail_store( std::size_t tail_length , std::size_t particles = 0 ) :
+            _tail_length{ tail_length }
+        {
+            resize( particles );
+        }
+
+        /*
+         * Sets the number of trails. New trails are empty, and the trails past the new size are discarded.
+         */
+        void resize( std::size_t particles )
+        {
+            _slots.resize( particles * _tail_length );
+            _heads.resize( particles , 0 );
+            _lengths.resize( particles , 0 );
+        }
+
+        /*
+         * Reserves room for the trails of 'particles' particles.
+         */
+        void reserve( std::size_t particles )
+        {
+            _slots.reserve( particles * _tail_length );
+            _heads.reserve( particles );
+            _lengths.reserve( particles );
+        }
+
+        /*
+         * Appends a vertex to the trail of a particle.
+         */
+        void push( std::size_t particle , const vertex_t& vertex )
+        {
+            if( _tail_length == 0 )
+                return;
+
+            std::uint32_t& head = _heads[particle];
+
+            _slots[particle * _tail_length + head] = vertex;
+
+            head = head + 1 == _tail_length ? 0 : head + 1;
+
+            if( _lengths[particle] < _tail_length )
+                ++_lengths[particle];
+        }
+
+        /*
+         * Empties the trail of a particle (When its slot is recycled for a new particle, for example).
+         */
+        void clear( std::size_t particle )
+        {
+            _heads[particle]   = 0;
+            _lengths[particle] = 0;
+        }
+
+        /*
+         * Moves the trail of a particle to another one, whose trail is discarded (When the scene moves
+         * a particle to another index, for example).
+         */
+        void move( std::size_t from , std::size_t to )
+        {
+            std::copy( _slots.begin() + from * _tail_length , _slots.begin() + ( from + 1 ) * _tail_length , _slots.begin() + to * _tail_length );
+
+            _heads[to]     = _heads[from];
+            _lengths[to]   = _lengths[from];
+            _heads[from]   = 0;
+            _lengths[from] = 0;
+        }
+
+        /*
+         * Copies the trail of a particle, oldest vertex first, to 'output'. Returns the number of
+         * vertices copied.
+         */
+        std::size_t copy( std::size_t particle , vertex_t* output ) const
+        {
+            const std::size_t length = _lengths[particle];
+            const vertex_t*   slots  = _slots.data() + particle * _tail_length;
+            const std::size_t head   = _heads[particle];
+            const std::size_t first  = head >= length ? head - length : head + _tail_length - length;
+
+            for( std::size_t i = 0 , slot = first ; i < length ; ++i , slot = slot + 1 == _tail_length ? 0 : slot + 1 )
+                output[i] = slots[slot];
+
+            return length;
+        }
+
+        /*
+         * Returns the number of vertices of the trail of a particle.
+         */
+        std::size_t length( std::size_t particle ) const
+        {
+            return _lengths[particle];
+        }
+
+        /*
+         * Returns the number of trails.
+         */
+        std::size_t size() const
+        {
+            return _heads.size();
+        }
+
+        std::size_t tail_length() const
+        {
+            return _tail_length;
+        }
+
+    private:
+        std::size_t                _tail_length;
+        std::vector<vertex_t>      _slots;   //tail_length slots per particle
+        std::vector<std::uint32_t> _heads;   //Next slot to write of each trail
+        std::vector<std::uint32_t> _lengths;
+    };
+
+    namespace impl
+    {
+        /*
+         * Moves the trails of the particles moved by the scene since the last draw (See pool_scene::moves()),
+         * if the scene reports them. If some collections were missed the moves are unknown, so the trails
+         * are dropped.
+         */
+        template<typename SCENE , typename VERTEX>
+        auto follow_moves( const SCENE& scene , sdst::trail_store<VERTEX>& trails , std::size_t& collections , int ) -> decltype( scene.moves() , scene.collections() , void() )
+        {
+            if( scene.collections() == collections + 1 )
+            {
+                for( const auto& move : scene.moves() )
+                {
+                    if( move.from < trails.size() )
+                        trails.move( move.from , move.to );
+                    else if( move.to < trails.size() )
+                        trails.clear( move.to );
+                }
+            }
+            else if( scene.collections() != collections )
+                trails.resize( 0 );
+
+            collections = scene.collections();
+        }
+
+        template<typename SCENE , typename VERTEX>
+        void follow_moves( const SCENE& , sdst::trail_store<VERTEX>& , std::size_t& , long )
+        {}
+    }
+
+    /*
+     * Drawing policy which records the current vertex of each particle (Given by the projection, a function
+     * VERTEX(const DATA&)) in its trail, and then submits the trails of all the particles together through
+     * the submission function, with signature void(const VERTEX* vertices,std::size_t count).
+     *
+     * The trails are concatenated, so the submission suits point primitives. The recording and the gather
+     * are split in chunks through the execution policy.
+     *
+     * The scene should store its particles contiguously (A std::vector, sdst::homogeneous_scene, sdst::pool_scene).
+     * The trails are bound to the indices of the particles: When the scene shrinks the trails past its
+     * size are discarded, and the new particles start with empty trails. Scenes which move particles
+     * when removing dead ones report the moves (See pool_scene::moves()), and the trails follow them.
+     */
+    template<typename VERTEX , typename SUBMIT , typename PROJECTION = sdst::impl::to_vertex<VERTEX> , typename EXECUTION_POLICY = sdst::sequential_execution>
+    struct trail_drawing
+    {
+    public:
+        using vertex_t           = VERTEX;
+        using submit_t           = SUBMIT;
+        using projection_t       = PROJECTION;
+        using execution_policy_t = EXECUTION_POLICY;
+
+        trail_drawing( std::size_t tail_length , const submit_t& submit , const projection_t& projection = projection_t{} , const execution_policy_t& execution_policy = execution_policy_t{} ) :
+            _trails{ tail_length },
+            _submit( submit ),
+            _projection( projection ),
+            _execution_policy{ execution_policy },
+            _collections{ 0 }
+        {}
+
+        template<typename SCENE>
+        auto operator()( const SCENE& scene ) -> decltype( scene.data() , scene.size() , void() )
+        {
+            const std::size_t size = scene.size();
+            const auto*       data = scene.data();
+
+            sdst::impl::follow_moves( scene , _trails , _collections , 0 );
+            _trails.resize( size );
+
+            _execution_policy.for_each_range( 0 , size , [&]( std::size_t begin , std::size_t end )
+            {
+                for( std::size_t i = begin ; i < end ; ++i )
+                    _trails.push( i , _projection( data[i] ) );
+            });
+
+            //Exclusive scan of the trail lengths, giving where each trail starts in the vertex buffer:
+            _offsets.resize( size + 1 );
+
+            std::size_t offset = 0;
+
+            for( std::size_t i = 0 ; i < size ; ++i )
+            {
+                _offsets[i] = offset;
+                offset     += _trails.length( i );
+            }
+
+            _offsets[size] = offset;
+
+            if( _vertices.size() < offset )
+                _vertices.resize( offset );
+
+            _execution_policy.for_each_range( 0 , size , [&]( std::size_t begin , std::size_t end )
+            {
+                for( std::size_t i = begin ; i < end ; ++i )
+                    _trails.copy( i , _vertices.data() + _offsets[i] );
+            });
+
+            if( offset > 0 )
+                _submit( static_cast<const vertex_t*>( _vertices.data() ) , offset );
+        }
+
+        /*
+         * Gives access to the trails, to clear the trail of a recycled particle for example.
+         */
+        sdst::trail_store<vertex_t>& trails()
+        {
+            return _trails;
+        }
+
+        const sdst::trail_store<vertex_t>& trails() const
+        {
+            return _trails;
+        }
+
+    private:
+        sdst::trail_store<vertex_t> _trails;
+        submit_t                    _submit;
+        projection_t                _projection;
+        execution_policy_t          _execution_policy;
+        std::vector<vertex_t>       _vertices; //Batch submitted each draw, reused
+        std::vector<std::size_t>    _offsets;
+        std::size_t                 _collections; //Of the scene, when last drawn
+    };
+
+    /*
+     * Type-deduction-based builders for trail drawing policies. The vertex type has to be given:
+     *
+     *     auto draw = sdst::make_trail_drawing<sf::Vertex>( 16 , submit );
+     *     auto draw = sdst::make_trail_drawing<sf::Vertex>( 16 , submit , []( const particle& p ){ return sf::Vertex{ p.position , p.color }; } , sdst::parallel_execution{ pool } );
+     */
+    template<typename VERTEX , typename SUBMIT>
+    sdst::trail_drawing<VERTEX,typename std::decay<SUBMIT>::type> make_trail_drawing( std::size_t tail_length , SUBMIT&& submit )
+    {
+        return { tail_length , std::forward<SUBMIT>( submit ) };
+    }
+
+    template<typename VERTEX , typename SUBMIT , typename PROJECTION>
+    sdst::trail_drawing<VERTEX,typename std::decay<SUBMIT>::type,typename std::decay<PROJECTION>::type>
+    make_trail_drawing( std::size_t tail_length , SUBMIT&& submit , PROJECTION&& projection )
+    {
+        return { tail_length , std::forward<SUBMIT>( submit ) , std::forward<PROJECTION>( projection ) };
+    }
+
+    template<typename VERTEX , typename SUBMIT , typename PROJECTION , typename EXECUTION_POLICY>
+    sdst::trail_drawing<VERTEX,typename std::decay<SUBMIT>::type,typename std::decay<PROJECTION>::type,typename std::decay<EXECUTION_POLICY>::type>
+    make_trail_drawing( std::size_t tail_length , SUBMIT&& submit , PROJECTION&& projection , EXECUTION_POLICY&& execution_policy )
+    {
+        return { tail_length , std::forward<SUBMIT>( submit ) , std::forward<PROJECTION>( projection ) , std::forward<EXECUTION_POLICY>( execution_policy ) };
+    }
+}
+
+#endif	/* TRAILS_HPP */
@@ -0,0 +1,534 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef TRAJECTORY_HPP
+#define	TRAJECTORY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "compression.hpp"
+#include "execution_policies.hpp"
+#include "staging_queue.hpp"
+
+/*
+ * Trajectories of long simulations, recorded for offline analysis. Raw dumps of every frame are huge (A million
+ * particles are 8MB of positions per frame), so sdst::trajectory_recorder streams a compact encoding of one of
+ * every 'stride' frames instead:
+ *
+ *  - Positions are quantized to a fixed precision (0.01 units by default), as integers.
+ *  - Each recorded frame is delta-coded against the previous one: Particles move little between frames, so
+ *    the deltas are small integers, mostly zero bytes.
+ *  - Frames are grouped in chunks, stored by columns (All the x deltas of the frame, then all the y deltas),
+ *    byte shuffled and compressed (See compression.hpp).
+ *
+ * The frame loop only quantizes and delta-codes the positions into a staging buffer; compressing and writing
+ * the chunks is done by a background thread. The recorder is a stage run once per frame, from the before_next
+ * action of the engine:
+ *
+ *     sdst::trajectory_recorder<position> recorder{ "simulation.trajectory" , 6 }; //10 frames per second at 60 fps
+ *
+ *     recorder.reserve( 1000000 ); //Optional, allocates the staging buffers up front
+ *
+ *     engine.before_next( [&]( engine_t& engine ){ recorder( engine.scene() ); } );
+ *
+ * The staging buffers are a bounded pool. If the disk falls behind and all the buffers are in flight, recorded
+ * frames are dropped (See dropped()) instead of stalling the frame loop or queuing more memory. The first frame
+ * of each chunk is a keyframe (Delta-coded against zero), so chunks decode on their own and a dropped chunk is
+ * just a gap in the trajectory. sdst::trajectory_reader decodes the file back, frame by frame.
+ *
+ * Particles are identified by their index in the scene, which should store its particles contiguously (A std::vector,
+ * sdst::homogeneous_scene, sdst::pool_scene. Note pool scenes move particles when others die). The file format is a
+ * header and a list of chunks, written in the byte order of the machine:
+ *
+ *     header: "SDSTTRAJ" , uint32 version , float precision , uint32 stride
+ *     chunk:  uint32 frame count , (uint64 frame , uint64 particles) per frame , uint64 size , uint64 stored size , stored bytes
+ *
+ * The chunk bytes are the columns of its frames, as zigzag encoded uint32 deltas, shuffled and compressed (Stored as
+ * they are if compression doesn't make them smaller, stored size == size).
+ */
+
+namespace sdst
+{
+    namespace impl
+    {
+        struct trajectory_format
+        {
+            enum : std::uint32_t { version = 1 };
+
+            struct frame
+            {
+                std::uint64_t index;     //Frame of the simulation
+                std::uint64_t particles;
+            };
+
+            /*
+             * Zigzag encoding of the (Wrapping) difference between two quantized positions, so small
+             * negative deltas are small integers too.
+             */
+            static std::uint32_t encode( std::int32_t current , std::int32_t previous )
+            {
+                const std::uint32_t delta = static_cast<std::uint32_t>( current ) - static_cast<std::uint32_t>( previous );
+
+                return ( delta << 1 ) ^ ( 0u - ( delta >> 31 ) );
+            }
+
+            static std::int32_t decode( std::uint32_t code , std::int32_t previous )
+            {
+                const std::uint32_t delta = ( code >> 1 ) ^ ( 0u - ( code & 1u ) );
+
+                return static_cast<std::int32_t>( static_cast<std::uint32_t>( previous ) + delta );
+            }
+        };
+    }
+
+    /*
+     * Records the positions (Given by the POSITION field, see field.hpp) of the particles of one of every 'stride'
+     * frames to a trajectory file. Quantizing and delta-coding are split in chunks through the execution policy.
+     */
+    template<typename POSITION , typename EXECUTION_POLICY = sdst::sequential_execution>
+    struct trajectory_recorder
+    {
+    public:
+        using data_t             = typename POSITION::data_t;
+        using execution_policy_t = EXECUTION_POLICY;
+
+        /*
+         * Opens the trajectory file 'path'. Positions are quantized to multiples of 'precision', and chunks hold
+         * 'chunk_frames' recorded frames each, with 'staging_buffers' chunks in flight at most.
+         */
+        explicit trajectory_recorder( const std::string& path , std::size_t stride = 1 , float precision = 0.01f , std::size_t chunk_frames = 8 ,
+                                      std::size_t staging_buffers = 2 , const execution_policy_t& execution_policy = execution_policy_t{} ) :
+            _file{ path , std::ios::binary | std::ios::trunc },
+            _stride{ stride > 0 ? stride : 1 },
+            _precision{ precision },
+            _scale{ 1.0f / precision },
+            _chunk_frames{ chunk_frames > 0 ? chunk_frames : 1 },
+            _execution_policy{ execution_policy },
+            _frame{ 0 },
+            _previous_size{ 0 },
+            _chunk{ nullptr },
+            _recorded{ 0 },
+            _dropped{ 0 },
+            _failed{ 0 },
+            _bytes{ 0 },
+            _queue{ staging_buffers , [this]( chunk& c ){ write( c ); } }
+        {
+            const std::uint32_t version = sdst::impl::trajectory_format::version;
+            const std::uint32_t stride_ = static_cast<std::uint32_t>( _stride );
+
+            _file.write( "SDSTTRAJ" , 8 );
+            _file.write( reinterpret_cast<const char*>( &version ) , sizeof( version ) );
+            _file.write( reinterpret_cast<const char*>( &_precision ) , sizeof( _precision ) );
+            _file.write( reinterpret_cast<const char*>( &stride_ ) , sizeof( stride_ ) );
+        }
+
+        /*
+         * Writes the frames still staged, and closes the file.
+         */
+        ~trajectory_recorder()
+        {
+            submit();
+        }
+
+        /*
+         * Allocates the staging buffers for scenes of up to 'particles' particles, so recording doesn't allocate
+         * (Nor touch fresh memory) in the frame loop. Call it before recording.
+         */
+        void reserve( std::size_t particles )
+        {
+            std::vector<chunk*> free;
+
+            while( chunk* c = _queue.try_acquire() )
+                free.push_back( c );
+
+            for( chunk* c : free )
+            {
+                if( c->codes.size() < 2 * particles * _chunk_frames )
+                    c->codes.resize( 2 * particles * _chunk_frames );
+
+                _queue.release( c );
+            }
+
+            if( _previous_x.size() < particles )
+            {
+                _previous_x.resize( particles );
+                _previous_y.resize( particles );
+            }
+        }
+
+        /*
+         * Records the scene, if the frame is one of every 'stride' frames. Call it once per frame.
+         */
+        template<typename SCENE>
+        auto operator()( const SCENE& scene ) -> decltype( scene.data() , scene.size() , void() )
+        {
+            if( _frame++ % _stride == 0 )
+                record( scene.data() , scene.size() , _frame - 1 );
+        }
+
+        /*
+         * Records the positions of 'size' contiguous particles as the frame 'frame' of the simulation.
+         * Frames should be recorded in increasing order.
+         */
+        void record( const data_t* data , std::size_t size , std::uint64_t frame )
+        {
+            if( _chunk == nullptr )
+            {
+                _chunk = _queue.try_acquire();
+
+                if( _chunk == nullptr ) //The disk is behind, drop the frame
+                {
+                    ++_dropped;
+                    return;
+                }
+
+                _chunk->frames.clear();
+                _chunk->used = 0;
+            }
+
+            const bool        keyframe = _chunk->frames.empty();
+            const std::size_t previous = keyframe ? 0 : _previous_size; //Particles past the previous frame are coded against zero
+
+            if( _chunk->codes.size() < _chunk->used + 2 * size ) //Only grows, so it isn't cleared each time
+            {
+                _chunk->codes.reserve( std::max( _chunk->used + 2 * size , 2 * size * _chunk_frames ) ); //Once for the whole chunk
+                _chunk->codes.resize( _chunk->used + 2 * size );
+            }
+
+            if( _previous_x.size() < size )
+            {
+                _previous_x.resize( size );
+                _previous_y.resize( size );
+            }
+
+            std::uint32_t* const x_codes = _chunk->codes.data() + _chunk->used;
+            std::uint32_t* const y_codes = x_codes + size;
+
+            _execution_policy.for_each_range( 0 , size , [&]( std::size_t begin , std::size_t end )
+            {
+                for( std::size_t i = begin ; i < end ; ++i )
+                {
+                    const auto&        position = POSITION::get( data[i] );
+                    const std::int32_t x        = quantize( position.x );
+                    const std::int32_t y        = quantize( position.y );
+
+                    x_codes[i] = sdst::impl::trajectory_format::encode( x , i < previous ? _previous_x[i] : 0 );
+                    y_codes[i] = sdst::impl::trajectory_format::encode( y , i < previous ? _previous_y[i] : 0 );
+
+                    _previous_x[i] = x;
+                    _previous_y[i] = y;
+                }
+            });
+
+            _chunk->frames.push_back( sdst::impl::trajectory_format::frame{ frame , size } );
+            _chunk->used  += 2 * size;
+            _previous_size = size;
+
+            ++_recorded;
+
+            if( _chunk->frames.size() == _chunk_frames )
+                submit();
+        }
+
+        /*
+         * Writes the frames recorded so far (Closing the current chunk early), and waits until they are written.
+         */
+        void flush()
+        {
+            submit();
+            _queue.wait();
+        }
+
+        /*
+         * Returns the number of frames recorded, and dropped (All the staging buffers in flight).
+         */
+        std::size_t recorded() const
+        {
+            return _recorded;
+        }
+
+        std::size_t dropped() const
+        {
+            return _dropped;
+        }
+
+        /*
+         * Returns the number of chunks which failed to be written.
+         */
+        std::size_t failed() const
+        {
+            return _failed;
+        }
+
+        /*
+         * Returns the number of bytes of chunks written to the file so far.
+         */
+        std::size_t bytes() const
+        {
+            return _bytes;
+        }
+
+        float precision() const
+        {
+            return _precision;
+        }
+
+        std::size_t stride() const
+        {
+            return _stride;
+        }
+
+    private:
+        /*
+         * A chunk of frames staged to be written. The buffers are reused between chunks.
+         */
+        struct chunk
+        {
+            std::vector<sdst::impl::trajectory_format::frame> frames;
+            std::vector<std::uint32_t>                        codes;    //The columns of the frames
+            std::size_t                                       used;     //Codes used
+            std::vector<unsigned char>                        shuffled; //Scratch of the writer
+            std::vector<unsigned char>                        compressed;
+        };
+
+        std::int32_t quantize( float value ) const
+        {
+            const float scaled = std::floor( value * _scale + 0.5f );
+
+            if( !( scaled > -2147483648.0f ) ) //NaNs too
+                return INT32_MIN;
+            if( scaled >= 2147483648.0f )
+                return INT32_MAX;
+
+            return static_cast<std::int32_t>( scaled );
+        }
+
+        void submit()
+        {
+            if( _chunk != nullptr )
+            {
+                _queue.submit( _chunk );
+                _chunk = nullptr;
+            }
+        }
+
+        /*
+         * Compresses and writes a chunk. Runs in the background thread.
+         */
+        void write( chunk& c )
+        {
+            const std::uint32_t  frames = static_cast<std::uint32_t>( c.frames.size() );
+            const std::uint64_t  size   = c.used * sizeof( std::uint32_t );
+            const unsigned char* codes  = reinterpret_cast<const unsigned char*>( c.codes.data() );
+
+            c.shuffled.resize( size );
+            c.compressed.clear();
+
+            sdst::compression::shuffle( codes , size , sizeof( std::uint32_t ) , c.shuffled.data() );
+            sdst::compression::compress( c.shuffled.data() , size , c.compressed );
+
+            const bool           compressed  = c.compressed.size() < size;
+            const unsigned char* stored      = compressed ? c.compressed.data() : codes;
+            const std::uint64_t  stored_size = compressed ? c.compressed.size() : size;
+
+            _file.write( reinterpret_cast<const char*>( &frames ) , sizeof( frames ) );
+            _file.write( reinterpret_cast<const char*>( c.frames.data() ) , frames * sizeof( sdst::impl::trajectory_format::frame ) );
+            _file.write( reinterpret_cast<const char*>( &size ) , sizeof( size ) );
+            _file.write( reinterpret_cast<const char*>( &stored_size ) , sizeof( stored_size ) );
+            _file.write( reinterpret_cast<const char*>( stored ) , stored_size );
+            _file.flush(); //Complete chunks reach the file even if the simulation crashes later
+
+            if( _file )
+                _bytes += stored_size;
+            else
+                ++_failed;
+        }
+
+        std::ofstream               _file;      //Only written by the background thread (After the header)
+        std::size_t                 _stride;
+        float                       _precision , _scale;
+        std::size_t                 _chunk_frames;
+        execution_policy_t          _execution_policy;
+        std::uint64_t               _frame;
+        std::vector<std::int32_t>   _previous_x , _previous_y; //Quantized positions of the last recorded frame
+        std::size_t                 _previous_size;
+        chunk*                      _chunk;     //Being filled, nullptr if none
+        std::size_t                 _recorded , _dropped;
+        std::atomic<std::size_t>    _failed , _bytes;
+        sdst::staging_queue<chunk>  _queue;     //Last: Its thread is the first thing stopped on destruction
+    };
+
+    /*
+     * Reads a trajectory file written by sdst::trajectory_recorder, frame by frame:
+     *
+     *     sdst::trajectory_reader reader{ "simulation.trajectory" };
+     *     std::uint64_t           frame;
+     *     std::vector<float>      x , y;
+     *
+     *     while( reader.next( frame , x , y ) )
+     *         analyze( frame , x , y );
+     *
+     * Positions are read back quantized to the precision of the recorder.
+     */
+    struct trajectory_reader
+    {
+    public:
+        explicit trajectory_reader( const std::string& path ) :
+            _file{ path , std::ios::binary },
+            _good{ false },
+            _precision{ 0.0f },
+            _stride{ 0 },
+            _next{ 0 },
+            _offset{ 0 }
+        {
+            char          magic[8];
+            std::uint32_t version;
+
+            _good = read( magic ) && std::memcmp( magic , "SDSTTRAJ" , 8 ) == 0 && read( version ) &&
+                    version == sdst::impl::trajectory_format::version && read( _precision ) && read( _stride );
+        }
+
+        /*
+         * Reads the next frame into the columns 'x' and 'y', and its frame index in the simulation into
+         * 'frame'. Returns false at the end of the file, or if it is corrupt.
+         */
+        bool next( std::uint64_t& frame , std::vector<float>& x , std::vector<float>& y )
+        {
+            if( _next == _frames.size() && !read_chunk() )
+                return false;
+
+            const sdst::impl::trajectory_format::frame& f = _frames[_next];
+            const std::size_t    size     = f.particles;
+            const std::size_t    previous = _next == 0 ? 0 : _frames[_next - 1].particles;
+            const std::uint32_t* x_codes  = _codes.data() + _offset;
+            const std::uint32_t* y_codes  = x_codes + size;
+
+            if( _previous_x.size() < size )
+            {
+                _previous_x.resize( size );
+                _previous_y.resize( size );
+            }
+
+            x.resize( size );
+            y.resize( size );
+
+            for( std::size_t i = 0 ; i < size ; ++i )
+            {
+                _previous_x[i] = sdst::impl::trajectory_format::decode( x_codes[i] , i < previous ? _previous_x[i] : 0 );
+                _previous_y[i] = sdst::impl::trajectory_format::decode( y_codes[i] , i < previous ? _previous_y[i] : 0 );
+
+                x[i] = _previous_x[i] * _precision;
+                y[i] = _previous_y[i] * _precision;
+            }
+
+            frame    = f.index;
+            _offset += 2 * size;
+            ++_next;
+
+            return true;
+        }
+
+        /*
+         * Returns false if the file couldn't be opened or isn't a trajectory file.
+         */
+        bool good() const
+        {
+            return _good;
+        }
+
+        float precision() const
+        {
+            return _precision;
+        }
+
+        std::size_t stride() const
+        {
+            return _stride;
+        }
+
+    private:
+        template<typename T>
+        bool read( T& value )
+        {
+            return static_cast<bool>( _file.read( reinterpret_cast<char*>( &value ) , sizeof( T ) ) );
+        }
+
+        bool read_chunk()
+        {
+            std::uint32_t frames;
+            std::uint64_t size , stored_size , codes = 0;
+
+            if( !_good || !read( frames ) )
+                return false;
+
+            _frames.resize( frames );
+
+            if( frames == 0 || !_file.read( reinterpret_cast<char*>( _frames.data() ) , frames * sizeof( sdst::impl::trajectory_format::frame ) ) ||
+                !read( size ) || !read( stored_size ) )
+                return _good = false;
+
+            for( const sdst::impl::trajectory_format::frame& f : _frames )
+                codes += 2 * f.particles;
+
+            if( size != codes * sizeof( std::uint32_t ) )
+                return _good = false;
+
+            _stored.resize( stored_size );
+            _shuffled.resize( size );
+            _codes.resize( codes );
+
+            if( !_file.read( reinterpret_cast<char*>( _stored.data() ) , stored_size ) )
+                return _good = false;
+
+            unsigned char* const bytes = reinterpret_cast<unsigned char*>( _codes.data() );
+
+            if( stored_size == size )
+                std::memcpy( bytes , _stored.data() , size );
+            else if( sdst::compression::decompress( _stored.data() , stored_size , _shuffled.data() , size ) )
+                sdst::compression::unshuffle( _shuffled.data() , size , sizeof( std::uint32_t ) , bytes );
+            else
+                return _good = false;
+
+            _next   = 0;
+            _offset = 0;
+
+            return true;
+        }
+
+        std::ifstream                                     _file;
+        bool                                              _good;
+        float                                             _precision;
+        std::uint32_t                                     _stride;
+        std::vector<sdst::impl::trajectory_format::frame> _frames; //Of the current chunk
+        std::size_t                                       _next , _offset;
+        std::vector<std::uint32_t>                        _codes;
+        std::vector<unsigned char>                        _stored , _shuffled;
+        std::vector<std::int32_t>                         _previous_x , _previous_y;
+    };
+}
+
+#endif	/* TRAJECTORY_HPP */
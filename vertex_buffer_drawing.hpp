@@ -0,0 +1,162 @@
+/***************************************************************************
+*               Stardust, a C++11 particle engine generator                *
+*               -------------------------------------------                *
+*                                                                          *
+*  Copyright 2014  Manuel Sánchez Pérez                                    *
+*                                                                          *
+* Licensed under the Apache License, Version 2.0 (the "License");          *
+* you may not use this file except in compliance with the License.         *
+* You may obtain a copy of the License at                                  *
+*                                                                          *
+*     http://www.apache.org/licenses/LICENSE-2.0                           *
+*                                                                          *
+* Unless required by applicable law or agreed to in writing, software      *
+* distributed under the License is distributed on an "AS IS" BASIS,        *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. *
+* See the License for the specific language governing permissions and      *
+* limitations under the License.                                           *
+***************************************************************************/
+
+#ifndef VERTEX_BUFFER_DRAWING_HPP
+#define	VERTEX_BUFFER_DRAWING_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "execution_policies.hpp"
+
+/*
+ * Drawing the scene particle by particle (particle.draw( canvas ) for each particle) issues a draw
+ * call per particle. sdst::vertex_buffer_drawing is a stock scene drawing policy which converts the
+ * whole scene into one vertex array and submits it at once:
+ *
+ *     auto draw = sdst::make_vertex_buffer_drawing<sf::Vertex>( [&]( const sf::Vertex* vertices , std::size_t count )
+ *     {
+ *         window.clear();
+ *         window.draw( vertices , count , sf::Points );
+ *         window.display();
+ *     });
+ *
+ *     auto engine = sdst::make_basic_automatic_engine( scene , draw );
+ *
+ * The vertex of each particle is given by the projection, a function VERTEX(const DATA&). By default
+ * the particle data is converted to VERTEX, so scenes of sf::Vertex are copied as they are.
+ *
+ * The conversion is a single pass over the contiguous particle data writing the contiguous vertex
+ * array, which the compiler can vectorize for simple projections, split in chunks through an execution
+ * policy. The array persists across frames, and is only resized when the scene grows.
+ */
+
+namespace sdst
+{
+    namespace impl
+    {
+        /*
+         * The default projection of vertex buffers: The particle data is the vertex (sf::Vertex, for example).
+         */
+        template<typename VERTEX>
+        struct to_vertex
+        {
+            template<typename DATA>
+            VERTEX operator()( const DATA& data ) const
+            {
+                return static_cast<VERTEX>( data );
+            }
+        };
+    }
+
+    /*
+     * Drawing policy which submits the vertices of all the particles of the scene through the submission
+     * function, with signature void(const VERTEX* vertices,std::size_t count). The scene should store its
+     * particles contiguously (A std::vector, sdst::homogeneous_scene, sdst::pool_scene).
+     */
+    template<typename VERTEX , typename SUBMIT , typename PROJECTION = sdst::impl::to_vertex<VERTEX> , typename EXECUTION_POLICY = sdst::sequential_execution>
+    struct vertex_buffer_drawing
+    {
+    public:
+        using vertex_t           = VERTEX;
+        using submit_t           = SUBMIT;
+        using projection_t       = PROJECTION;
+        using execution_policy_t = EXECUTION_POLICY;
+
+        vertex_buffer_drawing( const submit_t& submit , const projection_t& projection = projection_t{} , const execution_policy_t& execution_policy = execution_policy_t{} ) :
+            _submit( submit ),
+            _projection( projection ),
+            _execution_policy{ execution_policy }
+        {}
+
+        template<typename SCENE>
+        auto operator()( const SCENE& scene ) -> decltype( scene.data() , scene.size() , void() )
+        {
+            const std::size_t size = scene.size();
+            const auto*       data = scene.data();
+
+            if( _vertices.size() < size )
+                _vertices.resize( size );
+
+            vertex_t* const vertices = _vertices.data();
+
+            _execution_policy.for_each_range( 0 , size , [&]( std::size_t begin , std::size_t end )
+            {
+                for( std::size_t i = begin ; i < end ; ++i )
+                    vertices[i] = _projection( data[i] );
+            });
+
+            _submit( static_cast<const vertex_t*>( vertices ) , size );
+        }
+
+        /*
+         * Gives access to the vertex array. Its size is the size of the largest scene drawn so far.
+         */
+        const std::vector<vertex_t>& vertices() const
+        {
+            return _vertices;
+        }
+
+        submit_t& submit()
+        {
+            return _submit;
+        }
+
+        const submit_t& submit() const
+        {
+            return _submit;
+        }
+
+    private:
+        submit_t              _submit;
+        projection_t          _projection;
+        execution_policy_t    _execution_policy;
+        std::vector<vertex_t> _vertices; //Reused between draws
+    };
+
+    /*
+     * Type-deduction-based builders for vertex buffer drawing policies. The vertex type has to be given:
+     *
+     *     auto draw = sdst::make_vertex_buffer_drawing<sf::Vertex>( submit );
+     *     auto draw = sdst::make_vertex_buffer_drawing<sf::Vertex>( submit , []( const particle& p ){ return sf::Vertex{ p.position , p.color }; } , sdst::parallel_execution{ pool } );
+     */
+    template<typename VERTEX , typename SUBMIT>
+    sdst::vertex_buffer_drawing<VERTEX,typename std::decay<SUBMIT>::type> make_vertex_buffer_drawing( SUBMIT&& submit )
+    {
+        return { std::forward<SUBMIT>( submit ) };
+    }
+
+    template<typename VERTEX , typename SUBMIT , typename PROJECTION>
+    sdst::vertex_buffer_drawing<VERTEX,typename std::decay<SUBMIT>::type,typename std::decay<PROJECTION>::type>
+    make_vertex_buffer_drawing( SUBMIT&& submit , PROJECTION&& projection )
+    {
+        return { std::forward<SUBMIT>( submit ) , std::forward<PROJECTION>( projection ) };
+    }
+
+    template<typename VERTEX , typename SUBMIT , typename PROJECTION , typename EXECUTION_POLICY>
+    sdst::vertex_buffer_drawing<VERTEX,typename std::decay<SUBMIT>::type,typename std::decay<PROJECTION>::type,typename std::decay<EXECUTION_POLICY>::type>
+    make_vertex_buffer_drawing( SUBMIT&& submit , PROJECTION&& projection , EXECUTION_POLICY&& execution_policy )
+    {
+        return { std::forward<SUBMIT>( submit ) , std::forward<PROJECTION>( projection ) , std::forward<EXECUTION_POLICY>( execution_policy ) };
+    }
+}
+
+#endif	/* VERTEX_BUFFER_DRAWING_HPP */